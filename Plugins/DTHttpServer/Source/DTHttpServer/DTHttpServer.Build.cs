@@ -13,6 +13,7 @@ public class DTHttpServer : ModuleRules
 			new string[]
 				{
 					"Core",
+					"HTTPServer",
 				}
 			);
 			
@@ -24,7 +25,7 @@ public class DTHttpServer : ModuleRules
 					"Engine",
 					"Slate",
 					"SlateCore", 
-					"HTTPServer",
+					"Sockets",
 				}
 			);
 	}
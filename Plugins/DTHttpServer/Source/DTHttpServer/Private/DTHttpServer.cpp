@@ -5,6 +5,8 @@
 
 #define LOCTEXT_NAMESPACE "FDTHttpServerModule"
 
+DEFINE_LOG_CATEGORY(LogDTHttpServer);
+
 void FDTHttpServerModule::StartupModule()
 {
 }
@@ -0,0 +1,194 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerBatch.h"
+#include "DTHttpServerJson.h"
+#include "Misc/Base64.h"
+
+namespace DTHttpServer
+{
+	// 追加 ASCII 文本
+	static void AppendBatchText(TArray<uint8> & Body, const ANSICHAR * Text)
+	{
+		Body.Append((const uint8 *)Text, FCStringAnsi::Strlen(Text));
+	}
+
+	// 是否为文本类型
+	static bool IsBatchTextType(const FString & ContentType)
+	{
+		return ContentType.StartsWith(TEXT("text/")) || ContentType.Contains(TEXT("json")) || ContentType.Contains(TEXT("xml")) || ContentType.Contains(TEXT("javascript"));
+	}
+
+	// 子请求方法
+	static EHttpServerRequestVerbs ParseBatchVerb(const FString & Verb)
+	{
+		static const TPair<const TCHAR *, EHttpServerRequestVerbs> Verbs[] =
+		{
+			{ TEXT("GET"),		EHttpServerRequestVerbs::VERB_GET },
+			{ TEXT("POST"),		EHttpServerRequestVerbs::VERB_POST },
+			{ TEXT("PUT"),		EHttpServerRequestVerbs::VERB_PUT },
+			{ TEXT("PATCH"),	EHttpServerRequestVerbs::VERB_PATCH },
+			{ TEXT("DELETE"),	EHttpServerRequestVerbs::VERB_DELETE },
+		};
+		for ( const TPair<const TCHAR *, EHttpServerRequestVerbs> & Pair : Verbs )
+		{
+			if ( Verb.Equals(Pair.Key, ESearchCase::IgnoreCase) ) { return Pair.Value; }
+		}
+		return EHttpServerRequestVerbs::VERB_NONE;
+	}
+}
+
+FDTHttpServerBatch::FDTHttpServerBatch(int32 NumRequests, const FDTHttpServerPromise& InPromise)
+	: m_Remaining(NumRequests)
+	, m_Promise(InPromise)
+{
+	m_Responses.SetNum(NumRequests);
+}
+
+// 创建子请求
+TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> FDTHttpServerBatch::MakeRequest(const FHttpServerRequest& Parent, const FDTHttpServerBatchRequest& SubRequest)
+{
+	TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> Request = MakeShared<FHttpServerRequest, ESPMode::ThreadSafe>();
+	Request->Verb = DTHttpServer::ParseBatchVerb(SubRequest.Verb);
+	Request->PeerAddress = Parent.PeerAddress;
+
+	// 路径中的查询字符串和单独的查询参数合并
+	FString Path = SubRequest.Path;
+	int32 QueryIndex = INDEX_NONE;
+	if ( Path.FindChar(TEXT('?'), QueryIndex) )
+	{
+		TArray<FString> Pairs;
+		Path.Mid(QueryIndex + 1).ParseIntoArray(Pairs, TEXT("&"));
+		for ( const FString & Pair : Pairs )
+		{
+			FString Key, Value;
+			if ( !Pair.Split(TEXT("="), &Key, &Value) ) { Key = Pair; }
+			Request->QueryParams.Add(MoveTemp(Key), MoveTemp(Value));
+		}
+		Path.LeftInline(QueryIndex);
+	}
+	if ( !Path.StartsWith(TEXT("/")) )
+	{
+		Path.InsertAt(0, TEXT('/'));
+	}
+	Request->RelativePath = FHttpPath(Path);
+	Request->QueryParams.Append(SubRequest.Query);
+
+	// 子请求的返回嵌入到外层返回, 由外层统一压缩
+	Request->Headers = Parent.Headers;
+	Request->Headers.Remove(TEXT("Accept-Encoding"));
+	Request->Headers.Remove(TEXT("Content-Length"));
+	Request->Headers.Remove(TEXT("If-None-Match"));
+	Request->Headers.Remove(TEXT("If-Modified-Since"));
+	Request->Headers.Remove(TEXT("If-Range"));
+	Request->Headers.Remove(TEXT("Range"));
+	for ( const TPair<FString, FString> & Header : SubRequest.Headers )
+	{
+		Request->Headers.Add(Header.Key, { Header.Value });
+	}
+
+	if ( !SubRequest.Body.IsEmpty() )
+	{
+		const FTCHARToUTF8 BodyConverter(*SubRequest.Body, SubRequest.Body.Len());
+		Request->Body.Append((const uint8 *)BodyConverter.Get(), BodyConverter.Length());
+	}
+	return Request;
+}
+
+// 只有返回码的返回
+TUniquePtr<FHttpServerResponse> FDTHttpServerBatch::MakeStatusResponse(EHttpServerResponseCodes Code)
+{
+	TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+	Response->Code = Code;
+	return Response;
+}
+
+// 子请求完成回调
+FHttpResultCallback FDTHttpServerBatch::MakeCallback(int32 Index)
+{
+	return [Batch = AsShared(), Index](TUniquePtr<FHttpServerResponse>&& Response)
+	{
+		Batch->SetResponse(Index, MoveTemp(Response));
+	};
+}
+
+// 保存子请求返回
+void FDTHttpServerBatch::SetResponse(int32 Index, TUniquePtr<FHttpServerResponse>&& Response)
+{
+	m_Responses[Index] = Response.IsValid() ? MoveTemp(Response) : MakeStatusResponse(EHttpServerResponseCodes::ServerError);
+	if ( m_Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+	{
+		Finish();
+	}
+}
+
+// 合并返回
+void FDTHttpServerBatch::Finish()
+{
+	FDTHttpServerNativeResponse NativeResponse;
+	NativeResponse.ContentType = TEXT("application/json;charset=utf-8");
+	TArray<uint8> & Body = NativeResponse.Body;
+
+	int64 ReserveBytes = 2;
+	for ( const TUniquePtr<FHttpServerResponse> & Response : m_Responses )
+	{
+		ReserveBytes += Response->Body.Num() + 128;
+	}
+	Body.Reserve(ReserveBytes);
+
+	Body.Add('[');
+	for ( int32 Index = 0; Index < m_Responses.Num(); ++Index )
+	{
+		const FHttpServerResponse & Response = *m_Responses[Index];
+		if ( Index > 0 ) { Body.Add(','); }
+
+		DTHttpServer::AppendBatchText(Body, "{\"status\":");
+		DTHttpServer::AppendBatchText(Body, TCHAR_TO_ANSI(*FString::FromInt((int32)Response.Code)));
+
+		// 跨域头由外层返回
+		FString ContentType;
+		DTHttpServer::AppendBatchText(Body, ",\"headers\":{");
+		bool bFirstHeader = true;
+		for ( const TPair<FString, TArray<FString>> & Header : Response.Headers )
+		{
+			if ( Header.Key.StartsWith(TEXT("Access-Control-")) || Header.Key.Equals(TEXT("Content-Length"), ESearchCase::IgnoreCase) ) { continue; }
+			if ( Header.Key.Equals(TEXT("Content-Type"), ESearchCase::IgnoreCase) && Header.Value.Num() > 0 )
+			{
+				ContentType = Header.Value[0];
+			}
+			if ( !bFirstHeader ) { Body.Add(','); }
+			bFirstHeader = false;
+			FDTHttpServerJson::WriteString(Header.Key, Body);
+			Body.Add(':');
+			FDTHttpServerJson::WriteString(FString::Join(Header.Value, TEXT(", ")), Body);
+		}
+		Body.Add('}');
+
+		if ( Response.Body.Num() > 0 )
+		{
+			if ( ContentType.Contains(TEXT("json")) && FDTHttpServerJson::IsValid(Response.Body) )
+			{
+				DTHttpServer::AppendBatchText(Body, ",\"body\":");
+				Body.Append(Response.Body);
+			}
+			else if ( DTHttpServer::IsBatchTextType(ContentType) )
+			{
+				const FUTF8ToTCHAR BodyConverter((const ANSICHAR *)Response.Body.GetData(), Response.Body.Num());
+				DTHttpServer::AppendBatchText(Body, ",\"body\":");
+				FDTHttpServerJson::WriteString(FStringView(BodyConverter.Get(), BodyConverter.Length()), Body);
+			}
+			else
+			{
+				DTHttpServer::AppendBatchText(Body, ",\"encoding\":\"base64\",\"body\":\"");
+				const FString Encoded = FBase64::Encode(Response.Body);
+				DTHttpServer::AppendBatchText(Body, TCHAR_TO_ANSI(*Encoded));
+				Body.Add('"');
+			}
+		}
+		Body.Add('}');
+	}
+	Body.Add(']');
+
+	m_Responses.Empty();
+	m_Promise.SetValue(MoveTemp(NativeResponse));
+}
@@ -0,0 +1,37 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerNative.h"
+#include <atomic>
+
+// 批量请求, 子请求可以在任意线程中完成, 全部完成后合并为一个 JSON 数组返回
+// 每个子请求只写自己的位置, 最后一个完成的子请求负责合并
+class FDTHttpServerBatch : public TSharedFromThis<FDTHttpServerBatch, ESPMode::ThreadSafe>
+{
+public:
+	FDTHttpServerBatch(int32 NumRequests, const FDTHttpServerPromise & InPromise);
+
+	// 根据子请求创建请求对象, 继承外层请求的地址和头, 去掉压缩和条件请求相关的头
+	static TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> MakeRequest(const FHttpServerRequest & Parent, const FDTHttpServerBatchRequest & SubRequest);
+
+	// 只有返回码的返回
+	static TUniquePtr<FHttpServerResponse> MakeStatusResponse(EHttpServerResponseCodes Code);
+
+	// 子请求的完成回调
+	FHttpResultCallback MakeCallback(int32 Index);
+
+private:
+	// 保存子请求返回, 全部完成时合并
+	void SetResponse(int32 Index, TUniquePtr<FHttpServerResponse> && Response);
+
+	// 合并返回, JSON 数据直接嵌入, 文本写成字符串, 其它数据使用 base64
+	void Finish();
+
+private:
+	TArray<TUniquePtr<FHttpServerResponse>>	m_Responses;
+	std::atomic<int32>						m_Remaining;
+	FDTHttpServerPromise					m_Promise;
+};
@@ -0,0 +1,279 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerBenchmarkCommandlet.h"
+#include "DTHttpServer.h"
+#include "DTHttpServerObject.h"
+#include "DTHttpServerLoadGenerator.h"
+#include "DTHttpServerMetrics.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Ticker.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace DTHttpServer
+{
+	// 压测返回数据, 和一般接口返回的小 JSON 大小相当
+	static FDTHttpServerNativeResponse MakeBenchmarkResponse()
+	{
+		static const FTCHARToUTF8 Body(TEXT("{\"status\":\"ok\",\"position\":{\"longitude\":116.391,\"latitude\":39.907,\"height\":52.5}}"));
+		FDTHttpServerNativeResponse Response;
+		Response.ContentType = TEXT("application/json");
+		Response.Body.Append((const uint8*)Body.Get(), Body.Length());
+		return Response;
+	}
+
+	// 压测上传数据, 一个文件的 multipart 请求
+	static TArray<uint8> MakeBenchmarkMultipart(const FString & Boundary, int32 FileBytes)
+	{
+		const FTCHARToUTF8 Head(*FString::Printf(TEXT("--%s\r\nContent-Disposition: form-data; name=\"file\"; filename=\"bench.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n"), *Boundary));
+		const FTCHARToUTF8 Tail(*FString::Printf(TEXT("\r\n--%s--\r\n"), *Boundary));
+		TArray<uint8> Body;
+		Body.Reserve(Head.Length() + FileBytes + Tail.Length());
+		Body.Append((const uint8*)Head.Get(), Head.Length());
+		for ( int32 Index = 0; Index < FileBytes; ++Index )
+		{
+			Body.Add('a' + Index % 26);
+		}
+		Body.Append((const uint8*)Tail.Get(), Tail.Length());
+		return Body;
+	}
+
+	// 模拟游戏逻辑, 占用游戏线程指定的时间
+	static void RunBenchmarkWorkload(double Seconds)
+	{
+		const double EndTime = FPlatformTime::Seconds() + Seconds;
+		volatile double Value = 0.0;
+		while ( FPlatformTime::Seconds() < EndTime )
+		{
+			for ( int32 Index = 0; Index < 256; ++Index )
+			{
+				Value = Value + FMath::Sin(Value + Index);
+			}
+		}
+	}
+
+	// 直方图转 JSON, 单位毫秒
+	static FString BenchmarkPercentilesToJson(const FDTHttpServerHistogram & Histogram, uint64 MaxMicroseconds)
+	{
+		const double Mean = Histogram.Count > 0 ? Histogram.SumMicroseconds / 1000.0 / Histogram.Count : 0.0;
+		return FString::Printf(TEXT("{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}"),
+			Mean, Histogram.GetPercentile(0.5) * 1000.0, Histogram.GetPercentile(0.9) * 1000.0, Histogram.GetPercentile(0.99) * 1000.0,
+			Histogram.GetPercentile(0.999) * 1000.0, MaxMicroseconds / 1000.0);
+	}
+}
+
+UDTHttpServerBenchmarkCommandlet::UDTHttpServerBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UDTHttpServerBenchmarkCommandlet::Main(const FString& Params)
+{
+	// 压测参数
+	int32 Port = 8089;
+	int32 Concurrency = 16;
+	int32 BodyBytes = 1024;
+	int32 UploadBytes = 1024 * 1024;
+	int32 FrameRate = 60;
+	float Seconds = 10.0f;
+	float Warmup = 2.0f;
+	float WorkloadMs = 8.0f;
+	bool bKeepAlive = true;
+	FString Routes = TEXT("native,queued,pool,echo");
+	FString Output;
+	FParse::Value(*Params, TEXT("Port="), Port);
+	FParse::Value(*Params, TEXT("Concurrency="), Concurrency);
+	FParse::Value(*Params, TEXT("BodyBytes="), BodyBytes);
+	FParse::Value(*Params, TEXT("UploadBytes="), UploadBytes);
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	FParse::Value(*Params, TEXT("Warmup="), Warmup);
+	FParse::Value(*Params, TEXT("WorkloadMs="), WorkloadMs);
+	FParse::Bool(*Params, TEXT("KeepAlive="), bKeepAlive);
+	FParse::Value(*Params, TEXT("Routes="), Routes);
+	FParse::Value(*Params, TEXT("Output="), Output);
+	Concurrency = FMath::Max(Concurrency, 1);
+	BodyBytes = FMath::Max(BodyBytes, 0);
+	UploadBytes = FMath::Max(UploadBytes, 0);
+	FrameRate = FMath::Max(FrameRate, 1);
+
+	// 启动服务器, 记录压测前的物理内存
+	const uint64 StartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	UDTHttpServerObject * HttpServer = nullptr;
+	UDTHttpServerObject::CreateHttpServer(Port, HttpServer);
+	HttpServer->AddToRoot();
+
+	// 常见的几种接口, 分别在路由回调中, 游戏线程队列中和线程池中执行
+	TArray<FString> RouteNames;
+	Routes.ParseIntoArray(RouteNames, TEXT(","));
+	FDTHttpServerLoadGenerator::FSettings Settings;
+	Settings.Port = Port;
+	Settings.Concurrency = Concurrency;
+	Settings.bKeepAlive = bKeepAlive;
+	for ( const FString & RouteName : RouteNames )
+	{
+		FDTHttpServerRouteOptions Options;
+		FDTHttpServerLoadGenerator::FTarget Target;
+		Target.Path = FString::Printf(TEXT("/bench/%s"), *RouteName);
+		if ( RouteName == TEXT("native") )
+		{
+			Options.Execution = EDTHttpServerExecution::Inline;
+		}
+		else if ( RouteName == TEXT("queued") )
+		{
+			Options.Execution = EDTHttpServerExecution::Queued;
+		}
+		else if ( RouteName == TEXT("pool") )
+		{
+			Options.Execution = EDTHttpServerExecution::ThreadPool;
+		}
+		else if ( RouteName == TEXT("echo") )
+		{
+			// 原样返回请求数据, 测试请求和返回数据的拷贝
+			Options.Execution = EDTHttpServerExecution::ThreadPool;
+			HttpServer->BindNative(Target.Path, EDTHttpServerVerbs::POST, [](const FDTHttpServerNativeRequest& Request)
+			{
+				FDTHttpServerNativeResponse Response;
+				Response.ContentType = TEXT("application/octet-stream");
+				Response.Body.Append(Request.GetBody().GetData(), Request.GetBody().Num());
+				return Response;
+			}, Options);
+			Target.Verb = TEXT("POST");
+			Target.BodyBytes = BodyBytes;
+			Settings.Targets.Add(Target);
+			continue;
+		}
+		else if ( RouteName == TEXT("upload") )
+		{
+			// multipart 上传, 数据在块回调中丢弃, 测试上传解析的内存和延迟
+			FDTHttpServerUploadOptions UploadOptions;
+			UploadOptions.MaxMegabytes = FMath::Max(UploadBytes / (1024 * 1024) + 1, UploadOptions.MaxMegabytes);
+			UploadOptions.Checksum = EDTHttpServerChecksum::None;
+			HttpServer->BindUploadNative(Target.Path, UploadOptions, [](const FDTHttpServerNativeRequest& Request, const FDTHttpServerUploadResult& Upload)
+			{
+				return DTHttpServer::MakeBenchmarkResponse();
+			}, [](const FDTHttpServerUploadedFile& File, TArrayView<const uint8> Chunk)
+			{
+				return true;
+			});
+			const FString Boundary = TEXT("DTHttpServerBenchmarkBoundary");
+			Target.Verb = TEXT("POST");
+			Target.ContentType = FString::Printf(TEXT("multipart/form-data; boundary=%s"), *Boundary);
+			Target.Body = DTHttpServer::MakeBenchmarkMultipart(Boundary, UploadBytes);
+			Settings.Targets.Add(Target);
+			continue;
+		}
+		else
+		{
+			UE_LOG(LogDTHttpServer, Warning, TEXT("Benchmark, unknown route : %s"), *RouteName);
+			continue;
+		}
+		HttpServer->BindNative(Target.Path, EDTHttpServerVerbs::GET, [](const FDTHttpServerNativeRequest& Request)
+		{
+			return DTHttpServer::MakeBenchmarkResponse();
+		}, Options);
+		Settings.Targets.Add(Target);
+	}
+
+	FDTHttpServerLoadGenerator LoadGenerator(Settings);
+	if ( !LoadGenerator.Start() )
+	{
+		UE_LOG(LogDTHttpServer, Error, TEXT("Benchmark, load generator failed to start"));
+		HttpServer->RemoveFromRoot();
+		return 1;
+	}
+
+	// 模拟游戏循环, 记录每帧服务器在游戏线程上占用的时间
+	const double FrameSeconds = 1.0 / FrameRate;
+	const double StartTime = FPlatformTime::Seconds();
+	const double RecordTime = StartTime + FMath::Max(Warmup, 0.0f);
+	const double EndTime = RecordTime + FMath::Max(Seconds, 0.1f);
+	FDTHttpServerHistogram Stolen;
+	FDTHttpServerHistogram FrameTime;
+	uint64 MaxStolen = 0;
+	uint64 MaxFrameTime = 0;
+	bool bRecording = false;
+	double LastFrameTime = StartTime;
+	int32 PeakQueueDepth = 0;
+	while ( FPlatformTime::Seconds() < EndTime )
+	{
+		const double FrameStart = FPlatformTime::Seconds();
+		const float DeltaTime = (float)(FrameStart - LastFrameTime);
+		LastFrameTime = FrameStart;
+		if ( !bRecording && FrameStart >= RecordTime )
+		{
+			bRecording = true;
+			LoadGenerator.SetRecording(true);
+		}
+
+		// 服务器占用的时间, 包括引擎监听处理, 路由回调和请求队列
+		const uint64 ServerStart = FPlatformTime::Cycles64();
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+		HttpServer->Tick(DeltaTime);
+		const uint64 ServerMicroseconds = (uint64)(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - ServerStart) * 1000000.0);
+
+		// 游戏逻辑
+		DTHttpServer::RunBenchmarkWorkload(WorkloadMs / 1000.0);
+
+		// 等待下一帧
+		const double Remaining = FrameSeconds - (FPlatformTime::Seconds() - FrameStart);
+		if ( Remaining > 0.0 )
+		{
+			FPlatformProcess::SleepNoStats((float)Remaining);
+		}
+
+		if ( bRecording )
+		{
+			const uint64 FrameMicroseconds = (uint64)((FPlatformTime::Seconds() - FrameStart) * 1000000.0);
+			Stolen.Record(ServerMicroseconds);
+			FrameTime.Record(FrameMicroseconds);
+			MaxStolen = FMath::Max(MaxStolen, ServerMicroseconds);
+			MaxFrameTime = FMath::Max(MaxFrameTime, FrameMicroseconds);
+			PeakQueueDepth = FMath::Max(PeakQueueDepth, HttpServer->GetQueueStats().QueueDepth);
+		}
+	}
+	const double RecordedSeconds = FPlatformTime::Seconds() - RecordTime;
+	LoadGenerator.SetRecording(false);
+	LoadGenerator.Stop();
+
+	// 还在处理的请求返回后再关闭服务器
+	FTSTicker::GetCoreTicker().Tick((float)FrameSeconds);
+	HttpServer->RemoveFromRoot();
+	HttpServer->MarkAsGarbage();
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	// 输出结果, 峰值物理内存为整个进程的峰值
+	const FDTHttpServerLoadGenerator::FResult Result = LoadGenerator.GetResult();
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+	const FString Json = FString::Printf(
+		TEXT("{\"routes\":\"%s\",\"concurrency\":%d,\"keepAlive\":%s,\"bodyBytes\":%d,\"uploadBytes\":%d,\"seconds\":%.3f,")
+		TEXT("\"requests\":%llu,\"errors\":%llu,\"non2xx\":%llu,\"connects\":%llu,\"responseBytes\":%llu,\"requestsPerSecond\":%.1f,")
+		TEXT("\"latencyMs\":%s,\"ttfbMs\":%s,\"frameRate\":%d,\"workloadMs\":%.3f,\"frames\":%llu,")
+		TEXT("\"stolenMsPerFrame\":%s,\"frameMs\":%s,\"peakQueueDepth\":%d,")
+		TEXT("\"startUsedPhysicalBytes\":%llu,\"peakUsedPhysicalBytes\":%llu}"),
+		*Routes, Concurrency, bKeepAlive ? TEXT("true") : TEXT("false"), BodyBytes, UploadBytes, RecordedSeconds,
+		Result.Requests, Result.Errors, Result.Non2xx, Result.Connects, Result.ResponseBytes, Result.Requests / FMath::Max(RecordedSeconds, 0.001),
+		*DTHttpServer::BenchmarkPercentilesToJson(Result.Latency, Result.MaxMicroseconds),
+		*DTHttpServer::BenchmarkPercentilesToJson(Result.FirstByte, Result.MaxFirstByteMicroseconds), FrameRate, WorkloadMs, Stolen.Count,
+		*DTHttpServer::BenchmarkPercentilesToJson(Stolen, MaxStolen), *DTHttpServer::BenchmarkPercentilesToJson(FrameTime, MaxFrameTime), PeakQueueDepth,
+		(uint64)StartUsedPhysical, (uint64)MemoryStats.PeakUsedPhysical);
+	UE_LOG(LogDTHttpServer, Display, TEXT("Benchmark result : %s"), *Json);
+
+	if ( !Output.IsEmpty() )
+	{
+		const FString OutputPath = FPaths::IsRelative(Output) ? FPaths::Combine(FPaths::ProjectSavedDir(), Output) : Output;
+		if ( !FFileHelper::SaveStringToFile(Json, *OutputPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM) )
+		{
+			UE_LOG(LogDTHttpServer, Error, TEXT("Benchmark, failed to write : %s"), *OutputPath);
+			return 1;
+		}
+	}
+	return Result.Errors > 0 || Result.Requests == 0 ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DTHttpServerBenchmarkCommandlet.generated.h"
+
+// 服务器压测, 在本机启动服务器并用内置的负载生成器压测, 同时在游戏线程模拟每帧的工作量
+// UnrealEditor-Cmd Project.uproject -run=DTHttpServerBenchmark -nullrhi -unattended
+//     Port=8089 Concurrency=16 KeepAlive=1 BodyBytes=1024 UploadBytes=1048576 Routes=native,queued,pool,echo,upload
+//     Seconds=10 Warmup=2 FrameRate=60 WorkloadMs=8 Output=Benchmark.json
+// upload 接口发送 UploadBytes 大小文件的 multipart 请求, 数据由块回调丢弃不写入磁盘
+// 结果以一行 JSON 输出到日志, 包括首字节时间和进程的峰值物理内存, 设置 Output 时同时写入文件
+UCLASS()
+class UDTHttpServerBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDTHttpServerBenchmarkCommandlet();
+
+	virtual int32 Main(const FString & Params) override;
+};
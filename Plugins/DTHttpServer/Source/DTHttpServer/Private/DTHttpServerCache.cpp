@@ -0,0 +1,227 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerCache.h"
+#include "Misc/ScopeLock.h"
+#include "Hash/CityHash.h"
+
+namespace DTHttpServer
+{
+	// 去掉 ETag 的弱标记和压缩后缀
+	static FStringView NormalizeETag(FStringView ETag)
+	{
+		ETag.TrimStartAndEndInline();
+		if ( ETag.StartsWith(TEXT("W/")) ) { ETag.RightChopInline(2); }
+		for ( const TCHAR * Suffix : { TEXT("-gzip\""), TEXT("-deflate\"") } )
+		{
+			if ( ETag.EndsWith(Suffix) )
+			{
+				ETag.LeftChopInline(FCString::Strlen(Suffix));
+				return ETag;
+			}
+		}
+		return ETag.EndsWith(TEXT('"')) ? ETag.LeftChop(1) : ETag;
+	}
+
+	// 缓存占用大小
+	static int64 GetCachedResponseBytes(const FDTHttpServerCachedResponse & CachedResponse)
+	{
+		return CachedResponse.Body.Num() + CachedResponse.Path.Len() * sizeof(TCHAR);
+	}
+}
+
+FDTHttpServerResponseCache::FDTHttpServerResponseCache(int64 InMaxBytes)
+	: m_MaxBytes(FMath::Max<int64>(InMaxBytes, 0))
+{
+}
+
+// 生成缓存键
+FString FDTHttpServerResponseCache::MakeKey(const FHttpServerRequest& Request)
+{
+	FString Key = Request.RelativePath.GetPath();
+	if ( Request.QueryParams.Num() == 0 ) { return Key; }
+
+	// 查询参数顺序不影响结果
+	TArray<const TPair<FString, FString>*, TInlineAllocator<8>> QueryParams;
+	for ( const auto & QueryParam : Request.QueryParams )
+	{
+		QueryParams.Add(&QueryParam);
+	}
+	QueryParams.Sort([](const TPair<FString, FString> & A, const TPair<FString, FString> & B)
+	{
+		return A.Key.Compare(B.Key, ESearchCase::CaseSensitive) < 0;
+	});
+
+	TCHAR Separator = TEXT('?');
+	for ( const TPair<FString, FString> * QueryParam : QueryParams )
+	{
+		Key.AppendChar(Separator);
+		Key.Append(QueryParam->Key);
+		Key.AppendChar(TEXT('='));
+		Key.Append(QueryParam->Value);
+		Separator = TEXT('&');
+	}
+	return Key;
+}
+
+// 生成 ETag
+FString FDTHttpServerResponseCache::MakeETag(TArrayView<const uint8> Body)
+{
+	const uint64 Hash = CityHash64((const char*)Body.GetData(), Body.Num());
+	return FString::Printf(TEXT("\"%016llx%x\""), Hash, Body.Num());
+}
+
+// 比较 If-None-Match
+bool FDTHttpServerResponseCache::MatchesETag(const TArray<FString>& IfNoneMatch, const FString& ETag)
+{
+	const FStringView Expected = DTHttpServer::NormalizeETag(ETag);
+	for ( const FString & Value : IfNoneMatch )
+	{
+		FStringView Remaining = Value;
+		while ( !Remaining.IsEmpty() )
+		{
+			int32 CommaIndex = INDEX_NONE;
+			FStringView Token = Remaining.FindChar(TEXT(','), CommaIndex) ? Remaining.Left(CommaIndex) : Remaining;
+			Remaining = CommaIndex == INDEX_NONE ? FStringView() : Remaining.Mid(CommaIndex + 1);
+
+			Token.TrimStartAndEndInline();
+			if ( Token == TEXT("*") || DTHttpServer::NormalizeETag(Token) == Expected ) { return true; }
+		}
+	}
+	return false;
+}
+
+// 查找返回
+FDTHttpServerCachedResponsePtr FDTHttpServerResponseCache::Find(const FString& Key) const
+{
+	FScopeLock ScopeLock(&m_Lock);
+	const FEntry * Entry = m_Entries.Find(Key);
+	if ( Entry == nullptr ) { return nullptr; }
+
+	// 过期的数据在下次保存时清理
+	const double ExpireTime = Entry->Response->ExpireTime;
+	if ( ExpireTime > 0.0 && ExpireTime <= FPlatformTime::Seconds() ) { return nullptr; }
+	return Entry->Response;
+}
+
+// 失效计数
+uint64 FDTHttpServerResponseCache::GetGeneration(const FString& Path) const
+{
+	FScopeLock ScopeLock(&m_Lock);
+	return GetGenerationLocked(Path);
+}
+
+uint64 FDTHttpServerResponseCache::GetGenerationLocked(const FString& Path) const
+{
+	return m_Generation + m_PathGenerations.FindRef(Path);
+}
+
+// 保存返回
+void FDTHttpServerResponseCache::Add(const FString& Key, const FDTHttpServerCachedResponsePtr& CachedResponse, uint64 Generation)
+{
+	const int64 Bytes = DTHttpServer::GetCachedResponseBytes(*CachedResponse);
+
+	// 容量由游戏线程每帧设置, 加锁后再比较
+	FScopeLock ScopeLock(&m_Lock);
+	if ( Bytes > m_MaxBytes ) { return; }
+
+	// 处理请求期间路径已失效, 返回可能是旧数据
+	if ( GetGenerationLocked(CachedResponse->Path) != Generation ) { return; }
+	if ( const FEntry * OldEntry = m_Entries.Find(Key) )
+	{
+		m_UsedBytes -= DTHttpServer::GetCachedResponseBytes(*OldEntry->Response);
+	}
+
+	FEntry & Entry = m_Entries.Add(Key);
+	Entry.Response = CachedResponse;
+	Entry.Sequence = ++m_Sequence;
+	m_UsedBytes += Bytes;
+	Trim();
+}
+
+// 按路径失效
+void FDTHttpServerResponseCache::Invalidate(const FString& Path)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	if ( Path.IsEmpty() )
+	{
+		++m_Generation;
+		m_Entries.Empty();
+		m_UsedBytes = 0;
+		return;
+	}
+
+	++m_PathGenerations.FindOrAdd(Path);
+	for ( auto It = m_Entries.CreateIterator(); It; ++It )
+	{
+		if ( It->Value.Response->Path.Equals(Path, ESearchCase::CaseSensitive) )
+		{
+			m_UsedBytes -= DTHttpServer::GetCachedResponseBytes(*It->Value.Response);
+			It.RemoveCurrent();
+		}
+	}
+}
+
+// 设置缓存容量
+void FDTHttpServerResponseCache::SetMaxBytes(int64 InMaxBytes)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	m_MaxBytes = FMath::Max<int64>(InMaxBytes, 0);
+	Trim();
+}
+
+// 淘汰数据
+void FDTHttpServerResponseCache::Trim()
+{
+	if ( m_UsedBytes <= m_MaxBytes ) { return; }
+
+	// 先清理过期数据
+	const double Now = FPlatformTime::Seconds();
+	for ( auto It = m_Entries.CreateIterator(); It; ++It )
+	{
+		const double ExpireTime = It->Value.Response->ExpireTime;
+		if ( ExpireTime > 0.0 && ExpireTime <= Now )
+		{
+			m_UsedBytes -= DTHttpServer::GetCachedResponseBytes(*It->Value.Response);
+			It.RemoveCurrent();
+		}
+	}
+
+	// 再淘汰最早保存的数据
+	while ( m_UsedBytes > m_MaxBytes && m_Entries.Num() > 0 )
+	{
+		const TPair<FString, FEntry> * Oldest = nullptr;
+		for ( const auto & Entry : m_Entries )
+		{
+			if ( Oldest == nullptr || Entry.Value.Sequence < Oldest->Value.Sequence ) { Oldest = &Entry; }
+		}
+		const FString OldestKey = Oldest->Key;
+		m_UsedBytes -= DTHttpServer::GetCachedResponseBytes(*Oldest->Value.Response);
+		m_Entries.Remove(OldestKey);
+	}
+}
+
+// 保存返回
+void FDTHttpServerCacheStore::Apply(FHttpServerResponse& Response) const
+{
+	if ( !IsEnabled() || Response.Code != EHttpServerResponseCodes::Ok ) { return; }
+
+	const FString ETag = FDTHttpServerResponseCache::MakeETag(Response.Body);
+	Response.Headers.Add(TEXT("ETag"), { ETag });
+
+	TSharedRef<FDTHttpServerCachedResponse, ESPMode::ThreadSafe> CachedResponse = MakeShared<FDTHttpServerCachedResponse, ESPMode::ThreadSafe>();
+	CachedResponse->Path = Path;
+	CachedResponse->Code = Response.Code;
+	CachedResponse->Headers = Response.Headers;
+	CachedResponse->Body = Response.Body;
+	CachedResponse->ETag = ETag;
+	CachedResponse->ExpireTime = TtlSeconds > 0.0 ? FPlatformTime::Seconds() + TtlSeconds : 0.0;
+	Cache->Add(Key, CachedResponse, Generation);
+
+	// 客户端已有相同数据
+	if ( FDTHttpServerResponseCache::MatchesETag(IfNoneMatch, ETag) )
+	{
+		Response.Code = EHttpServerResponseCodes::NotModified;
+		Response.Body.Empty();
+	}
+}
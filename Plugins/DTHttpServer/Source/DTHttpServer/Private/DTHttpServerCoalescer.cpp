@@ -0,0 +1,131 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerCoalescer.h"
+#include "DTHttpServerCache.h"
+
+namespace DTHttpServer
+{
+	// 追加请求头到合并键
+	static void AppendCoalesceHeader(FString & Key, const FHttpServerRequest & Request, const TCHAR * Name)
+	{
+		Key.AppendChar(TEXT('\n'));
+		if ( const TArray<FString> * Values = Request.Headers.Find(Name) )
+		{
+			Key.Append(FString::Join(*Values, TEXT(",")));
+		}
+	}
+}
+
+FDTHttpServerCoalescer::FDTHttpServerCoalescer(double InMaxWaitSeconds, const TArray<FString>& InKeyHeaders, const FDTHttpServerRouteMetricsPtr& InMetrics)
+	: m_KeyHeaders(InKeyHeaders)
+	, m_Metrics(InMetrics)
+	, m_MaxWaitSeconds(FMath::Max(InMaxWaitSeconds, 0.0))
+{
+}
+
+// 设置合并键
+void FDTHttpServerCoalescer::SetKeyFunction(FDTHttpServerCoalesceKeyFunction&& InKeyFunction)
+{
+	m_KeyFunction = MoveTemp(InKeyFunction);
+}
+
+// 生成合并键
+FString FDTHttpServerCoalescer::MakeKey(const FHttpServerRequest& Request) const
+{
+	FString Key = m_KeyFunction ? m_KeyFunction(Request) : FDTHttpServerResponseCache::MakeKey(Request);
+	for ( const FString & Header : m_KeyHeaders )
+	{
+		DTHttpServer::AppendCoalesceHeader(Key, Request, *Header);
+	}
+
+	// 压缩格式和条件请求会改变返回内容
+	DTHttpServer::AppendCoalesceHeader(Key, Request, TEXT("Accept-Encoding"));
+	DTHttpServer::AppendCoalesceHeader(Key, Request, TEXT("If-None-Match"));
+	DTHttpServer::AppendCoalesceHeader(Key, Request, TEXT("If-Modified-Since"));
+	DTHttpServer::AppendCoalesceHeader(Key, Request, TEXT("Range"));
+	return Key;
+}
+
+// 执行请求
+bool FDTHttpServerCoalescer::Run(const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete, const FDTHttpServerRouteHandler& Handler)
+{
+	FString Key = MakeKey(Request);
+	const double Now = FPlatformTime::Seconds();
+
+	// 等待正在执行的相同请求, 请求在返回前需要保留
+	if ( FFlight * Flight = m_Flights.Find(Key) )
+	{
+		if ( Now < Flight->Deadline )
+		{
+			Flight->Waiters.Add(FWaiter{ MakeShared<FHttpServerRequest, ESPMode::ThreadSafe>(Request), PathParams, OnComplete, Now + m_MaxWaitSeconds });
+			return true;
+		}
+		return Handler(Request, PathParams, OnComplete);
+	}
+
+	FFlight & NewFlight = m_Flights.Add(Key);
+	NewFlight.Handler = Handler;
+	NewFlight.Deadline = Now + m_MaxWaitSeconds;
+
+	// 返回在游戏线程上完成, 先发给等待的请求再发给自己
+	TWeakPtr<FDTHttpServerCoalescer, ESPMode::ThreadSafe> WeakThis = AsShared();
+	const bool bHandled = Handler(Request, PathParams, [WeakThis, Key, OnComplete](TUniquePtr<FHttpServerResponse>&& Response)
+	{
+		const TSharedPtr<FDTHttpServerCoalescer, ESPMode::ThreadSafe> This = WeakThis.Pin();
+		if ( This.IsValid() && Response.IsValid() )
+		{
+			This->Complete(Key, *Response);
+		}
+		OnComplete(MoveTemp(Response));
+	});
+	if ( !bHandled )
+	{
+		m_Flights.Remove(Key);
+	}
+	return bHandled;
+}
+
+// 发给等待的请求
+void FDTHttpServerCoalescer::Complete(const FString& Key, const FHttpServerResponse& Response)
+{
+	FFlight Flight;
+	if ( !m_Flights.RemoveAndCopyValue(Key, Flight) ) { return; }
+
+	// 引擎的每个连接需要自己的返回对象, 数据已经编码和压缩, 只做内存拷贝
+	for ( FWaiter & Waiter : Flight.Waiters )
+	{
+		if ( m_Metrics.IsValid() )
+		{
+			m_Metrics->RecordResponse(Response.Code, Response.Body.Num());
+		}
+		Waiter.OnComplete(MakeUnique<FHttpServerResponse>(Response));
+	}
+}
+
+// 等待超时的请求单独执行
+void FDTHttpServerCoalescer::Flush(double Now)
+{
+	TArray<FWaiter> Expired;
+	for ( TPair<FString, FFlight> & Flight : m_Flights )
+	{
+		for ( int32 Index = Flight.Value.Waiters.Num() - 1; Index >= 0; --Index )
+		{
+			if ( Flight.Value.Waiters[Index].Deadline <= Now )
+			{
+				Expired.Add(MoveTemp(Flight.Value.Waiters[Index]));
+				Flight.Value.Waiters.RemoveAtSwap(Index, 1, false);
+			}
+		}
+		for ( FWaiter & Waiter : Expired )
+		{
+			if ( !Flight.Value.Handler(*Waiter.Request, Waiter.PathParams, Waiter.OnComplete) )
+			{
+				TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+				Response->Code = EHttpServerResponseCodes::NotFound;
+				Waiter.OnComplete(MoveTemp(Response));
+			}
+		}
+		Expired.Reset();
+	}
+}
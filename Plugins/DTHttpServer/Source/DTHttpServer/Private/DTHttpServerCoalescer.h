@@ -0,0 +1,57 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerNative.h"
+#include "DTHttpServerMetrics.h"
+
+// 相同请求合并, 同一时间相同键的请求只执行一次回调, 其它请求等待并共享返回
+// 键总是包含影响返回内容的 Accept-Encoding 和条件请求头, 只在游戏线程使用
+class FDTHttpServerCoalescer : public TSharedFromThis<FDTHttpServerCoalescer, ESPMode::ThreadSafe>
+{
+public:
+	FDTHttpServerCoalescer(double InMaxWaitSeconds, const TArray<FString> & InKeyHeaders, const FDTHttpServerRouteMetricsPtr & InMetrics);
+
+	// 替换默认的路径加查询参数的键
+	void SetKeyFunction(FDTHttpServerCoalesceKeyFunction && InKeyFunction);
+
+	// 执行请求, 已有相同的请求在执行时等待它的返回
+	bool Run(const FHttpServerRequest & Request, const FDTHttpServerPathParams & PathParams, const FHttpResultCallback & OnComplete, const FDTHttpServerRouteHandler & Handler);
+
+	// 等待超时的请求单独执行
+	void Flush(double Now);
+
+private:
+	struct FWaiter
+	{
+		TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe>	Request;
+		FDTHttpServerPathParams										PathParams;
+		FHttpResultCallback											OnComplete;
+		double														Deadline = 0.0;
+	};
+
+	struct FFlight
+	{
+		FDTHttpServerRouteHandler	Handler;
+		TArray<FWaiter>				Waiters;
+		// 超过时间后新的请求不再加入
+		double						Deadline = 0.0;
+	};
+
+	// 生成合并键
+	FString MakeKey(const FHttpServerRequest & Request) const;
+
+	// 第一个请求完成, 返回数据发给所有等待的请求
+	void Complete(const FString & Key, const FHttpServerResponse & Response);
+
+private:
+	TMap<FString, FFlight>				m_Flights;
+	FDTHttpServerCoalesceKeyFunction	m_KeyFunction;
+	TArray<FString>						m_KeyHeaders;
+	FDTHttpServerRouteMetricsPtr		m_Metrics;
+	double								m_MaxWaitSeconds;
+};
+
+typedef TSharedPtr<FDTHttpServerCoalescer, ESPMode::ThreadSafe> FDTHttpServerCoalescerPtr;
@@ -0,0 +1,183 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerCompression.h"
+#include "Misc/Compression.h"
+#include "Misc/ScopeLock.h"
+#include "Hash/CityHash.h"
+
+namespace DTHttpServer
+{
+	// 压缩数据
+	static bool CompressBody(FName Format, TArrayView<const uint8> Body, TArray<uint8> & OutBody)
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(Format, Body.Num());
+		OutBody.SetNumUninitialized(CompressedSize, false);
+		if ( !FCompression::CompressMemory(Format, OutBody.GetData(), CompressedSize, Body.GetData(), Body.Num()) )
+		{
+			OutBody.Reset();
+			return false;
+		}
+		OutBody.SetNum(CompressedSize, false);
+		return true;
+	}
+
+	// 解析 Accept-Encoding 中的一项, 返回权重
+	static float ParseEncodingQuality(FStringView Token, FStringView & OutName)
+	{
+		int32 ParamIndex = INDEX_NONE;
+		OutName = Token.FindChar(TEXT(';'), ParamIndex) ? Token.Left(ParamIndex) : Token;
+		OutName.TrimStartAndEndInline();
+		if ( ParamIndex == INDEX_NONE ) { return 1.0f; }
+
+		FStringView Param = Token.Mid(ParamIndex + 1);
+		Param.TrimStartAndEndInline();
+		if ( !Param.StartsWith(TEXT("q="), ESearchCase::IgnoreCase) ) { return 1.0f; }
+		return FCString::Atof(*FString(Param.Mid(2)));
+	}
+}
+
+FDTHttpServerCompressionCache::FDTHttpServerCompressionCache(int64 InMaxBytes)
+	: m_MaxBytes(FMath::Max<int64>(InMaxBytes, 0))
+{
+}
+
+// 压缩数据
+bool FDTHttpServerCompressionCache::Compress(FName Format, TArrayView<const uint8> Body, TArray<uint8>& OutBody)
+{
+	FKey Key;
+	Key.Hash = CityHash64((const char*)Body.GetData(), Body.Num());
+	Key.Size = Body.Num();
+	Key.Format = Format;
+
+	// 命中缓存
+	{
+		FScopeLock ScopeLock(&m_Lock);
+		if ( FEntry * Entry = m_Entries.Find(Key) )
+		{
+			Entry->LastUse = ++m_UseCounter;
+			OutBody = Entry->Data;
+			return true;
+		}
+	}
+
+	// 压缩时不加锁, 同时压缩相同内容时只保留一份
+	if ( !DTHttpServer::CompressBody(Format, Body, OutBody) ) { return false; }
+
+	// 容量由游戏线程每帧设置, 加锁后再比较
+	FScopeLock ScopeLock(&m_Lock);
+	if ( OutBody.Num() > m_MaxBytes ) { return true; }
+	if ( !m_Entries.Contains(Key) )
+	{
+		FEntry & Entry = m_Entries.Add(Key);
+		Entry.Data = OutBody;
+		Entry.LastUse = ++m_UseCounter;
+		m_UsedBytes += OutBody.Num();
+		Trim();
+	}
+	return true;
+}
+
+// 设置缓存容量
+void FDTHttpServerCompressionCache::SetMaxBytes(int64 InMaxBytes)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	m_MaxBytes = FMath::Max<int64>(InMaxBytes, 0);
+	Trim();
+}
+
+// 已使用的缓存大小
+int64 FDTHttpServerCompressionCache::GetUsedBytes() const
+{
+	FScopeLock ScopeLock(&m_Lock);
+	return m_UsedBytes;
+}
+
+// 淘汰最久没有使用的数据, 缓存的都是大块数据, 数量很少, 直接遍历
+void FDTHttpServerCompressionCache::Trim()
+{
+	while ( m_UsedBytes > m_MaxBytes && m_Entries.Num() > 0 )
+	{
+		const TPair<FKey, FEntry> * Oldest = nullptr;
+		for ( const auto & Entry : m_Entries )
+		{
+			if ( Oldest == nullptr || Entry.Value.LastUse < Oldest->Value.LastUse ) { Oldest = &Entry; }
+		}
+		const FKey OldestKey = Oldest->Key;
+		m_UsedBytes -= Oldest->Value.Data.Num();
+		m_Entries.Remove(OldestKey);
+	}
+}
+
+// 选择压缩格式
+FDTHttpServerCompression FDTHttpServerCompression::Negotiate(const FHttpServerRequest& Request, int32 MinBytes, const FDTHttpServerCompressionCachePtr& Cache)
+{
+	FDTHttpServerCompression Compression;
+	const TArray<FString> * AcceptEncodings = Request.Headers.Find(TEXT("Accept-Encoding"));
+	if ( AcceptEncodings == nullptr ) { return Compression; }
+
+	float GzipQuality = -1.0f;
+	float DeflateQuality = -1.0f;
+	float AnyQuality = -1.0f;
+	for ( const FString & AcceptEncoding : *AcceptEncodings )
+	{
+		FStringView Remaining = AcceptEncoding;
+		while ( !Remaining.IsEmpty() )
+		{
+			int32 CommaIndex = INDEX_NONE;
+			const FStringView Token = Remaining.FindChar(TEXT(','), CommaIndex) ? Remaining.Left(CommaIndex) : Remaining;
+			Remaining = CommaIndex == INDEX_NONE ? FStringView() : Remaining.Mid(CommaIndex + 1);
+
+			FStringView Name;
+			const float Quality = DTHttpServer::ParseEncodingQuality(Token, Name);
+			if ( Name.Equals(TEXT("gzip"), ESearchCase::IgnoreCase) ) { GzipQuality = Quality; }
+			else if ( Name.Equals(TEXT("deflate"), ESearchCase::IgnoreCase) ) { DeflateQuality = Quality; }
+			else if ( Name.Equals(TEXT("*"), ESearchCase::IgnoreCase) ) { AnyQuality = Quality; }
+		}
+	}
+
+	// 没有单独列出时使用 * 的权重
+	if ( GzipQuality < 0.0f ) { GzipQuality = AnyQuality; }
+	if ( DeflateQuality < 0.0f ) { DeflateQuality = AnyQuality; }
+
+	if ( GzipQuality > 0.0f && GzipQuality >= DeflateQuality )
+	{
+		Compression.Format = NAME_Gzip;
+		Compression.ContentEncoding = TEXT("gzip");
+	}
+	else if ( DeflateQuality > 0.0f )
+	{
+		// HTTP 的 deflate 是带 zlib 头的数据
+		Compression.Format = NAME_Zlib;
+		Compression.ContentEncoding = TEXT("deflate");
+	}
+	Compression.MinBytes = MinBytes;
+	Compression.Cache = Cache;
+	return Compression;
+}
+
+// 压缩返回数据
+void FDTHttpServerCompression::Apply(FHttpServerResponse& Response) const
+{
+	if ( !ShouldCompress(Response.Body.Num()) ) { return; }
+
+	TArray<uint8> CompressedBody;
+	const bool bCompressed = Cache.IsValid() ? Cache->Compress(Format, Response.Body, CompressedBody) : DTHttpServer::CompressBody(Format, Response.Body, CompressedBody);
+	if ( !bCompressed || CompressedBody.Num() >= Response.Body.Num() ) { return; }
+
+	Response.Body = MoveTemp(CompressedBody);
+	Response.Headers.Add(TEXT("Content-Encoding"), { ContentEncoding });
+	Response.Headers.Add(TEXT("Vary"), { TEXT("Accept-Encoding") });
+
+	// 压缩后的数据是另一种表示, 强 ETag 需要区分
+	if ( TArray<FString> * ETags = Response.Headers.Find(TEXT("ETag")) )
+	{
+		for ( FString & ETag : *ETags )
+		{
+			if ( ETag.EndsWith(TEXT("\"")) )
+			{
+				ETag.InsertAt(ETag.Len() - 1, FString::Printf(TEXT("-%s"), ContentEncoding));
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerEvents.h"
+#include "Misc/ScopeLock.h"
+
+namespace DTHttpServer
+{
+	// 追加 UTF-8 文本
+	static void AppendUtf8(TArray<uint8> & Frame, FStringView Text)
+	{
+		const FTCHARToUTF8 TextConverter(Text.GetData(), Text.Len());
+		Frame.Append((const uint8*)TextConverter.Get(), TextConverter.Length());
+	}
+
+	// 编码一个事件, 多行数据拆成多个 data 字段
+	static TArray<uint8> EncodeEventFrame(uint64 EventId, const FString & EventName, const FString & Data)
+	{
+		TArray<uint8> Frame;
+		Frame.Reserve(Data.Len() + EventName.Len() + 32);
+
+		AppendUtf8(Frame, FString::Printf(TEXT("id: %llu\n"), EventId));
+		if ( !EventName.IsEmpty() )
+		{
+			AppendUtf8(Frame, TEXT("event: "));
+			AppendUtf8(Frame, EventName);
+			AppendUtf8(Frame, TEXT("\n"));
+		}
+
+		FStringView Remaining = Data;
+		do
+		{
+			int32 LineEnd = INDEX_NONE;
+			FStringView Line = Remaining.FindChar(TEXT('\n'), LineEnd) ? Remaining.Left(LineEnd) : Remaining;
+			Remaining = LineEnd == INDEX_NONE ? FStringView() : Remaining.Mid(LineEnd + 1);
+			Line.RemoveSuffix(Line.EndsWith(TEXT('\r')) ? 1 : 0);
+
+			AppendUtf8(Frame, TEXT("data: "));
+			AppendUtf8(Frame, Line);
+			AppendUtf8(Frame, TEXT("\n"));
+		}
+		while ( !Remaining.IsEmpty() );
+
+		AppendUtf8(Frame, TEXT("\n"));
+		return Frame;
+	}
+}
+
+FDTHttpServerEventStream::FDTHttpServerEventStream(int32 InReplayCapacity, int32 InRetryMilliseconds)
+{
+	m_Frames.SetNum(FMath::Max(InReplayCapacity, 1));
+
+	// 每次返回都带上重连时间, 收到返回后立即重连
+	DTHttpServer::AppendUtf8(m_RetryFrame, FString::Printf(TEXT("retry: %d\n\n"), FMath::Max(InRetryMilliseconds, 0)));
+}
+
+// 发布事件
+uint64 FDTHttpServerEventStream::Publish(const FString& EventName, const FString& Data)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	const uint64 EventId = ++m_LastEventId;
+	m_Frames[EventId % m_Frames.Num()] = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(DTHttpServer::EncodeEventFrame(EventId, EventName, Data));
+	return EventId;
+}
+
+// 订阅
+void FDTHttpServerEventStream::Subscribe(const FDTHttpServerPromise& Promise, uint64 LastEventId, double HoldSeconds)
+{
+	FScopeLock ScopeLock(&m_Lock);
+
+	// 新的连接或服务器重启过, 只接收之后的事件
+	if ( LastEventId == 0 || LastEventId > m_LastEventId )
+	{
+		LastEventId = m_LastEventId;
+	}
+
+	// 重连期间有新事件
+	if ( LastEventId < m_LastEventId )
+	{
+		Promise.SetValue(MakeResponse(LastEventId));
+		return;
+	}
+
+	m_Subscribers.Add(FSubscriber { Promise, LastEventId, FPlatformTime::Seconds() + HoldSeconds });
+}
+
+// 返回挂起的订阅
+void FDTHttpServerEventStream::Flush(double Now)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	const bool bHasEvents = m_FlushedEventId != m_LastEventId;
+	m_FlushedEventId = m_LastEventId;
+
+	for ( int32 Index = m_Subscribers.Num() - 1; Index >= 0; --Index )
+	{
+		FSubscriber & Subscriber = m_Subscribers[Index];
+
+		// 超时时只返回重连时间, 避免中间的代理断开连接
+		if ( bHasEvents || Subscriber.Deadline <= Now )
+		{
+			Subscriber.Promise.SetValue(MakeResponse(Subscriber.LastEventId));
+			m_Subscribers.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+// 挂起的订阅数
+int32 FDTHttpServerEventStream::NumSubscribers() const
+{
+	FScopeLock ScopeLock(&m_Lock);
+	return m_Subscribers.Num();
+}
+
+// 生成订阅的返回
+FDTHttpServerNativeResponse FDTHttpServerEventStream::MakeResponse(uint64 LastEventId) const
+{
+	FDTHttpServerNativeResponse NativeResponse;
+	NativeResponse.ContentType = TEXT("text/event-stream;charset=utf-8");
+	NativeResponse.Headers.Add(TEXT("Cache-Control"), { TEXT("no-cache") });
+
+	// 只能从还在缓存中的事件开始
+	const uint64 Capacity = m_Frames.Num();
+	const uint64 FirstEventId = FMath::Max(LastEventId + 1, m_LastEventId >= Capacity ? m_LastEventId - Capacity + 1 : 1);
+
+	int32 BodySize = m_RetryFrame.Num();
+	for ( uint64 EventId = FirstEventId; EventId <= m_LastEventId; ++EventId )
+	{
+		BodySize += m_Frames[EventId % Capacity]->Num();
+	}
+
+	NativeResponse.Body.Reserve(BodySize);
+	NativeResponse.Body.Append(m_RetryFrame);
+	for ( uint64 EventId = FirstEventId; EventId <= m_LastEventId; ++EventId )
+	{
+		NativeResponse.Body.Append(*m_Frames[EventId % Capacity]);
+	}
+	return NativeResponse;
+}
@@ -0,0 +1,47 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerNative.h"
+
+// Server-Sent Events 数据流
+// 引擎的 HTTP 服务只能返回完整的数据, 所以订阅请求会被挂起, 有新事件时一起返回,
+// 浏览器的 EventSource 收到返回后带着 Last-Event-ID 立即重连, 从重放缓存中继续
+class FDTHttpServerEventStream
+{
+public:
+	FDTHttpServerEventStream(int32 InReplayCapacity, int32 InRetryMilliseconds);
+
+	// 发布事件, 事件只编码一次, 所有订阅共享, 可以在任意线程调用
+	uint64 Publish(const FString & EventName, const FString & Data);
+
+	// 订阅, 有 LastEventId 之后的事件时直接返回, 否则挂起到下一个事件
+	void Subscribe(const FDTHttpServerPromise & Promise, uint64 LastEventId, double HoldSeconds);
+
+	// 返回挂起的订阅, 在游戏线程每帧调用
+	void Flush(double Now);
+
+	// 挂起的订阅数
+	int32 NumSubscribers() const;
+
+private:
+	struct FSubscriber
+	{
+		FDTHttpServerPromise	Promise;
+		uint64					LastEventId = 0;
+		double					Deadline = 0.0;
+	};
+
+	// 生成订阅的返回, 包含 LastEventId 之后所有还在缓存中的事件, 调用前需要加锁
+	FDTHttpServerNativeResponse MakeResponse(uint64 LastEventId) const;
+
+private:
+	mutable FCriticalSection								m_Lock;
+	TArray<TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>>	m_Frames;
+	TArray<FSubscriber>										m_Subscribers;
+	uint64													m_LastEventId = 0;
+	uint64													m_FlushedEventId = 0;
+	TArray<uint8>											m_RetryFrame;
+};
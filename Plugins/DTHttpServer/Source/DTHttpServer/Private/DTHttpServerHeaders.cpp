@@ -0,0 +1,100 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerHeaders.h"
+#include "DTHttpServer.h"
+#include "HAL/IConsoleManager.h"
+
+FDTHttpServerHeaderSet::FDTHttpServerHeaderSet(const FDTHttpServerHeaderPolicy& Policy)
+	: m_bCorsEnabled(Policy.bEnableCors)
+{
+	// 普通返回只需要类型和允许的来源, 其余跨域字段只在预检中有意义
+	m_ResponseHeaders.Add(TEXT("Content-Type"), { Policy.ContentType });
+	if ( !Policy.CacheControl.IsEmpty() )
+	{
+		m_ResponseHeaders.Add(TEXT("Cache-Control"), { Policy.CacheControl });
+	}
+	if ( Policy.bEnableCors )
+	{
+		m_ResponseHeaders.Add(TEXT("Access-Control-Allow-Origin"), { Policy.AllowOrigin });
+		if ( Policy.bAllowCredentials )
+		{
+			m_ResponseHeaders.Add(TEXT("Access-Control-Allow-Credentials"), { TEXT("true") });
+		}
+	}
+	for ( const auto & ExtraHeader : Policy.ExtraHeaders )
+	{
+		m_ResponseHeaders.Add(ExtraHeader.Key, { ExtraHeader.Value });
+	}
+
+	// 预检返回
+	if ( Policy.bEnableCors )
+	{
+		m_PreflightHeaders.Add(TEXT("Access-Control-Allow-Origin"), { Policy.AllowOrigin });
+		m_PreflightHeaders.Add(TEXT("Access-Control-Allow-Methods"), { Policy.AllowMethods });
+		m_PreflightHeaders.Add(TEXT("Access-Control-Allow-Headers"), { Policy.AllowHeaders });
+		m_PreflightHeaders.Add(TEXT("Access-Control-Max-Age"), { FString::FromInt(Policy.MaxAge) });
+		if ( Policy.bAllowCredentials )
+		{
+			m_PreflightHeaders.Add(TEXT("Access-Control-Allow-Credentials"), { TEXT("true") });
+		}
+	}
+}
+
+// 创建普通返回
+TUniquePtr<FHttpServerResponse> FDTHttpServerHeaderSet::CreateResponse() const
+{
+	TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+	Response->Code = EHttpServerResponseCodes::Ok;
+	Response->Headers = m_ResponseHeaders;
+	return Response;
+}
+
+// 创建跨域预检返回
+TUniquePtr<FHttpServerResponse> FDTHttpServerHeaderSet::CreatePreflightResponse() const
+{
+	TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+	Response->Code = EHttpServerResponseCodes::NoContent;
+	Response->Headers = m_PreflightHeaders;
+	return Response;
+}
+
+// 对比逐个生成返回头与预先生成返回头的开销
+static FAutoConsoleCommand GDTHttpServerBenchHeadersCommand(
+	TEXT("DTHttpServer.BenchHeaders"),
+	TEXT("Measures per-request response header construction. Usage: DTHttpServer.BenchHeaders [Iterations]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+
+		// 旧方式: 每个请求生成六个头, 预检也是一个完整返回
+		double StartTime = FPlatformTime::Seconds();
+		for ( int32 Index = 0; Index < Iterations; ++Index )
+		{
+			for ( int32 Pass = 0; Pass < 2; ++Pass )
+			{
+				TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+				Response->Code = EHttpServerResponseCodes::Ok;
+				Response->Headers.Add(TEXT("Content-Type"), { TEXT("application/json;charset=utf-8") });
+				Response->Headers.Add(TEXT("Access-Control-Allow-Origin"), { TEXT("*") });
+				Response->Headers.Add(TEXT("Access-Control-Allow-Methods"), { TEXT("GET,POST,PUT,PATCH,DELETE,OPTIONS") });
+				Response->Headers.Add(TEXT("Access-Control-Allow-Headers"), { TEXT("Origin,X-Requested-With,Content-Type,Accept") });
+				Response->Headers.Add(TEXT("Access-Control-Max-Age"), { TEXT("600") });
+				Response->Headers.Add(TEXT("Access-Control-Allow-Credentials"), { TEXT("true") });
+			}
+		}
+		const double LegacySeconds = FPlatformTime::Seconds() - StartTime;
+
+		// 新方式: 拷贝预先生成的头
+		const FDTHttpServerHeaderSet HeaderSet{ FDTHttpServerHeaderPolicy() };
+		StartTime = FPlatformTime::Seconds();
+		for ( int32 Index = 0; Index < Iterations; ++Index )
+		{
+			TUniquePtr<FHttpServerResponse> Preflight = HeaderSet.CreatePreflightResponse();
+			TUniquePtr<FHttpServerResponse> Response = HeaderSet.CreateResponse();
+		}
+		const double TemplateSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogDTHttpServer, Display, TEXT("{\"iterations\":%d,\"legacy_ns_per_request\":%.1f,\"template_ns_per_request\":%.1f}"),
+			Iterations, LegacySeconds * 1e9 / Iterations, TemplateSeconds * 1e9 / Iterations);
+	}));
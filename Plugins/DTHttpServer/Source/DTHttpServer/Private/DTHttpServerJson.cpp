@@ -0,0 +1,1096 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerJson.h"
+#include "UObject/UnrealType.h"
+#include "UObject/EnumProperty.h"
+#include "UObject/TextProperty.h"
+#include "Misc/ScopeRWLock.h"
+#include "Misc/ScopeExit.h"
+
+namespace DTHttpServer
+{
+	// 每次检查 8 个字节
+	static constexpr uint64 JsonOnes = 0x0101010101010101ull;
+	static constexpr uint64 JsonHighs = 0x8080808080808080ull;
+	// 最大嵌套层数
+	static constexpr int32 JsonMaxDepth = 64;
+
+	// 8 个字节中是否有引号, 反斜杠或控制字符, 可能误报, 不会漏报
+	static FORCEINLINE bool JsonHasSpecialByte(uint64 Word)
+	{
+		const uint64 Quote = Word ^ (JsonOnes * '"');
+		const uint64 Slash = Word ^ (JsonOnes * '\\');
+		return ((((Quote - JsonOnes) & ~Quote) | ((Slash - JsonOnes) & ~Slash) | ((Word - JsonOnes * 0x20) & ~Word)) & JsonHighs) != 0;
+	}
+
+	// 字符串中需要处理的字节
+	static FORCEINLINE bool JsonIsSpecialByte(uint8 Byte)
+	{
+		return Byte == '"' || Byte == '\\' || Byte < 0x20;
+	}
+
+	// 结构体字段
+	struct FJsonField
+	{
+		FProperty *		Property = nullptr;
+		// 用于匹配的 UTF-8 名称
+		TArray<uint8>	Name;
+		// 写出用的 "name":
+		TArray<uint8>	Key;
+	};
+
+	// 结构体的字段表
+	struct FJsonLayout
+	{
+		TArray<FJsonField>	Fields;
+	};
+
+	// 获取字段表, 每个结构体第一次使用时生成
+	static const FJsonLayout & GetJsonLayout(const UScriptStruct * Struct)
+	{
+		static FRWLock Lock;
+		static TMap<const UScriptStruct *, TUniquePtr<FJsonLayout>> Layouts;
+		{
+			FReadScopeLock ReadLock(Lock);
+			if ( const TUniquePtr<FJsonLayout> * Layout = Layouts.Find(Struct) ) { return **Layout; }
+		}
+
+		TUniquePtr<FJsonLayout> NewLayout = MakeUnique<FJsonLayout>();
+		for ( TFieldIterator<FProperty> It(Struct); It; ++It )
+		{
+			// 与 FJsonObjectConverter::StandardizeCase 相同
+			FString Name = It->GetAuthoredName();
+			if ( Name.IsEmpty() ) { continue; }
+			Name[0] = FChar::ToLower(Name[0]);
+			Name.ReplaceInline(TEXT("ID"), TEXT("Id"), ESearchCase::CaseSensitive);
+
+			FJsonField & Field = NewLayout->Fields.AddDefaulted_GetRef();
+			Field.Property = *It;
+			const FTCHARToUTF8 NameConverter(*Name, Name.Len());
+			Field.Name.Append((const uint8 *)NameConverter.Get(), NameConverter.Length());
+			Field.Key.Reserve(Field.Name.Num() + 3);
+			Field.Key.Add('"');
+			Field.Key.Append(Field.Name);
+			Field.Key.Add('"');
+			Field.Key.Add(':');
+		}
+
+		FWriteScopeLock WriteLock(Lock);
+		TUniquePtr<FJsonLayout> & Layout = Layouts.FindOrAdd(Struct);
+		if ( !Layout.IsValid() )
+		{
+			Layout = MoveTemp(NewLayout);
+		}
+		return *Layout;
+	}
+
+	// 字段名比较, ASCII 字母不区分大小写
+	static bool JsonNameEquals(const TArray<uint8> & Name, const uint8 * Key, int32 KeyLength)
+	{
+		if ( Name.Num() != KeyLength ) { return false; }
+		for ( int32 Index = 0; Index < KeyLength; ++Index )
+		{
+			const uint8 A = Name[Index];
+			const uint8 B = Key[Index];
+			if ( A == B ) { continue; }
+			const uint8 LowerA = A | 0x20;
+			if ( LowerA != (B | 0x20) || LowerA < 'a' || LowerA > 'z' ) { return false; }
+		}
+		return true;
+	}
+
+	// 追加 UTF-8 编码的字符
+	static void AppendUtf8CodePoint(TArray<uint8> & Out, uint32 CodePoint)
+	{
+		if ( CodePoint >= 0xD800 && CodePoint <= 0xDFFF ) { CodePoint = 0xFFFD; }
+		if ( CodePoint < 0x80 )
+		{
+			Out.Add((uint8)CodePoint);
+		}
+		else if ( CodePoint < 0x800 )
+		{
+			Out.Add((uint8)(0xC0 | (CodePoint >> 6)));
+			Out.Add((uint8)(0x80 | (CodePoint & 0x3F)));
+		}
+		else if ( CodePoint < 0x10000 )
+		{
+			Out.Add((uint8)(0xE0 | (CodePoint >> 12)));
+			Out.Add((uint8)(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add((uint8)(0x80 | (CodePoint & 0x3F)));
+		}
+		else
+		{
+			Out.Add((uint8)(0xF0 | (CodePoint >> 18)));
+			Out.Add((uint8)(0x80 | ((CodePoint >> 12) & 0x3F)));
+			Out.Add((uint8)(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add((uint8)(0x80 | (CodePoint & 0x3F)));
+		}
+	}
+
+	// 读取 4 位十六进制
+	static bool ReadJsonHex4(const uint8 *& Cursor, const uint8 * End, uint32 & OutValue)
+	{
+		if ( End - Cursor < 4 ) { return false; }
+		OutValue = 0;
+		for ( int32 Index = 0; Index < 4; ++Index )
+		{
+			const uint8 Char = *Cursor++;
+			uint32 Digit;
+			if ( Char >= '0' && Char <= '9' ) { Digit = Char - '0'; }
+			else if ( Char >= 'a' && Char <= 'f' ) { Digit = Char - 'a' + 10; }
+			else if ( Char >= 'A' && Char <= 'F' ) { Digit = Char - 'A' + 10; }
+			else { return false; }
+			OutValue = (OutValue << 4) | Digit;
+		}
+		return true;
+	}
+
+	// 单次扫描的 JSON 读取, 直接写入属性内存
+	class FJsonStructReader
+	{
+	public:
+		explicit FJsonStructReader(TArrayView<const uint8> Json)
+			: m_Begin(Json.GetData())
+			, m_Cursor(Json.GetData())
+			, m_End(Json.GetData() + Json.Num())
+		{
+		}
+
+		// 读取根对象, 后面只允许空白
+		bool ReadRoot(const UScriptStruct * Struct, void * Data)
+		{
+			SkipBom();
+			return ReadObject(Struct, Data, 0) && ReadEnd();
+		}
+
+		// 读取根数组, 每个元素为一个结构体
+		bool ReadRootArray(const UScriptStruct * Struct, TFunctionRef<void *()> AddElement, int32 MaxElements)
+		{
+			SkipBom();
+			if ( !Consume('[') ) { return Fail(TEXT("Expected an array")); }
+			if ( !Consume(']') )
+			{
+				int32 Count = 0;
+				do
+				{
+					// 超过数量时不再分配和解析后面的元素
+					if ( Count++ >= MaxElements )
+					{
+						m_bTooManyElements = true;
+						return Fail(TEXT("Too many array elements"));
+					}
+					if ( !ReadObject(Struct, AddElement(), 1) ) { return false; }
+				}
+				while ( Consume(',') );
+				if ( !Consume(']') ) { return Fail(TEXT("Expected ',' or ']'")); }
+			}
+			return ReadEnd();
+		}
+
+		// 只检查格式
+		bool Validate()
+		{
+			SkipBom();
+			return SkipValue(0) && ReadEnd();
+		}
+
+		// 是否因为元素超过数量而失败
+		bool IsTooManyElements() const { return m_bTooManyElements; }
+
+		// 错误信息
+		FString GetError() const
+		{
+			return FString::Printf(TEXT("%s at byte %d"), m_Error != nullptr ? m_Error : TEXT("Invalid JSON"), m_ErrorOffset);
+		}
+
+	private:
+		// 记录第一个错误
+		bool Fail(const TCHAR * Message)
+		{
+			if ( m_Error == nullptr )
+			{
+				m_Error = Message;
+				m_ErrorOffset = (int32)(m_Cursor - m_Begin);
+			}
+			return false;
+		}
+
+		void SkipBom()
+		{
+			if ( m_End - m_Cursor >= 3 && m_Cursor[0] == 0xEF && m_Cursor[1] == 0xBB && m_Cursor[2] == 0xBF )
+			{
+				m_Cursor += 3;
+			}
+		}
+
+		// 根值后面只允许空白
+		bool ReadEnd()
+		{
+			SkipWhitespace();
+			return m_Cursor == m_End || Fail(TEXT("Unexpected data after the root value"));
+		}
+
+		FORCEINLINE void SkipWhitespace()
+		{
+			while ( m_Cursor < m_End && (*m_Cursor == ' ' || *m_Cursor == '\n' || *m_Cursor == '\r' || *m_Cursor == '\t') )
+			{
+				++m_Cursor;
+			}
+		}
+
+		// 下一个非空白字符, 结束时返回 0
+		FORCEINLINE uint8 Peek()
+		{
+			SkipWhitespace();
+			return m_Cursor < m_End ? *m_Cursor : 0;
+		}
+
+		// 下一个非空白字符匹配时跳过
+		FORCEINLINE bool Consume(uint8 Char)
+		{
+			if ( Peek() != Char ) { return false; }
+			++m_Cursor;
+			return true;
+		}
+
+		bool ReadLiteral(const char * Literal, int32 Length)
+		{
+			if ( m_End - m_Cursor < Length || FMemory::Memcmp(m_Cursor, Literal, Length) != 0 ) { return Fail(TEXT("Invalid literal")); }
+			m_Cursor += Length;
+			return true;
+		}
+
+		// 扫描字符串, 当前位置为开始的引号, 返回引号之间的原始数据
+		bool ScanString(const uint8 *& OutBegin, const uint8 *& OutEnd, bool & bOutEscaped)
+		{
+			++m_Cursor;
+			OutBegin = m_Cursor;
+			bOutEscaped = false;
+			for ( ;; )
+			{
+				// 没有特殊字符时每次前进 8 个字节
+				while ( m_End - m_Cursor >= 8 )
+				{
+					uint64 Word;
+					FMemory::Memcpy(&Word, m_Cursor, sizeof(Word));
+					if ( JsonHasSpecialByte(Word) ) { break; }
+					m_Cursor += 8;
+				}
+				if ( m_Cursor >= m_End ) { return Fail(TEXT("Unterminated string")); }
+
+				const uint8 Byte = *m_Cursor;
+				if ( Byte == '"' )
+				{
+					OutEnd = m_Cursor++;
+					return true;
+				}
+				if ( Byte == '\\' )
+				{
+					bOutEscaped = true;
+					m_Cursor += 2;
+					continue;
+				}
+				if ( Byte < 0x20 ) { return Fail(TEXT("Control character in string")); }
+				++m_Cursor;
+			}
+		}
+
+		// 展开转义字符
+		static bool Unescape(const uint8 * Cursor, const uint8 * End, TArray<uint8> & Out)
+		{
+			Out.Reset(End - Cursor);
+			while ( Cursor < End )
+			{
+				const uint8 Byte = *Cursor++;
+				if ( Byte != '\\' )
+				{
+					Out.Add(Byte);
+					continue;
+				}
+				switch ( *Cursor++ )
+				{
+				case '"':	Out.Add('"');	break;
+				case '\\':	Out.Add('\\');	break;
+				case '/':	Out.Add('/');	break;
+				case 'b':	Out.Add('\b');	break;
+				case 'f':	Out.Add('\f');	break;
+				case 'n':	Out.Add('\n');	break;
+				case 'r':	Out.Add('\r');	break;
+				case 't':	Out.Add('\t');	break;
+				case 'u':
+					{
+						uint32 CodePoint;
+						if ( !ReadJsonHex4(Cursor, End, CodePoint) ) { return false; }
+						// 代理对
+						if ( CodePoint >= 0xD800 && CodePoint <= 0xDBFF && End - Cursor >= 6 && Cursor[0] == '\\' && Cursor[1] == 'u' )
+						{
+							const uint8 * LowCursor = Cursor + 2;
+							uint32 LowSurrogate;
+							if ( ReadJsonHex4(LowCursor, End, LowSurrogate) && LowSurrogate >= 0xDC00 && LowSurrogate <= 0xDFFF )
+							{
+								CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+								Cursor = LowCursor;
+							}
+						}
+						AppendUtf8CodePoint(Out, CodePoint);
+					}
+					break;
+				default:
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// 读取字符串, 没有转义时直接从原始数据转换
+		bool ReadString(FString & Out)
+		{
+			if ( Peek() != '"' ) { return Fail(TEXT("Expected a string")); }
+			const uint8 * Begin;
+			const uint8 * End;
+			bool bEscaped;
+			if ( !ScanString(Begin, End, bEscaped) ) { return false; }
+			if ( bEscaped )
+			{
+				if ( !Unescape(Begin, End, m_Scratch) ) { return Fail(TEXT("Invalid escape in string")); }
+				Begin = m_Scratch.GetData();
+				End = Begin + m_Scratch.Num();
+			}
+			if ( Begin == End )
+			{
+				Out.Reset();
+				return true;
+			}
+			const FUTF8ToTCHAR Converter((const ANSICHAR *)Begin, (int32)(End - Begin));
+			Out = FString(Converter.Length(), Converter.Get());
+			return true;
+		}
+
+		// 读取数值, 18 位以内的整数直接累加, 其它格式交给 Atod
+		bool ReadNumber(double & OutDouble, int64 & OutInteger, bool & bOutInteger)
+		{
+			const uint8 * Start = m_Cursor;
+			const bool bNegative = m_Cursor < m_End && *m_Cursor == '-';
+			if ( bNegative ) { ++m_Cursor; }
+
+			const uint8 * Digits = m_Cursor;
+			uint64 Value = 0;
+			while ( m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9' )
+			{
+				Value = Value * 10 + (*m_Cursor++ - '0');
+			}
+			const int32 NumDigits = (int32)(m_Cursor - Digits);
+			if ( NumDigits == 0 ) { return Fail(TEXT("Invalid value")); }
+
+			bool bFraction = false;
+			if ( m_Cursor < m_End && *m_Cursor == '.' )
+			{
+				bFraction = true;
+				++m_Cursor;
+				while ( m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9' ) { ++m_Cursor; }
+			}
+			if ( m_Cursor < m_End && (*m_Cursor == 'e' || *m_Cursor == 'E') )
+			{
+				bFraction = true;
+				++m_Cursor;
+				if ( m_Cursor < m_End && (*m_Cursor == '+' || *m_Cursor == '-') ) { ++m_Cursor; }
+				while ( m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9' ) { ++m_Cursor; }
+			}
+
+			bOutInteger = !bFraction;
+			if ( !bFraction && NumDigits <= 18 )
+			{
+				OutInteger = bNegative ? -(int64)Value : (int64)Value;
+				OutDouble = (double)OutInteger;
+				return true;
+			}
+
+			ANSICHAR Buffer[64];
+			const int32 Length = (int32)(m_Cursor - Start);
+			if ( Length >= UE_ARRAY_COUNT(Buffer) ) { return Fail(TEXT("Number too long")); }
+			FMemory::Memcpy(Buffer, Start, Length);
+			Buffer[Length] = 0;
+			OutDouble = FCStringAnsi::Atod(Buffer);
+			OutInteger = bNegative ? FCStringAnsi::Atoi64(Buffer) : (int64)FCStringAnsi::Strtoui64(Buffer, nullptr, 10);
+			return true;
+		}
+
+		// 跳过不需要的值
+		bool SkipValue(int32 Depth)
+		{
+			if ( Depth > JsonMaxDepth ) { return Fail(TEXT("Nesting too deep")); }
+			const uint8 * Begin;
+			const uint8 * End;
+			bool bEscaped;
+			switch ( Peek() )
+			{
+			case '"':
+				return ScanString(Begin, End, bEscaped);
+			case '{':
+				++m_Cursor;
+				if ( Consume('}') ) { return true; }
+				do
+				{
+					if ( Peek() != '"' ) { return Fail(TEXT("Expected a field name")); }
+					if ( !ScanString(Begin, End, bEscaped) ) { return false; }
+					if ( !Consume(':') ) { return Fail(TEXT("Expected ':'")); }
+					if ( !SkipValue(Depth + 1) ) { return false; }
+				}
+				while ( Consume(',') );
+				return Consume('}') || Fail(TEXT("Expected ',' or '}'"));
+			case '[':
+				++m_Cursor;
+				if ( Consume(']') ) { return true; }
+				do
+				{
+					if ( !SkipValue(Depth + 1) ) { return false; }
+				}
+				while ( Consume(',') );
+				return Consume(']') || Fail(TEXT("Expected ',' or ']'"));
+			case 't':
+				return ReadLiteral("true", 4);
+			case 'f':
+				return ReadLiteral("false", 5);
+			case 'n':
+				return ReadLiteral("null", 4);
+			default:
+				{
+					double Double;
+					int64 Integer;
+					bool bInteger;
+					return ReadNumber(Double, Integer, bInteger);
+				}
+			}
+		}
+
+		// 查找字段, 字段通常按声明顺序出现, 从上一个字段之后开始查找
+		static const FJsonField * FindField(const FJsonLayout & Layout, const uint8 * Key, int32 KeyLength, int32 & NextField)
+		{
+			const int32 NumFields = Layout.Fields.Num();
+			for ( int32 Offset = 0; Offset < NumFields; ++Offset )
+			{
+				const int32 Index = (NextField + Offset) % NumFields;
+				if ( JsonNameEquals(Layout.Fields[Index].Name, Key, KeyLength) )
+				{
+					NextField = Index + 1;
+					return &Layout.Fields[Index];
+				}
+			}
+			return nullptr;
+		}
+
+		// 读取对象到结构体
+		bool ReadObject(const UScriptStruct * Struct, void * Data, int32 Depth)
+		{
+			if ( Depth > JsonMaxDepth ) { return Fail(TEXT("Nesting too deep")); }
+			if ( !Consume('{') ) { return Fail(TEXT("Expected an object")); }
+			if ( Consume('}') ) { return true; }
+
+			const FJsonLayout & Layout = GetJsonLayout(Struct);
+			int32 NextField = 0;
+			do
+			{
+				if ( Peek() != '"' ) { return Fail(TEXT("Expected a field name")); }
+				const uint8 * KeyBegin;
+				const uint8 * KeyEnd;
+				bool bEscaped;
+				if ( !ScanString(KeyBegin, KeyEnd, bEscaped) ) { return false; }
+				if ( bEscaped )
+				{
+					if ( !Unescape(KeyBegin, KeyEnd, m_KeyScratch) ) { return Fail(TEXT("Invalid escape in string")); }
+					KeyBegin = m_KeyScratch.GetData();
+					KeyEnd = KeyBegin + m_KeyScratch.Num();
+				}
+				if ( !Consume(':') ) { return Fail(TEXT("Expected ':'")); }
+
+				// 未知字段跳过
+				const FJsonField * Field = FindField(Layout, KeyBegin, (int32)(KeyEnd - KeyBegin), NextField);
+				if ( !(Field != nullptr ? ReadField(Field->Property, Data, Depth + 1) : SkipValue(Depth + 1)) ) { return false; }
+			}
+			while ( Consume(',') );
+			return Consume('}') || Fail(TEXT("Expected ',' or '}'"));
+		}
+
+		// 读取字段, 固定长度数组使用 JSON 数组
+		bool ReadField(FProperty * Property, void * Container, int32 Depth)
+		{
+			if ( Property->ArrayDim == 1 )
+			{
+				return ReadValue(Property, Property->ContainerPtrToValuePtr<void>(Container), Depth);
+			}
+
+			if ( Peek() == 'n' ) { return ReadLiteral("null", 4); }
+			if ( !Consume('[') ) { return Fail(TEXT("Expected an array")); }
+			if ( Consume(']') ) { return true; }
+			int32 Index = 0;
+			do
+			{
+				if ( !(Index < Property->ArrayDim ? ReadValue(Property, Property->ContainerPtrToValuePtr<void>(Container, Index), Depth + 1) : SkipValue(Depth + 1)) ) { return false; }
+				++Index;
+			}
+			while ( Consume(',') );
+			return Consume(']') || Fail(TEXT("Expected ',' or ']'"));
+		}
+
+		// 枚举名称或数值
+		bool ReadEnum(const UEnum * Enum, FNumericProperty * UnderlyingProperty, void * Value)
+		{
+			if ( Peek() == '"' )
+			{
+				FString Name;
+				if ( !ReadString(Name) ) { return false; }
+				const int64 EnumValue = Enum->GetValueByNameString(Name);
+				if ( EnumValue == INDEX_NONE ) { return Fail(TEXT("Unknown enum value")); }
+				UnderlyingProperty->SetIntPropertyValue(Value, EnumValue);
+				return true;
+			}
+
+			double Double;
+			int64 Integer;
+			bool bInteger;
+			if ( !ReadNumber(Double, Integer, bInteger) ) { return false; }
+			UnderlyingProperty->SetIntPropertyValue(Value, bInteger ? Integer : (int64)Double);
+			return true;
+		}
+
+		// 读取单个值
+		bool ReadValue(FProperty * Property, void * Value, int32 Depth)
+		{
+			// null 保持默认值
+			const uint8 Next = Peek();
+			if ( Next == 'n' ) { return ReadLiteral("null", 4); }
+
+			if ( FNumericProperty * NumericProperty = CastField<FNumericProperty>(Property) )
+			{
+				if ( const UEnum * Enum = NumericProperty->GetIntPropertyEnum() )
+				{
+					return ReadEnum(Enum, NumericProperty, Value);
+				}
+				if ( Next == '"' )
+				{
+					FString Text;
+					if ( !ReadString(Text) ) { return false; }
+					NumericProperty->SetNumericPropertyValueFromString(Value, *Text);
+					return true;
+				}
+
+				double Double;
+				int64 Integer;
+				bool bInteger;
+				if ( !ReadNumber(Double, Integer, bInteger) ) { return false; }
+				if ( NumericProperty->IsFloatingPoint() )
+				{
+					NumericProperty->SetFloatingPointPropertyValue(Value, Double);
+				}
+				else
+				{
+					NumericProperty->SetIntPropertyValue(Value, bInteger ? Integer : (int64)Double);
+				}
+				return true;
+			}
+			if ( FBoolProperty * BoolProperty = CastField<FBoolProperty>(Property) )
+			{
+				if ( Next == 't' || Next == 'f' )
+				{
+					BoolProperty->SetPropertyValue(Value, Next == 't');
+					return Next == 't' ? ReadLiteral("true", 4) : ReadLiteral("false", 5);
+				}
+				return Fail(TEXT("Expected a boolean"));
+			}
+			if ( FEnumProperty * EnumProperty = CastField<FEnumProperty>(Property) )
+			{
+				return ReadEnum(EnumProperty->GetEnum(), EnumProperty->GetUnderlyingProperty(), Value);
+			}
+			if ( FStrProperty * StrProperty = CastField<FStrProperty>(Property) )
+			{
+				if ( Next == '"' )
+				{
+					return ReadString(*StrProperty->GetPropertyValuePtr(Value));
+				}
+
+				// 其它值保留原始 JSON 文本
+				const uint8 * Begin = m_Cursor;
+				if ( !SkipValue(Depth) ) { return false; }
+				const FUTF8ToTCHAR Converter((const ANSICHAR *)Begin, (int32)(m_Cursor - Begin));
+				*StrProperty->GetPropertyValuePtr(Value) = FString(Converter.Length(), Converter.Get());
+				return true;
+			}
+			if ( FNameProperty * NameProperty = CastField<FNameProperty>(Property) )
+			{
+				FString Text;
+				if ( !ReadString(Text) ) { return false; }
+				NameProperty->SetPropertyValue(Value, FName(*Text));
+				return true;
+			}
+			if ( FTextProperty * TextProperty = CastField<FTextProperty>(Property) )
+			{
+				FString Text;
+				if ( !ReadString(Text) ) { return false; }
+				TextProperty->SetPropertyValue(Value, FText::FromString(MoveTemp(Text)));
+				return true;
+			}
+			if ( FStructProperty * StructProperty = CastField<FStructProperty>(Property) )
+			{
+				// 时间使用 ISO 8601 字符串
+				if ( StructProperty->Struct == TBaseStructure<FDateTime>::Get() && Next == '"' )
+				{
+					FString Text;
+					if ( !ReadString(Text) ) { return false; }
+					FDateTime & DateTime = *static_cast<FDateTime *>(Value);
+					return FDateTime::ParseIso8601(*Text, DateTime) || FDateTime::Parse(Text, DateTime) || Fail(TEXT("Invalid date"));
+				}
+				return ReadObject(StructProperty->Struct, Value, Depth);
+			}
+			if ( FArrayProperty * ArrayProperty = CastField<FArrayProperty>(Property) )
+			{
+				return ReadArray(ArrayProperty, Value, Depth);
+			}
+			if ( FSetProperty * SetProperty = CastField<FSetProperty>(Property) )
+			{
+				return ReadSet(SetProperty, Value, Depth);
+			}
+			if ( FMapProperty * MapProperty = CastField<FMapProperty>(Property) )
+			{
+				return ReadMap(MapProperty, Value, Depth);
+			}
+
+			// 其它类型使用属性的文本格式
+			if ( Next == '"' )
+			{
+				FString Text;
+				if ( !ReadString(Text) ) { return false; }
+				return Property->ImportText_Direct(*Text, Value, nullptr, PPF_None) != nullptr || Fail(TEXT("Invalid value"));
+			}
+			return SkipValue(Depth);
+		}
+
+		bool ReadArray(FArrayProperty * ArrayProperty, void * Value, int32 Depth)
+		{
+			if ( Depth > JsonMaxDepth ) { return Fail(TEXT("Nesting too deep")); }
+			if ( !Consume('[') ) { return Fail(TEXT("Expected an array")); }
+
+			FScriptArrayHelper Helper(ArrayProperty, Value);
+			Helper.EmptyValues();
+			if ( Consume(']') ) { return true; }
+			do
+			{
+				const int32 Index = Helper.AddValue();
+				if ( !ReadValue(ArrayProperty->Inner, Helper.GetRawPtr(Index), Depth + 1) ) { return false; }
+			}
+			while ( Consume(',') );
+			return Consume(']') || Fail(TEXT("Expected ',' or ']'"));
+		}
+
+		bool ReadSet(FSetProperty * SetProperty, void * Value, int32 Depth)
+		{
+			if ( Depth > JsonMaxDepth ) { return Fail(TEXT("Nesting too deep")); }
+			if ( !Consume('[') ) { return Fail(TEXT("Expected an array")); }
+
+			FScriptSetHelper Helper(SetProperty, Value);
+			Helper.EmptyElements();
+			if ( Consume(']') ) { return true; }
+			ON_SCOPE_EXIT { Helper.Rehash(); };
+			do
+			{
+				const int32 Index = Helper.AddDefaultValue_Invalid_NeedsRehash();
+				if ( !ReadValue(SetProperty->ElementProp, Helper.GetElementPtr(Index), Depth + 1) ) { return false; }
+			}
+			while ( Consume(',') );
+			return Consume(']') || Fail(TEXT("Expected ',' or ']'"));
+		}
+
+		// 映射使用 JSON 对象, 键从字符串转换
+		bool ReadMap(FMapProperty * MapProperty, void * Value, int32 Depth)
+		{
+			if ( Depth > JsonMaxDepth ) { return Fail(TEXT("Nesting too deep")); }
+			if ( !Consume('{') ) { return Fail(TEXT("Expected an object")); }
+
+			FScriptMapHelper Helper(MapProperty, Value);
+			Helper.EmptyValues();
+			if ( Consume('}') ) { return true; }
+			ON_SCOPE_EXIT { Helper.Rehash(); };
+			do
+			{
+				FString Key;
+				if ( !ReadString(Key) ) { return false; }
+				if ( !Consume(':') ) { return Fail(TEXT("Expected ':'")); }
+
+				const int32 Index = Helper.AddDefaultValue_Invalid_NeedsRehash();
+				void * KeyValue = Helper.GetKeyPtr(Index);
+				if ( FStrProperty * StrKeyProperty = CastField<FStrProperty>(MapProperty->KeyProp) )
+				{
+					StrKeyProperty->SetPropertyValue(KeyValue, MoveTemp(Key));
+				}
+				else if ( FNameProperty * NameKeyProperty = CastField<FNameProperty>(MapProperty->KeyProp) )
+				{
+					NameKeyProperty->SetPropertyValue(KeyValue, FName(*Key));
+				}
+				else if ( MapProperty->KeyProp->ImportText_Direct(*Key, KeyValue, nullptr, PPF_None) == nullptr )
+				{
+					return Fail(TEXT("Invalid map key"));
+				}
+				if ( !ReadValue(MapProperty->ValueProp, Helper.GetValuePtr(Index), Depth + 1) ) { return false; }
+			}
+			while ( Consume(',') );
+			return Consume('}') || Fail(TEXT("Expected ',' or '}'"));
+		}
+
+	private:
+		const uint8 *	m_Begin;
+		const uint8 *	m_Cursor;
+		const uint8 *	m_End;
+		const TCHAR *	m_Error = nullptr;
+		int32			m_ErrorOffset = 0;
+		bool			m_bTooManyElements = false;
+		TArray<uint8>	m_Scratch;
+		TArray<uint8>	m_KeyScratch;
+	};
+
+	// JSON 写出, 直接追加 UTF-8 数据
+	class FJsonStructWriter
+	{
+	public:
+		explicit FJsonStructWriter(TArray<uint8> & Out)
+			: m_Out(Out)
+		{
+		}
+
+		void WriteObject(const UScriptStruct * Struct, const void * Data)
+		{
+			const FJsonLayout & Layout = GetJsonLayout(Struct);
+			m_Out.Add('{');
+			for ( int32 Index = 0; Index < Layout.Fields.Num(); ++Index )
+			{
+				const FJsonField & Field = Layout.Fields[Index];
+				if ( Index > 0 ) { m_Out.Add(','); }
+				m_Out.Append(Field.Key);
+				WriteField(Field.Property, Data);
+			}
+			m_Out.Add('}');
+		}
+
+		// 写出带引号的字符串, 不需要转义的部分整块复制
+		void WriteString(FStringView Value)
+		{
+			if ( Value.IsEmpty() )
+			{
+				Append("\"\"", 2);
+				return;
+			}
+
+			const FTCHARToUTF8 Converter(Value.GetData(), Value.Len());
+			const uint8 * Cursor = (const uint8 *)Converter.Get();
+			const uint8 * End = Cursor + Converter.Length();
+			m_Out.Reserve(m_Out.Num() + Converter.Length() + 2);
+			m_Out.Add('"');
+			while ( Cursor < End )
+			{
+				const uint8 * Run = Cursor;
+				while ( End - Cursor >= 8 )
+				{
+					uint64 Word;
+					FMemory::Memcpy(&Word, Cursor, sizeof(Word));
+					if ( JsonHasSpecialByte(Word) ) { break; }
+					Cursor += 8;
+				}
+				while ( Cursor < End && !JsonIsSpecialByte(*Cursor) ) { ++Cursor; }
+				m_Out.Append(Run, (int32)(Cursor - Run));
+				if ( Cursor < End )
+				{
+					WriteEscaped(*Cursor++);
+				}
+			}
+			m_Out.Add('"');
+		}
+
+	private:
+		void Append(const char * Text, int32 Length)
+		{
+			m_Out.Append((const uint8 *)Text, Length);
+		}
+
+		void WriteEscaped(uint8 Byte)
+		{
+			switch ( Byte )
+			{
+			case '"':	Append("\\\"", 2);	break;
+			case '\\':	Append("\\\\", 2);	break;
+			case '\b':	Append("\\b", 2);	break;
+			case '\f':	Append("\\f", 2);	break;
+			case '\n':	Append("\\n", 2);	break;
+			case '\r':	Append("\\r", 2);	break;
+			case '\t':	Append("\\t", 2);	break;
+			default:
+				{
+					static const char HexDigits[] = "0123456789abcdef";
+					const char Escaped[6] = { '\\', 'u', '0', '0', HexDigits[Byte >> 4], HexDigits[Byte & 0xF] };
+					Append(Escaped, 6);
+				}
+				break;
+			}
+		}
+
+		void WriteUnsigned(uint64 Value)
+		{
+			uint8 Buffer[20];
+			int32 Length = 0;
+			do
+			{
+				Buffer[UE_ARRAY_COUNT(Buffer) - ++Length] = (uint8)('0' + Value % 10);
+				Value /= 10;
+			}
+			while ( Value != 0 );
+			m_Out.Append(Buffer + UE_ARRAY_COUNT(Buffer) - Length, Length);
+		}
+
+		void WriteInteger(int64 Value)
+		{
+			if ( Value < 0 )
+			{
+				m_Out.Add('-');
+				WriteUnsigned(0 - (uint64)Value);
+				return;
+			}
+			WriteUnsigned((uint64)Value);
+		}
+
+		// 使用能还原原值的最短精度
+		void WriteDouble(double Value, bool bSingle)
+		{
+			if ( !FMath::IsFinite(Value) )
+			{
+				Append("null", 4);
+				return;
+			}
+			if ( Value == FMath::FloorToDouble(Value) && FMath::Abs(Value) < 1e15 )
+			{
+				WriteInteger((int64)Value);
+				return;
+			}
+
+			TCHAR Buffer[40];
+			const int32 MaxPrecision = bSingle ? 9 : 17;
+			for ( int32 Precision = bSingle ? 6 : 15; ; ++Precision )
+			{
+				FCString::Snprintf(Buffer, UE_ARRAY_COUNT(Buffer), TEXT("%.*g"), Precision, Value);
+				const double Parsed = FCString::Atod(Buffer);
+				if ( Precision >= MaxPrecision || (bSingle ? (float)Parsed == (float)Value : Parsed == Value) ) { break; }
+			}
+			for ( const TCHAR * Char = Buffer; *Char != 0; ++Char )
+			{
+				m_Out.Add((uint8)*Char);
+			}
+		}
+
+		void WriteEnum(const UEnum * Enum, int64 Value)
+		{
+			const FString Name = Enum->GetNameStringByValue(Value);
+			if ( Name.IsEmpty() )
+			{
+				WriteInteger(Value);
+				return;
+			}
+			WriteString(Name);
+		}
+
+		// 固定长度数组写成 JSON 数组
+		void WriteField(FProperty * Property, const void * Container)
+		{
+			if ( Property->ArrayDim == 1 )
+			{
+				WriteValue(Property, Property->ContainerPtrToValuePtr<void>(Container));
+				return;
+			}
+			m_Out.Add('[');
+			for ( int32 Index = 0; Index < Property->ArrayDim; ++Index )
+			{
+				if ( Index > 0 ) { m_Out.Add(','); }
+				WriteValue(Property, Property->ContainerPtrToValuePtr<void>(Container, Index));
+			}
+			m_Out.Add(']');
+		}
+
+		// 映射的键写成字符串
+		void WriteKey(FProperty * KeyProperty, const void * Key)
+		{
+			if ( FStrProperty * StrProperty = CastField<FStrProperty>(KeyProperty) )
+			{
+				WriteString(*StrProperty->GetPropertyValuePtr(Key));
+				return;
+			}
+			FString Text;
+			KeyProperty->ExportTextItem_Direct(Text, Key, nullptr, nullptr, PPF_None);
+			WriteString(Text);
+		}
+
+		void WriteValue(FProperty * Property, const void * Value)
+		{
+			if ( FNumericProperty * NumericProperty = CastField<FNumericProperty>(Property) )
+			{
+				if ( const UEnum * Enum = NumericProperty->GetIntPropertyEnum() )
+				{
+					WriteEnum(Enum, NumericProperty->GetSignedIntPropertyValue(Value));
+				}
+				else if ( NumericProperty->IsFloatingPoint() )
+				{
+					WriteDouble(NumericProperty->GetFloatingPointPropertyValue(Value), Property->IsA<FFloatProperty>());
+				}
+				else if ( Property->IsA<FUInt64Property>() )
+				{
+					WriteUnsigned(NumericProperty->GetUnsignedIntPropertyValue(Value));
+				}
+				else
+				{
+					WriteInteger(NumericProperty->GetSignedIntPropertyValue(Value));
+				}
+			}
+			else if ( FBoolProperty * BoolProperty = CastField<FBoolProperty>(Property) )
+			{
+				BoolProperty->GetPropertyValue(Value) ? Append("true", 4) : Append("false", 5);
+			}
+			else if ( FEnumProperty * EnumProperty = CastField<FEnumProperty>(Property) )
+			{
+				WriteEnum(EnumProperty->GetEnum(), EnumProperty->GetUnderlyingProperty()->GetSignedIntPropertyValue(Value));
+			}
+			else if ( FStrProperty * StrProperty = CastField<FStrProperty>(Property) )
+			{
+				WriteString(*StrProperty->GetPropertyValuePtr(Value));
+			}
+			else if ( FNameProperty * NameProperty = CastField<FNameProperty>(Property) )
+			{
+				TStringBuilder<128> NameBuilder;
+				NameProperty->GetPropertyValue(Value).AppendString(NameBuilder);
+				WriteString(NameBuilder.ToView());
+			}
+			else if ( FTextProperty * TextProperty = CastField<FTextProperty>(Property) )
+			{
+				WriteString(TextProperty->GetPropertyValue(Value).ToString());
+			}
+			else if ( FStructProperty * StructProperty = CastField<FStructProperty>(Property) )
+			{
+				if ( StructProperty->Struct == TBaseStructure<FDateTime>::Get() )
+				{
+					WriteString(static_cast<const FDateTime *>(Value)->ToIso8601());
+				}
+				else
+				{
+					WriteObject(StructProperty->Struct, Value);
+				}
+			}
+			else if ( FArrayProperty * ArrayProperty = CastField<FArrayProperty>(Property) )
+			{
+				FScriptArrayHelper Helper(ArrayProperty, Value);
+				m_Out.Add('[');
+				for ( int32 Index = 0; Index < Helper.Num(); ++Index )
+				{
+					if ( Index > 0 ) { m_Out.Add(','); }
+					WriteValue(ArrayProperty->Inner, Helper.GetRawPtr(Index));
+				}
+				m_Out.Add(']');
+			}
+			else if ( FSetProperty * SetProperty = CastField<FSetProperty>(Property) )
+			{
+				FScriptSetHelper Helper(SetProperty, Value);
+				m_Out.Add('[');
+				bool bFirst = true;
+				for ( int32 Index = 0, Remaining = Helper.Num(); Remaining > 0; ++Index )
+				{
+					if ( !Helper.IsValidIndex(Index) ) { continue; }
+					--Remaining;
+					if ( !bFirst ) { m_Out.Add(','); }
+					bFirst = false;
+					WriteValue(SetProperty->ElementProp, Helper.GetElementPtr(Index));
+				}
+				m_Out.Add(']');
+			}
+			else if ( FMapProperty * MapProperty = CastField<FMapProperty>(Property) )
+			{
+				FScriptMapHelper Helper(MapProperty, Value);
+				m_Out.Add('{');
+				bool bFirst = true;
+				for ( int32 Index = 0, Remaining = Helper.Num(); Remaining > 0; ++Index )
+				{
+					if ( !Helper.IsValidIndex(Index) ) { continue; }
+					--Remaining;
+					if ( !bFirst ) { m_Out.Add(','); }
+					bFirst = false;
+					WriteKey(MapProperty->KeyProp, Helper.GetKeyPtr(Index));
+					m_Out.Add(':');
+					WriteValue(MapProperty->ValueProp, Helper.GetValuePtr(Index));
+				}
+				m_Out.Add('}');
+			}
+			else
+			{
+				// 其它类型使用属性的文本格式
+				FString Text;
+				Property->ExportTextItem_Direct(Text, Value, nullptr, nullptr, PPF_None);
+				WriteString(Text);
+			}
+		}
+
+	private:
+		TArray<uint8> &	m_Out;
+	};
+}
+
+// 解析 JSON 到结构体
+bool FDTHttpServerJson::ReadStruct(TArrayView<const uint8> Json, const UScriptStruct* Struct, void* Data, FString* OutError)
+{
+	check(Struct != nullptr && Data != nullptr);
+
+	DTHttpServer::FJsonStructReader Reader(Json);
+	if ( Reader.ReadRoot(Struct, Data) ) { return true; }
+	if ( OutError != nullptr )
+	{
+		*OutError = Reader.GetError();
+	}
+	return false;
+}
+
+// 解析 JSON 数组
+bool FDTHttpServerJson::ReadStructArray(TArrayView<const uint8> Json, const UScriptStruct* Struct, TFunctionRef<void*()> AddElement, FString* OutError)
+{
+	bool bTooManyElements = false;
+	return ReadStructArray(Json, Struct, AddElement, MAX_int32, bTooManyElements, OutError);
+}
+
+// 解析有数量限制的 JSON 数组
+bool FDTHttpServerJson::ReadStructArray(TArrayView<const uint8> Json, const UScriptStruct* Struct, TFunctionRef<void*()> AddElement, int32 MaxElements, bool& bOutTooManyElements, FString* OutError)
+{
+	check(Struct != nullptr);
+
+	DTHttpServer::FJsonStructReader Reader(Json);
+	const bool bRead = Reader.ReadRootArray(Struct, AddElement, FMath::Max(MaxElements, 0));
+	bOutTooManyElements = Reader.IsTooManyElements();
+	if ( bRead ) { return true; }
+	if ( OutError != nullptr )
+	{
+		*OutError = Reader.GetError();
+	}
+	return false;
+}
+
+// 检查 JSON 格式
+bool FDTHttpServerJson::IsValid(TArrayView<const uint8> Json)
+{
+	DTHttpServer::FJsonStructReader Reader(Json);
+	return Reader.Validate();
+}
+
+// 结构体写成 JSON
+void FDTHttpServerJson::WriteStruct(const UScriptStruct* Struct, const void* Data, TArray<uint8>& Out)
+{
+	check(Struct != nullptr && Data != nullptr);
+
+	DTHttpServer::FJsonStructWriter Writer(Out);
+	Writer.WriteObject(Struct, Data);
+}
+
+// 写出字符串
+void FDTHttpServerJson::WriteString(FStringView Value, TArray<uint8>& Out)
+{
+	DTHttpServer::FJsonStructWriter Writer(Out);
+	Writer.WriteString(Value);
+}
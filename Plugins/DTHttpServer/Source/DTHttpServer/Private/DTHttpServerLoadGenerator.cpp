@@ -0,0 +1,302 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerLoadGenerator.h"
+#include "DTHttpServer.h"
+#include "HAL/RunnableThread.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+namespace DTHttpServer
+{
+	// 在接收缓存中查找返回头结束位置, 返回数据开始的位置, 没有找到返回 INDEX_NONE
+	static int32 FindLoadHeaderEnd(const TArray<uint8> & Buffer)
+	{
+		for ( int32 Index = 3; Index < Buffer.Num(); ++Index )
+		{
+			if ( Buffer[Index] == '\n' && Buffer[Index - 1] == '\r' && Buffer[Index - 2] == '\n' && Buffer[Index - 3] == '\r' )
+			{
+				return Index + 1;
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	// 查找返回头的值, 名称不区分大小写
+	static bool FindLoadHeader(const FString & Header, const TCHAR * Name, FString & OutValue)
+	{
+		TArray<FString> Lines;
+		Header.ParseIntoArrayLines(Lines);
+		for ( const FString & Line : Lines )
+		{
+			FString Key;
+			if ( Line.Split(TEXT(":"), &Key, &OutValue) && Key.TrimStartAndEnd().Equals(Name, ESearchCase::IgnoreCase) )
+			{
+				OutValue.TrimStartAndEndInline();
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+FDTHttpServerLoadGenerator::FDTHttpServerLoadGenerator(const FSettings& InSettings)
+	: m_Settings(InSettings)
+{
+	for ( const FTarget & Target : m_Settings.Targets )
+	{
+		m_Requests.Add(MakeRequest(Target));
+	}
+}
+
+FDTHttpServerLoadGenerator::~FDTHttpServerLoadGenerator()
+{
+	Stop();
+}
+
+// 生成请求数据, 数据内容固定, 压测时直接发送
+TArray<uint8> FDTHttpServerLoadGenerator::MakeRequest(const FTarget& Target) const
+{
+	FString Header = FString::Printf(TEXT("%s %s HTTP/1.1\r\nHost: %s:%d\r\nConnection: %s\r\n"),
+		*Target.Verb, *Target.Path, *m_Settings.Host, m_Settings.Port, m_Settings.bKeepAlive ? TEXT("keep-alive") : TEXT("close"));
+	const int32 BodyBytes = Target.Body.Num() > 0 ? Target.Body.Num() : FMath::Max(Target.BodyBytes, 0);
+	if ( BodyBytes > 0 || Target.Verb != TEXT("GET") )
+	{
+		Header.Appendf(TEXT("Content-Type: %s\r\nContent-Length: %d\r\n"), *Target.ContentType, BodyBytes);
+	}
+	Header += TEXT("\r\n");
+
+	const FTCHARToUTF8 HeaderConverter(*Header);
+	TArray<uint8> Request;
+	Request.Reserve(HeaderConverter.Length() + BodyBytes);
+	Request.Append((const uint8*)HeaderConverter.Get(), HeaderConverter.Length());
+	if ( Target.Body.Num() > 0 )
+	{
+		Request.Append(Target.Body);
+		return Request;
+	}
+	for ( int32 Index = 0; Index < BodyBytes; ++Index )
+	{
+		Request.Add('a' + Index % 26);
+	}
+	return Request;
+}
+
+// 启动所有连接线程
+bool FDTHttpServerLoadGenerator::Start()
+{
+	if ( m_Requests.Num() == 0 ) { return false; }
+
+	m_SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	if ( m_SocketSubsystem == nullptr ) { return false; }
+
+	bool bIsValid = false;
+	m_Address = m_SocketSubsystem->CreateInternetAddr();
+	m_Address->SetIp(*m_Settings.Host, bIsValid);
+	m_Address->SetPort(m_Settings.Port);
+	if ( !bIsValid )
+	{
+		UE_LOG(LogDTHttpServer, Error, TEXT("Load generator, invalid host : %s"), *m_Settings.Host);
+		return false;
+	}
+
+	m_bStopping.store(false);
+	for ( int32 Index = 0; Index < FMath::Max(m_Settings.Concurrency, 1); ++Index )
+	{
+		TUniquePtr<FConnection> & Connection = m_Connections.Add_GetRef(MakeUnique<FConnection>(*this, Index));
+		Connection->Thread = FRunnableThread::Create(Connection.Get(), *FString::Printf(TEXT("DTHttpServerLoad%d"), Index), 64 * 1024, TPri_Normal);
+	}
+	return true;
+}
+
+// 停止并等待所有线程结束
+void FDTHttpServerLoadGenerator::Stop()
+{
+	m_bStopping.store(true);
+	for ( const TUniquePtr<FConnection> & Connection : m_Connections )
+	{
+		if ( Connection->Thread != nullptr )
+		{
+			Connection->Thread->WaitForCompletion();
+			delete Connection->Thread;
+			Connection->Thread = nullptr;
+		}
+	}
+}
+
+// 合并所有连接的结果
+FDTHttpServerLoadGenerator::FResult FDTHttpServerLoadGenerator::GetResult() const
+{
+	FResult Result;
+	for ( const TUniquePtr<FConnection> & Connection : m_Connections )
+	{
+		const FResult & Other = Connection->Result;
+		Result.Requests += Other.Requests;
+		Result.Errors += Other.Errors;
+		Result.Non2xx += Other.Non2xx;
+		Result.Connects += Other.Connects;
+		Result.ResponseBytes += Other.ResponseBytes;
+		Result.MaxMicroseconds = FMath::Max(Result.MaxMicroseconds, Other.MaxMicroseconds);
+		Result.MaxFirstByteMicroseconds = FMath::Max(Result.MaxFirstByteMicroseconds, Other.MaxFirstByteMicroseconds);
+		Result.Latency.Merge(Other.Latency);
+		Result.FirstByte.Merge(Other.FirstByte);
+	}
+	return Result;
+}
+
+FDTHttpServerLoadGenerator::FConnection::FConnection(FDTHttpServerLoadGenerator& InOwner, int32 InIndex)
+	: Owner(InOwner)
+	, Index(InIndex)
+{
+}
+
+// 循环发送请求, 每个连接从不同的请求开始轮流发送
+uint32 FDTHttpServerLoadGenerator::FConnection::Run()
+{
+	int32 NextRequest = Index;
+	while ( !Owner.m_bStopping.load(std::memory_order_relaxed) )
+	{
+		const TArray<uint8> & Request = Owner.m_Requests[NextRequest++ % Owner.m_Requests.Num()];
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		int32 Code = 0;
+		int32 Bytes = 0;
+		uint64 FirstByteCycles = 0;
+		const bool bSucceeded = RunRequest(Request, Code, Bytes, FirstByteCycles);
+		const uint64 Microseconds = (uint64)(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) * 1000000.0);
+		const uint64 FirstByteMicroseconds = (uint64)(FPlatformTime::ToSeconds64(FirstByteCycles - StartCycles) * 1000000.0);
+
+		// 预热阶段不记录
+		if ( !Owner.m_bRecording.load(std::memory_order_relaxed) ) { continue; }
+		if ( !bSucceeded )
+		{
+			++Result.Errors;
+			// 服务器不可用时不要空转
+			FPlatformProcess::SleepNoStats(0.001f);
+			continue;
+		}
+		++Result.Requests;
+		Result.ResponseBytes += Bytes;
+		Result.Non2xx += ( Code < 200 || Code >= 300 ) ? 1 : 0;
+		Result.MaxMicroseconds = FMath::Max(Result.MaxMicroseconds, Microseconds);
+		Result.Latency.Record(Microseconds);
+		Result.MaxFirstByteMicroseconds = FMath::Max(Result.MaxFirstByteMicroseconds, FirstByteMicroseconds);
+		Result.FirstByte.Record(FirstByteMicroseconds);
+	}
+	Close();
+	return 0;
+}
+
+// 发送一个请求并读完返回
+bool FDTHttpServerLoadGenerator::FConnection::RunRequest(const TArray<uint8>& Request, int32& OutCode, int32& OutBytes, uint64& OutFirstByteCycles)
+{
+	if ( Socket == nullptr && !Connect() ) { return false; }
+
+	int32 Offset = 0;
+	while ( Offset < Request.Num() )
+	{
+		int32 Sent = 0;
+		if ( !Socket->Send(Request.GetData() + Offset, Request.Num() - Offset, Sent) || Sent <= 0 )
+		{
+			Close();
+			return false;
+		}
+		Offset += Sent;
+	}
+
+	if ( !ReadResponse(OutCode, OutBytes, OutFirstByteCycles) )
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+// 读取一个完整返回, 返回数据长度由 Content-Length 决定
+bool FDTHttpServerLoadGenerator::FConnection::ReadResponse(int32& OutCode, int32& OutBytes, uint64& OutFirstByteCycles)
+{
+	Buffer.Reset();
+	int32 HeaderEnd = INDEX_NONE;
+	int64 ContentLength = 0;
+	bool bClose = !Owner.m_Settings.bKeepAlive;
+	uint8 Chunk[16 * 1024];
+	while ( HeaderEnd == INDEX_NONE || Buffer.Num() < HeaderEnd + ContentLength )
+	{
+		// 等待数据时检查是否停止, 避免服务器不返回时线程无法退出
+		if ( !Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(100)) )
+		{
+			if ( Owner.m_bStopping.load(std::memory_order_relaxed) ) { return false; }
+			continue;
+		}
+
+		int32 Read = 0;
+		if ( !Socket->Recv(Chunk, sizeof(Chunk), Read) || Read <= 0 ) { return false; }
+		if ( Buffer.Num() == 0 )
+		{
+			OutFirstByteCycles = FPlatformTime::Cycles64();
+		}
+		Buffer.Append(Chunk, Read);
+
+		// 解析返回头
+		if ( HeaderEnd == INDEX_NONE )
+		{
+			HeaderEnd = DTHttpServer::FindLoadHeaderEnd(Buffer);
+			if ( HeaderEnd == INDEX_NONE ) { continue; }
+
+			const FUTF8ToTCHAR HeaderConverter((const ANSICHAR*)Buffer.GetData(), HeaderEnd);
+			const FString Header(HeaderConverter.Length(), HeaderConverter.Get());
+			FString StatusLine, Rest;
+			Header.Split(TEXT("\r\n"), &StatusLine, &Rest);
+			FString Version, Code;
+			StatusLine.Split(TEXT(" "), &Version, &Code);
+			OutCode = FCString::Atoi(*Code);
+
+			FString Value;
+			if ( DTHttpServer::FindLoadHeader(Rest, TEXT("Content-Length"), Value) )
+			{
+				ContentLength = FCString::Atoi64(*Value);
+			}
+			if ( DTHttpServer::FindLoadHeader(Rest, TEXT("Connection"), Value) && Value.Equals(TEXT("close"), ESearchCase::IgnoreCase) )
+			{
+				bClose = true;
+			}
+		}
+	}
+
+	OutBytes = (int32)ContentLength;
+	if ( bClose )
+	{
+		Close();
+	}
+	return true;
+}
+
+// 连接服务器
+bool FDTHttpServerLoadGenerator::FConnection::Connect()
+{
+	Socket = Owner.m_SocketSubsystem->CreateSocket(NAME_Stream, TEXT("DTHttpServerLoad"), Owner.m_Address->GetProtocolType());
+	if ( Socket == nullptr ) { return false; }
+
+	Socket->SetNoDelay(true);
+	if ( !Socket->Connect(*Owner.m_Address) )
+	{
+		Close();
+		return false;
+	}
+	if ( Owner.m_bRecording.load(std::memory_order_relaxed) )
+	{
+		++Result.Connects;
+	}
+	return true;
+}
+
+// 关闭连接
+void FDTHttpServerLoadGenerator::FConnection::Close()
+{
+	if ( Socket != nullptr )
+	{
+		Socket->Close();
+		Owner.m_SocketSubsystem->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
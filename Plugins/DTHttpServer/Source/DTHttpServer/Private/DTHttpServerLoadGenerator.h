@@ -0,0 +1,109 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerMetrics.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+
+class FInternetAddr;
+class FRunnableThread;
+class FSocket;
+class ISocketSubsystem;
+
+// 压测负载生成器, 每个连接一个线程, 阻塞发送请求并等待返回后再发下一个
+class FDTHttpServerLoadGenerator
+{
+public:
+	// 压测请求
+	struct FTarget
+	{
+		FString			Verb = TEXT("GET");
+		FString			Path;
+		int32			BodyBytes = 0;
+		FString			ContentType = TEXT("application/octet-stream");
+		// 请求数据, 为空时按 BodyBytes 生成
+		TArray<uint8>	Body;
+	};
+
+	// 压测设置
+	struct FSettings
+	{
+		FString				Host = TEXT("127.0.0.1");
+		int32				Port = 8001;
+		int32				Concurrency = 16;
+		bool				bKeepAlive = true;
+		TArray<FTarget>		Targets;
+	};
+
+	// 统计结果, 只包含记录期间完成的请求
+	struct FResult
+	{
+		uint64					Requests = 0;
+		uint64					Errors = 0;
+		uint64					Non2xx = 0;
+		uint64					Connects = 0;
+		uint64					ResponseBytes = 0;
+		uint64					MaxMicroseconds = 0;
+		uint64					MaxFirstByteMicroseconds = 0;
+		FDTHttpServerHistogram	Latency;
+		// 从开始发送请求到收到第一个返回字节的时间
+		FDTHttpServerHistogram	FirstByte;
+	};
+
+	explicit FDTHttpServerLoadGenerator(const FSettings & InSettings);
+	~FDTHttpServerLoadGenerator();
+
+	// 启动所有连接线程
+	bool Start();
+
+	// 开始或停止记录, 用于跳过预热阶段
+	void SetRecording(bool bRecording) { m_bRecording.store(bRecording, std::memory_order_relaxed); }
+
+	// 停止并等待所有线程结束
+	void Stop();
+
+	// 合并所有连接的结果, 在 Stop 之后调用
+	FResult GetResult() const;
+
+private:
+	// 单个连接
+	class FConnection : public FRunnable
+	{
+	public:
+		FConnection(FDTHttpServerLoadGenerator & InOwner, int32 InIndex);
+
+		virtual uint32 Run() override;
+
+		// 发送一个请求并读完返回, 失败时关闭连接
+		bool RunRequest(const TArray<uint8> & Request, int32 & OutCode, int32 & OutBytes, uint64 & OutFirstByteCycles);
+
+		// 读取一个完整返回, 记录收到第一个字节的时间
+		bool ReadResponse(int32 & OutCode, int32 & OutBytes, uint64 & OutFirstByteCycles);
+
+		// 连接服务器
+		bool Connect();
+		void Close();
+
+		FDTHttpServerLoadGenerator &	Owner;
+		int32							Index;
+		FSocket *						Socket = nullptr;
+		TArray<uint8>					Buffer;
+		FResult							Result;
+		FRunnableThread *				Thread = nullptr;
+	};
+
+	// 生成请求数据
+	TArray<uint8> MakeRequest(const FTarget & Target) const;
+
+private:
+	FSettings							m_Settings;
+	ISocketSubsystem *					m_SocketSubsystem = nullptr;
+	TSharedPtr<FInternetAddr>			m_Address;
+	TArray<TArray<uint8>>				m_Requests;
+	TArray<TUniquePtr<FConnection>>		m_Connections;
+	std::atomic<bool>					m_bStopping { false };
+	std::atomic<bool>					m_bRecording { false };
+};
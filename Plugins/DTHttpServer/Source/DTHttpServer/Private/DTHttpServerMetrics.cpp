@@ -0,0 +1,260 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerMetrics.h"
+
+DEFINE_STAT(STAT_DTHttpServer_Handler);
+DEFINE_STAT(STAT_DTHttpServer_Requests);
+DEFINE_STAT(STAT_DTHttpServer_RequestBytes);
+DEFINE_STAT(STAT_DTHttpServer_ResponseBytes);
+DEFINE_STAT(STAT_DTHttpServer_RateLimited);
+DEFINE_STAT(STAT_DTHttpServer_QueueDepth);
+
+namespace DTHttpServer
+{
+	// 时钟周期转微秒
+	static uint64 CyclesToMicroseconds(uint64 Cycles)
+	{
+		return (uint64)(FPlatformTime::ToSeconds64(Cycles) * 1000000.0);
+	}
+
+	// Prometheus 标签值
+	static FString EscapeMetricLabel(const FString & Value)
+	{
+		return Value.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\""));
+	}
+
+	// 输出一个 summary
+	static void AppendSummary(FString & Text, const TCHAR * Name, const FString & Labels, const FDTHttpServerHistogram & Histogram)
+	{
+		static const double Quantiles[] = { 0.5, 0.99, 0.999 };
+		for ( const double Quantile : Quantiles )
+		{
+			Text.Appendf(TEXT("%s{%s,quantile=\"%g\"} %.6f\n"), Name, *Labels, Quantile, Histogram.GetPercentile(Quantile));
+		}
+		Text.Appendf(TEXT("%s_sum{%s} %.6f\n"), Name, *Labels, Histogram.SumMicroseconds / 1000000.0);
+		Text.Appendf(TEXT("%s_count{%s} %llu\n"), Name, *Labels, Histogram.Count);
+	}
+}
+
+// 数值所在的桶
+int32 FDTHttpServerHistogram::GetBucket(uint64 Microseconds)
+{
+	if ( Microseconds < NumLinearBuckets ) { return (int32)Microseconds; }
+
+	const int32 Exponent = FMath::Min((int32)FMath::FloorLog2_64(Microseconds), MaxExponent);
+	const int32 SubBucket = (int32)(Microseconds >> (Exponent - 3)) & (NumSubBuckets - 1);
+	return FMath::Min(NumLinearBuckets + (Exponent - 4) * NumSubBuckets + SubBucket, NumBuckets - 1);
+}
+
+// 桶的上限
+uint64 FDTHttpServerHistogram::GetBucketLimit(int32 Bucket)
+{
+	if ( Bucket < NumLinearBuckets ) { return Bucket + 1; }
+
+	const int32 Exponent = 4 + (Bucket - NumLinearBuckets) / NumSubBuckets;
+	const int32 SubBucket = (Bucket - NumLinearBuckets) % NumSubBuckets;
+	return uint64(NumSubBuckets + SubBucket + 1) << (Exponent - 3);
+}
+
+// 百分位
+double FDTHttpServerHistogram::GetPercentile(double Percentile) const
+{
+	if ( Count == 0 ) { return 0.0; }
+
+	const uint64 Target = FMath::Max<uint64>((uint64)FMath::CeilToDouble(Count * Percentile), 1);
+	uint64 Total = 0;
+	for ( int32 Bucket = 0; Bucket < NumBuckets; ++Bucket )
+	{
+		Total += Buckets[Bucket];
+		if ( Total >= Target ) { return GetBucketLimit(Bucket) / 1000000.0; }
+	}
+	return GetBucketLimit(NumBuckets - 1) / 1000000.0;
+}
+
+// 记录一个数值
+void FDTHttpServerHistogram::Record(uint64 Microseconds)
+{
+	++Buckets[GetBucket(Microseconds)];
+	++Count;
+	SumMicroseconds += Microseconds;
+}
+
+// 合并另一个直方图
+void FDTHttpServerHistogram::Merge(const FDTHttpServerHistogram& Other)
+{
+	for ( int32 Bucket = 0; Bucket < NumBuckets; ++Bucket )
+	{
+		Buckets[Bucket] += Other.Buckets[Bucket];
+	}
+	Count += Other.Count;
+	SumMicroseconds += Other.SumMicroseconds;
+}
+
+FDTHttpServerRouteMetrics::FDTHttpServerRouteMetrics(const FString& InPath, const FString& InVerb)
+	: m_Path(InPath)
+	, m_Verb(InVerb)
+{
+}
+
+// 当前线程的分片, 线程第一次记录时按顺序分配
+FDTHttpServerRouteMetrics::FShard& FDTHttpServerRouteMetrics::GetShard()
+{
+	static std::atomic<uint32> NextShard { 0 };
+	static thread_local const uint32 ShardIndex = NextShard.fetch_add(1, std::memory_order_relaxed) % NumShards;
+	return m_Shards[ShardIndex];
+}
+
+void FDTHttpServerRouteMetrics::FAtomicHistogram::Record(uint64 Cycles)
+{
+	const uint64 Microseconds = DTHttpServer::CyclesToMicroseconds(Cycles);
+	Buckets[FDTHttpServerHistogram::GetBucket(Microseconds)].fetch_add(1, std::memory_order_relaxed);
+	Count.fetch_add(1, std::memory_order_relaxed);
+	SumMicroseconds.fetch_add(Microseconds, std::memory_order_relaxed);
+}
+
+void FDTHttpServerRouteMetrics::FAtomicHistogram::MergeTo(FDTHttpServerHistogram& Histogram) const
+{
+	for ( int32 Bucket = 0; Bucket < FDTHttpServerHistogram::NumBuckets; ++Bucket )
+	{
+		Histogram.Buckets[Bucket] += Buckets[Bucket].load(std::memory_order_relaxed);
+	}
+	Histogram.Count += Count.load(std::memory_order_relaxed);
+	Histogram.SumMicroseconds += SumMicroseconds.load(std::memory_order_relaxed);
+}
+
+// 收到请求
+void FDTHttpServerRouteMetrics::RecordRequest(int32 Bytes)
+{
+	FShard & Shard = GetShard();
+	Shard.Requests.fetch_add(1, std::memory_order_relaxed);
+	Shard.RequestBytes.fetch_add(Bytes, std::memory_order_relaxed);
+	INC_DWORD_STAT(STAT_DTHttpServer_Requests);
+	INC_DWORD_STAT_BY(STAT_DTHttpServer_RequestBytes, Bytes);
+}
+
+// 排队时间
+void FDTHttpServerRouteMetrics::RecordQueueWait(uint64 Cycles)
+{
+	GetShard().QueueWait.Record(Cycles);
+}
+
+// 执行时间
+void FDTHttpServerRouteMetrics::RecordHandler(uint64 Cycles)
+{
+	GetShard().Handler.Record(Cycles);
+}
+
+// 返回
+void FDTHttpServerRouteMetrics::RecordResponse(EHttpServerResponseCodes Code, int32 Bytes)
+{
+	const int32 CodeClass = (int32)Code / 100;
+	FShard & Shard = GetShard();
+	Shard.Codes[CodeClass >= 1 && CodeClass <= 5 ? CodeClass : 0].fetch_add(1, std::memory_order_relaxed);
+	Shard.ResponseBytes.fetch_add(Bytes, std::memory_order_relaxed);
+	INC_DWORD_STAT_BY(STAT_DTHttpServer_ResponseBytes, Bytes);
+}
+
+// 合并分片
+void FDTHttpServerRouteMetrics::Snapshot(FSnapshot& OutSnapshot) const
+{
+	OutSnapshot = FSnapshot();
+	for ( const FShard & Shard : m_Shards )
+	{
+		OutSnapshot.Requests += Shard.Requests.load(std::memory_order_relaxed);
+		OutSnapshot.RequestBytes += Shard.RequestBytes.load(std::memory_order_relaxed);
+		OutSnapshot.ResponseBytes += Shard.ResponseBytes.load(std::memory_order_relaxed);
+		for ( int32 CodeClass = 0; CodeClass < UE_ARRAY_COUNT(Shard.Codes); ++CodeClass )
+		{
+			OutSnapshot.Codes[CodeClass] += Shard.Codes[CodeClass].load(std::memory_order_relaxed);
+		}
+		Shard.QueueWait.MergeTo(OutSnapshot.QueueWait);
+		Shard.Handler.MergeTo(OutSnapshot.Handler);
+	}
+}
+
+// 添加路由
+FDTHttpServerRouteMetricsPtr FDTHttpServerMetrics::AddRoute(const FString& Path, const FString& Verb)
+{
+	return m_Routes.Add_GetRef(MakeShared<FDTHttpServerRouteMetrics, ESPMode::ThreadSafe>(Path, Verb));
+}
+
+// 生成 Prometheus 文本格式
+FString FDTHttpServerMetrics::Scrape(int32 QueueDepth) const
+{
+	TArray<FDTHttpServerRouteMetrics::FSnapshot> Snapshots;
+	TArray<FString> Labels;
+	Snapshots.SetNum(m_Routes.Num());
+	for ( int32 Index = 0; Index < m_Routes.Num(); ++Index )
+	{
+		m_Routes[Index]->Snapshot(Snapshots[Index]);
+		Labels.Add(FString::Printf(TEXT("route=\"%s\",verb=\"%s\""), *DTHttpServer::EscapeMetricLabel(m_Routes[Index]->GetPath()), *m_Routes[Index]->GetVerb()));
+	}
+
+	FString Text;
+	Text.Reserve(1024 + m_Routes.Num() * 1024);
+
+	Text.Append(TEXT("# HELP dthttpserver_requests_total Requests received per route.\n# TYPE dthttpserver_requests_total counter\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		Text.Appendf(TEXT("dthttpserver_requests_total{%s} %llu\n"), *Labels[Index], Snapshots[Index].Requests);
+	}
+
+	Text.Append(TEXT("# HELP dthttpserver_request_bytes_total Request body bytes per route.\n# TYPE dthttpserver_request_bytes_total counter\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		Text.Appendf(TEXT("dthttpserver_request_bytes_total{%s} %llu\n"), *Labels[Index], Snapshots[Index].RequestBytes);
+	}
+
+	Text.Append(TEXT("# HELP dthttpserver_response_bytes_total Response body bytes per route, after compression.\n# TYPE dthttpserver_response_bytes_total counter\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		Text.Appendf(TEXT("dthttpserver_response_bytes_total{%s} %llu\n"), *Labels[Index], Snapshots[Index].ResponseBytes);
+	}
+
+	static const TCHAR * CodeClasses[] = { TEXT("other"), TEXT("1xx"), TEXT("2xx"), TEXT("3xx"), TEXT("4xx"), TEXT("5xx") };
+	Text.Append(TEXT("# HELP dthttpserver_responses_total Responses per route and status class.\n# TYPE dthttpserver_responses_total counter\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		for ( int32 CodeClass = 0; CodeClass < UE_ARRAY_COUNT(CodeClasses); ++CodeClass )
+		{
+			if ( Snapshots[Index].Codes[CodeClass] == 0 ) { continue; }
+			Text.Appendf(TEXT("dthttpserver_responses_total{%s,code=\"%s\"} %llu\n"), *Labels[Index], CodeClasses[CodeClass], Snapshots[Index].Codes[CodeClass]);
+		}
+	}
+
+	Text.Append(TEXT("# HELP dthttpserver_queue_wait_seconds Time between receiving a request and starting its handler.\n# TYPE dthttpserver_queue_wait_seconds summary\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		DTHttpServer::AppendSummary(Text, TEXT("dthttpserver_queue_wait_seconds"), Labels[Index], Snapshots[Index].QueueWait);
+	}
+
+	Text.Append(TEXT("# HELP dthttpserver_handler_seconds Handler execution time.\n# TYPE dthttpserver_handler_seconds summary\n"));
+	for ( int32 Index = 0; Index < Snapshots.Num(); ++Index )
+	{
+		DTHttpServer::AppendSummary(Text, TEXT("dthttpserver_handler_seconds"), Labels[Index], Snapshots[Index].Handler);
+	}
+
+	Text.Append(TEXT("# HELP dthttpserver_queue_depth Requests waiting in the game thread queue.\n# TYPE dthttpserver_queue_depth gauge\n"));
+	Text.Appendf(TEXT("dthttpserver_queue_depth %d\n"), QueueDepth);
+	return Text;
+}
+
+FDTHttpServerHandlerScope::FDTHttpServerHandlerScope(const FDTHttpServerRouteMetricsPtr& InMetrics, uint64 ArrivalCycles)
+	: m_Metrics(InMetrics.Get())
+	, m_StartCycles(FPlatformTime::Cycles64())
+	, m_CycleCounter(GET_STATID(STAT_DTHttpServer_Handler))
+{
+	if ( m_Metrics != nullptr )
+	{
+		m_Metrics->RecordQueueWait(m_StartCycles - ArrivalCycles);
+	}
+}
+
+FDTHttpServerHandlerScope::~FDTHttpServerHandlerScope()
+{
+	if ( m_Metrics != nullptr )
+	{
+		m_Metrics->RecordHandler(FPlatformTime::Cycles64() - m_StartCycles);
+	}
+}
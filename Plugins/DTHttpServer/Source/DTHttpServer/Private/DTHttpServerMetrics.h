@@ -0,0 +1,140 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpServerConstants.h"
+#include "Stats/Stats.h"
+#include <atomic>
+
+DECLARE_STATS_GROUP(TEXT("DTHttpServer"), STATGROUP_DTHttpServer, STATCAT_Advanced);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handler Time"), STAT_DTHttpServer_Handler, STATGROUP_DTHttpServer, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Requests"), STAT_DTHttpServer_Requests, STATGROUP_DTHttpServer, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Request Bytes"), STAT_DTHttpServer_RequestBytes, STATGROUP_DTHttpServer, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Response Bytes"), STAT_DTHttpServer_ResponseBytes, STATGROUP_DTHttpServer, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rate Limited"), STAT_DTHttpServer_RateLimited, STATGROUP_DTHttpServer, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queue Depth"), STAT_DTHttpServer_QueueDepth, STATGROUP_DTHttpServer, );
+
+// 对数分桶的耗时直方图, 单位微秒, 每个 2 的幂分为 8 个桶, 误差不超过 12.5%
+struct FDTHttpServerHistogram
+{
+	static constexpr int32 NumLinearBuckets = 16;
+	static constexpr int32 NumSubBuckets = 8;
+	static constexpr int32 MaxExponent = 35;
+	static constexpr int32 NumBuckets = NumLinearBuckets + (MaxExponent - 3) * NumSubBuckets;
+
+	uint64		Buckets[NumBuckets] = {};
+	uint64		Count = 0;
+	uint64		SumMicroseconds = 0;
+
+	// 数值所在的桶
+	static int32 GetBucket(uint64 Microseconds);
+
+	// 桶的上限
+	static uint64 GetBucketLimit(int32 Bucket);
+
+	// 百分位, 单位秒
+	double GetPercentile(double Percentile) const;
+
+	// 记录一个数值, 不是线程安全的
+	void Record(uint64 Microseconds);
+
+	// 合并另一个直方图
+	void Merge(const FDTHttpServerHistogram & Other);
+};
+
+// 单个路由的统计, 记录时不加锁, 每个线程写入自己的分片, 读取时合并
+class FDTHttpServerRouteMetrics
+{
+public:
+	FDTHttpServerRouteMetrics(const FString & InPath, const FString & InVerb);
+
+	// 收到请求
+	void RecordRequest(int32 Bytes);
+
+	// 排队时间
+	void RecordQueueWait(uint64 Cycles);
+
+	// 执行时间
+	void RecordHandler(uint64 Cycles);
+
+	// 返回
+	void RecordResponse(EHttpServerResponseCodes Code, int32 Bytes);
+
+	// 合并后的统计
+	struct FSnapshot
+	{
+		uint64					Requests = 0;
+		uint64					RequestBytes = 0;
+		uint64					ResponseBytes = 0;
+		uint64					Codes[6] = {};
+		FDTHttpServerHistogram	QueueWait;
+		FDTHttpServerHistogram	Handler;
+	};
+	void Snapshot(FSnapshot & OutSnapshot) const;
+
+	const FString & GetPath() const { return m_Path; }
+	const FString & GetVerb() const { return m_Verb; }
+
+private:
+	static constexpr int32 NumShards = 8;
+
+	struct FAtomicHistogram
+	{
+		std::atomic<uint64>		Buckets[FDTHttpServerHistogram::NumBuckets] = {};
+		std::atomic<uint64>		Count { 0 };
+		std::atomic<uint64>		SumMicroseconds { 0 };
+
+		void Record(uint64 Cycles);
+		void MergeTo(FDTHttpServerHistogram & Histogram) const;
+	};
+
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FShard
+	{
+		std::atomic<uint64>		Requests { 0 };
+		std::atomic<uint64>		RequestBytes { 0 };
+		std::atomic<uint64>		ResponseBytes { 0 };
+		// 按 1xx-5xx 分类, 0 为其他
+		std::atomic<uint64>		Codes[6] = {};
+		FAtomicHistogram		QueueWait;
+		FAtomicHistogram		Handler;
+	};
+
+	// 当前线程的分片
+	FShard & GetShard();
+
+private:
+	FString		m_Path;
+	FString		m_Verb;
+	FShard		m_Shards[NumShards];
+};
+
+typedef TSharedPtr<FDTHttpServerRouteMetrics, ESPMode::ThreadSafe> FDTHttpServerRouteMetricsPtr;
+
+// 所有路由的统计
+class FDTHttpServerMetrics
+{
+public:
+	// 添加路由, 在游戏线程调用
+	FDTHttpServerRouteMetricsPtr AddRoute(const FString & Path, const FString & Verb);
+
+	// 生成 Prometheus 文本格式
+	FString Scrape(int32 QueueDepth) const;
+
+private:
+	TArray<FDTHttpServerRouteMetricsPtr>	m_Routes;
+};
+
+// 记录排队和执行时间, 同时计入 STAT_DTHttpServer_Handler
+class FDTHttpServerHandlerScope
+{
+public:
+	FDTHttpServerHandlerScope(const FDTHttpServerRouteMetricsPtr & InMetrics, uint64 ArrivalCycles);
+	~FDTHttpServerHandlerScope();
+
+private:
+	FDTHttpServerRouteMetrics *		m_Metrics;
+	uint64							m_StartCycles;
+	FScopeCycleCounter				m_CycleCounter;
+};
@@ -0,0 +1,92 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerNative.h"
+#include "DTHttpServerMetrics.h"
+#include "Async/Async.h"
+
+namespace DTHttpServer
+{
+	// 在游戏线程上完成请求
+	static void CompleteOnGameThread(const FHttpResultCallback & OnComplete, TUniquePtr<FHttpServerResponse> && Response, FDTHttpServerRouteMetrics * Metrics)
+	{
+		if ( Metrics != nullptr )
+		{
+			Metrics->RecordResponse(Response->Code, Response->Body.Num());
+		}
+
+		if ( IsInGameThread() )
+		{
+			OnComplete(MoveTemp(Response));
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [OnComplete, Response = MoveTemp(Response)]() mutable
+		{
+			OnComplete(MoveTemp(Response));
+		});
+	}
+}
+
+FDTHttpServerPromise::FDTHttpServerPromise(const FHttpResultCallback& OnComplete, TUniquePtr<FHttpServerResponse>&& Response, const FDTHttpServerCompression& Compression, const FDTHttpServerCacheStore& CacheStore, const TSharedPtr<FDTHttpServerRouteMetrics, ESPMode::ThreadSafe>& Metrics)
+	: m_State(MakeShared<FState, ESPMode::ThreadSafe>())
+{
+	m_State->OnComplete = OnComplete;
+	m_State->Response = MoveTemp(Response);
+	m_State->Compression = Compression;
+	m_State->CacheStore = CacheStore;
+	m_State->Metrics = Metrics;
+}
+
+// 设置返回数据
+void FDTHttpServerPromise::SetValue(FDTHttpServerNativeResponse&& NativeResponse) const
+{
+	// 只允许返回一次
+	if ( m_State->bSet.exchange(true) ) { return; }
+
+	TUniquePtr<FHttpServerResponse> Response = MoveTemp(m_State->Response);
+	Response->Code = NativeResponse.Code;
+
+	// 覆盖返回类型
+	if ( !NativeResponse.ContentType.IsEmpty() )
+	{
+		Response->Headers.Add(TEXT("Content-Type"), { MoveTemp(NativeResponse.ContentType) });
+	}
+
+	// 额外的返回头
+	for ( auto & Header : NativeResponse.Headers )
+	{
+		Response->Headers.Add(Header.Key, MoveTemp(Header.Value));
+	}
+
+	// 移动返回数据
+	Response->Body = MoveTemp(NativeResponse.Body);
+	if ( !NativeResponse.bAllowCompression )
+	{
+		m_State->Compression = FDTHttpServerCompression();
+	}
+
+	// 在工作线程中生成 ETag 和压缩
+	if ( m_State->CacheStore.IsEnabled() || m_State->Compression.ShouldCompress(Response->Body.Num()) )
+	{
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [State = m_State, Response = MoveTemp(Response)]() mutable
+		{
+			State->CacheStore.Apply(*Response);
+			State->Compression.Apply(*Response);
+			DTHttpServer::CompleteOnGameThread(State->OnComplete, MoveTemp(Response), State->Metrics.Get());
+		});
+		return;
+	}
+
+	DTHttpServer::CompleteOnGameThread(m_State->OnComplete, MoveTemp(Response), m_State->Metrics.Get());
+}
+
+// 没有返回的请求统一返回错误, 避免连接一直挂起
+FDTHttpServerPromise::FState::~FState()
+{
+	if ( !bSet.load() && Response.IsValid() )
+	{
+		Response->Code = EHttpServerResponseCodes::ServerError;
+		DTHttpServer::CompleteOnGameThread(OnComplete, MoveTemp(Response), Metrics.Get());
+	}
+}
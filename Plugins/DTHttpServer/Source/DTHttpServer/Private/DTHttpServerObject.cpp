@@ -2,26 +2,227 @@
 // EMail: 45141961@qq.com
 
 #include "DTHttpServerObject.h"
+#include "DTHttpServerQueue.h"
+#include "DTHttpServerRouter.h"
+#include "DTHttpServer.h"
+#include "DTHttpServerCompression.h"
+#include "DTHttpServerCache.h"
+#include "DTHttpServerStatic.h"
+#include "DTHttpServerEvents.h"
+#include "DTHttpServerMetrics.h"
+#include "DTHttpServerRateLimiter.h"
+#include "DTHttpServerJson.h"
+#include "DTHttpServerBatch.h"
+#include "DTHttpServerUpload.h"
+#include "UObject/StructOnScope.h"
+#include "Misc/Paths.h"
 #include "HttpServerModule.h"
 #include "IHttpRouter.h"
 #include "Core/Public/Misc/ConfigCacheIni.h"
 #include "Sockets/Public/IPAddress.h"
-#include <string>
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+
+namespace DTHttpServer
+{
+	// 蓝图回调参数
+	struct FBlueprintArgs
+	{
+		FString						RelativePath;
+		FDTHttpServerRequestViewPtr	View;
+		FDTHttpServerHeaders		Headers;
+		FDTHttpServerParams			Params;
+		FString						Body;
+	};
+
+	// 生成蓝图回调参数, 头和参数只引用请求, 查找时才读取
+	static void MakeBlueprintArgs(const FHttpServerRequest & Request, const TSharedPtr<const FHttpServerRequest, ESPMode::ThreadSafe> & OwnedRequest, const FDTHttpServerPathParams & PathParams, FBlueprintArgs & Args)
+	{
+		Args.RelativePath = FString(PathParams.GetRemainder());
+
+		// 请求视图
+		Args.View = MakeShared<FDTHttpServerRequestView, ESPMode::ThreadSafe>();
+		Args.View->Request = &Request;
+		Args.View->OwnedRequest = OwnedRequest;
+		Args.View->PathParams = PathParams;
+		Args.Headers.View = Args.View;
+		Args.Params.View = Args.View;
+
+		// 获取数据, 直接从接收缓存转码
+		if ( Request.Body.Num() > 0 )
+		{
+			const FUTF8ToTCHAR BodyConverter((const ANSICHAR*)Request.Body.GetData(), Request.Body.Num());
+			Args.Body = FString(BodyConverter.Length(), BodyConverter.Get());
+		}
+	}
+
+	// 生成蓝图回调参数, 持有请求拷贝
+	static void MakeBlueprintArgs(const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe> & Request, const FDTHttpServerPathParams & PathParams, FBlueprintArgs & Args)
+	{
+		MakeBlueprintArgs(*Request, Request, PathParams, Args);
+	}
+
+	// 在游戏线程上执行蓝图
+	template<typename DelegateType>
+	static FString ExecuteBlueprint(const DelegateType & HttpResponse, const FBlueprintArgs & Args)
+	{
+		FString ResponseInfo;
+		if ( HttpResponse.IsBound() )
+		{
+			ResponseInfo = HttpResponse.Execute(Args.RelativePath, Args.Headers, Args.Params, Args.Body);
+		}
+
+		// 执行结束后视图失效, 同时释放请求拷贝
+		Args.View->Reset();
+		return ResponseInfo;
+	}
+
+	// 只有状态码的返回
+	static FDTHttpServerNativeResponse MakeStatusResponse(EHttpServerResponseCodes Code)
+	{
+		FDTHttpServerNativeResponse NativeResponse;
+		NativeResponse.Code = Code;
+		return NativeResponse;
+	}
+
+	// 带错误信息的返回
+	static FDTHttpServerNativeResponse MakeErrorResponse(EHttpServerResponseCodes Code, const FString & Error)
+	{
+		static const ANSICHAR ErrorPrefix[] = "{\"error\":";
+		FDTHttpServerNativeResponse NativeResponse;
+		NativeResponse.Code = Code;
+		NativeResponse.ContentType = TEXT("application/json;charset=utf-8");
+		NativeResponse.Body.Append((const uint8*)ErrorPrefix, UE_ARRAY_COUNT(ErrorPrefix) - 1);
+		FDTHttpServerJson::WriteString(Error, NativeResponse.Body);
+		NativeResponse.Body.Add('}');
+		return NativeResponse;
+	}
+
+	// 超过限流的返回
+	static TUniquePtr<FHttpServerResponse> MakeRateLimitedResponse(const FDTHttpServerRouteContext & Context)
+	{
+		TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+		Response->Code = static_cast<EHttpServerResponseCodes>(429);
+		Response->Headers.Add(TEXT("Retry-After"), { TEXT("1") });
+		Context.Metrics->RecordResponse(Response->Code, 0);
+		INC_DWORD_STAT(STAT_DTHttpServer_RateLimited);
+		return Response;
+	}
+
+	// 转码蓝图返回数据
+	static FDTHttpServerNativeResponse EncodeBlueprintResponse(const FString & ResponseInfo)
+	{
+		FDTHttpServerNativeResponse NativeResponse;
+		if ( !ResponseInfo.IsEmpty() )
+		{
+			const FTCHARToUTF8 InfoConverter(*ResponseInfo, ResponseInfo.Len());
+			NativeResponse.Body.Append((const uint8*)InfoConverter.Get(), InfoConverter.Length());
+		}
+		return NativeResponse;
+	}
+
+	// 拷贝请求, 用于延迟或跨线程处理
+	static TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe> CopyRequest(const FHttpServerRequest & Request)
+	{
+		return MakeShared<FHttpServerRequest, ESPMode::ThreadSafe>(Request);
+	}
+
+	// 接管请求数据, 只拷贝头和参数, 用于上传等较大的请求
+	// 预处理返回后引擎不再读取请求数据, 直接移动接收缓存避免再保存一份完整数据
+	static TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> TakeRequest(const FHttpServerRequest & Request)
+	{
+		TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> OwnedRequest = MakeShared<FHttpServerRequest, ESPMode::ThreadSafe>();
+		OwnedRequest->Verb = Request.Verb;
+		OwnedRequest->RelativePath = Request.RelativePath;
+		OwnedRequest->Headers = Request.Headers;
+		OwnedRequest->QueryParams = Request.QueryParams;
+		OwnedRequest->PathParams = Request.PathParams;
+		OwnedRequest->PeerAddress = Request.PeerAddress;
+		OwnedRequest->Body = MoveTemp(const_cast<FHttpServerRequest&>(Request).Body);
+		return OwnedRequest;
+	}
+}
 
 // 开始销毁
 void UDTHttpServerObject::BeginDestroy()
 {
 	if ( m_HttpRouter.IsValid() )
 	{
-		for ( const auto & HttpRouteHandle : m_HttpRouteHandles )
+		m_HttpRouter->UnregisterRequestPreprocessor(m_RequestHandle);
+		m_HttpRouter.Reset();
+	}
+	m_Router.Reset();
+	m_Coalescers.Empty();
+	m_StaticDirectories.Empty();
+
+	// 挂起的事件订阅返回重连时间, 客户端稍后重连
+	for ( const auto & EventStream : m_EventStreams )
+	{
+		EventStream.Value->Flush(MAX_dbl);
+	}
+	m_EventStreams.Empty();
+
+	// Destroy 会丢弃未执行的任务, 其中的 Promise 不会被销毁, 客户端收不到响应, 所以先等待所有任务执行完
+	if ( m_ThreadPool.IsValid() )
+	{
+		while ( m_PoolTasks.GetValue() > 0 )
 		{
-			m_HttpRouter->UnbindRoute(HttpRouteHandle);
+			FPlatformProcess::Sleep(0.001f);
 		}
-		m_HttpRouter.Reset();
+		m_ThreadPool->Destroy();
+		m_ThreadPool.Reset();
 	}
+
+	// 队列中未执行的请求返回错误
+	m_RequestQueue.Reset();
 	UObject::BeginDestroy();
 }
 
+// 每帧执行队列中的请求
+void UDTHttpServerObject::Tick(float DeltaTime)
+{
+	if ( !m_RequestQueue.IsValid() ) { return; }
+
+	m_RequestQueue->SetMaxDepth(MaxQueueDepth);
+	m_CompressionCache->SetMaxBytes(int64(FMath::Max(CompressionCacheMegabytes, 0)) * 1024 * 1024);
+	m_ResponseCache->SetMaxBytes(int64(FMath::Max(ResponseCacheMegabytes, 0)) * 1024 * 1024);
+	for ( const TSharedPtr<FDTHttpServerStaticDirectory, ESPMode::ThreadSafe> & StaticDirectory : m_StaticDirectories )
+	{
+		StaticDirectory->SetLimits(int64(FMath::Max(StaticFileCacheMegabytes, 0)) * 1024 * 1024, int64(FMath::Max(StaticFileMaxResponseMegabytes, 1)) * 1024 * 1024);
+	}
+	m_RequestQueue->Drain(FMath::Max(FrameBudgetMicroseconds, 0) / 1000000.0, m_QueueStats);
+	SET_DWORD_STAT(STAT_DTHttpServer_QueueDepth, m_RequestQueue->Num());
+
+	// 有新事件或超时的订阅
+	const double Now = FPlatformTime::Seconds();
+	for ( const auto & EventStream : m_EventStreams )
+	{
+		EventStream.Value->Flush(Now);
+	}
+
+	// 等待合并超时的请求
+	for ( const TSharedPtr<FDTHttpServerCoalescer, ESPMode::ThreadSafe> & Coalescer : m_Coalescers )
+	{
+		Coalescer->Flush(Now);
+	}
+}
+
+TStatId UDTHttpServerObject::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDTHttpServerObject, STATGROUP_Tickables);
+}
+
+// 获取队列统计
+FDTHttpServerQueueStats UDTHttpServerObject::GetQueueStats() const
+{
+	FDTHttpServerQueueStats QueueStats = m_QueueStats;
+	if ( m_RequestQueue.IsValid() )
+	{
+		QueueStats.QueueDepth = m_RequestQueue->Num();
+	}
+	return QueueStats;
+}
+
 // 创建路由
 void UDTHttpServerObject::StartListen(int Port)
 {
@@ -29,26 +230,166 @@ void UDTHttpServerObject::StartListen(int Port)
 	static const FString IniSectionName(TEXT("HTTPServer.Listeners"));
 	GConfig->SetString(*IniSectionName, TEXT("DefaultBindAddress"), TEXT("any"), GEngineIni);
 	
+	// 游戏线程请求队列
+	m_RequestQueue = MakeShared<FDTHttpServerRequestQueue, ESPMode::ThreadSafe>();
+	m_RequestQueue->SetMaxDepth(MaxQueueDepth);
+
+	// 压缩数据缓存
+	m_CompressionCache = MakeShared<FDTHttpServerCompressionCache, ESPMode::ThreadSafe>(int64(FMath::Max(CompressionCacheMegabytes, 0)) * 1024 * 1024);
+
+	// GET 返回缓存
+	m_ResponseCache = MakeShared<FDTHttpServerResponseCache, ESPMode::ThreadSafe>(int64(FMath::Max(ResponseCacheMegabytes, 0)) * 1024 * 1024);
+
+	// 默认返回头
+	if ( !m_HeaderSet.IsValid() )
+	{
+		SetHeaderPolicy(FDTHttpServerHeaderPolicy());
+	}
+
 	// 监听路由
 	m_HttpRouter = FHttpServerModule::Get().GetHttpRouter(Port);
+	m_Router = MakeShared<FDTHttpServerRouter>();
+	m_Metrics = MakeShared<FDTHttpServerMetrics>();
+	m_RateLimiter = MakeShared<FDTHttpServerRateLimiter>(4096);
+
+	// 所有请求在引擎路由前由本服务器的路由树分发, 跨域预检也在这里直接应答
+	m_RequestHandle = m_HttpRouter->RegisterRequestPreprocessor(
+		[this](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+		{
+			return HandleRequest(Request, OnComplete);
+		});
+
 	FHttpServerModule::Get().StartAllListeners();
 }
 
-TUniquePtr<FHttpServerResponse> UDTHttpServerObject::CreateHttpServerResponse() const
+// 创建返回对象, 路由没有单独设置时使用服务器的返回头
+TUniquePtr<FHttpServerResponse> UDTHttpServerObject::CreateHttpServerResponse(const FDTHttpServerHeaderSetPtr& RouteHeaderSet) const
+{
+	if ( RouteHeaderSet.IsValid() ) { return RouteHeaderSet->CreateResponse(); }
+
+	// 线程安全的子请求在线程池中创建返回, 游戏线程可能同时替换返回头
+	FDTHttpServerHeaderSetPtr HeaderSet;
+	{
+		FScopeLock ScopeLock(&m_HeaderLock);
+		HeaderSet = m_HeaderSet;
+	}
+	return HeaderSet->CreateResponse();
+}
+
+// 使用缓存的返回应答
+bool UDTHttpServerObject::ServeCachedResponse(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete, const FDTHttpServerRouteContext& Context) const
 {
-	// 创建返回数据
+	const FDTHttpServerRouteOptions & Options = Context.Options;
+	if ( !Options.bCacheResponse || Request.Verb != EHttpServerRequestVerbs::VERB_GET ) { return false; }
+
+	const FDTHttpServerCachedResponsePtr CachedResponse = m_ResponseCache->Find(FDTHttpServerResponseCache::MakeKey(Request));
+	if ( !CachedResponse.IsValid() ) { return false; }
+
 	TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
-	Response->Code = EHttpServerResponseCodes::Ok;
+	Response->Headers = CachedResponse->Headers;
 
-	// 设置返回类型
-	Response->Headers.Add(TEXT("Content-Type"), { TEXT("application/json;charset=utf-8") });
-	Response->Headers.Add(TEXT("Access-Control-Allow-Origin"), { TEXT("*") });
-	Response->Headers.Add(TEXT("Access-Control-Allow-Methods"), { TEXT("GET,POST,PUT,PATCH,DELETE,OPTIONS") });
-	Response->Headers.Add(TEXT("Access-Control-Allow-Headers"), { TEXT("Origin,X-Requested-With,Content-Type,Accept") });
-	Response->Headers.Add(TEXT("Access-Control-Max-Age"), { TEXT("600") });
-	Response->Headers.Add(TEXT("Access-Control-Allow-Credentials"), { TEXT("true") });
+	// 客户端已有相同数据, 不需要返回数据
+	const TArray<FString> * IfNoneMatch = Request.Headers.Find(TEXT("If-None-Match"));
+	if ( IfNoneMatch != nullptr && FDTHttpServerResponseCache::MatchesETag(*IfNoneMatch, CachedResponse->ETag) )
+	{
+		Response->Code = EHttpServerResponseCodes::NotModified;
+		Context.Metrics->RecordResponse(Response->Code, 0);
+		OnComplete(MoveTemp(Response));
+		return true;
+	}
+
+	// 返回缓存的数据, 压缩结果由压缩缓存复用
+	FDTHttpServerNativeResponse NativeResponse;
+	NativeResponse.Code = CachedResponse->Code;
+	NativeResponse.Body = CachedResponse->Body;
+	const FDTHttpServerCompression Compression = Options.bCompressResponse ? FDTHttpServerCompression::Negotiate(Request, FMath::Max(Options.CompressMinBytes, 1), m_CompressionCache) : FDTHttpServerCompression();
+	FDTHttpServerPromise(OnComplete, MoveTemp(Response), Compression, FDTHttpServerCacheStore(), Context.Metrics).SetValue(MoveTemp(NativeResponse));
+	return true;
+}
+
+// 创建异步返回, 根据请求选择压缩格式
+FDTHttpServerPromise UDTHttpServerObject::CreatePromise(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete, const FDTHttpServerRouteContext& Context) const
+{
+	const FDTHttpServerRouteOptions & Options = Context.Options;
+	FDTHttpServerCompression Compression;
+	if ( Options.bCompressResponse )
+	{
+		Compression = FDTHttpServerCompression::Negotiate(Request, FMath::Max(Options.CompressMinBytes, 1), m_CompressionCache);
+	}
+
+	// 只缓存 GET 请求
+	FDTHttpServerCacheStore CacheStore;
+	if ( Options.bCacheResponse && Request.Verb == EHttpServerRequestVerbs::VERB_GET )
+	{
+		CacheStore.Cache = m_ResponseCache;
+		CacheStore.Key = FDTHttpServerResponseCache::MakeKey(Request);
+		CacheStore.Path = Request.RelativePath.GetPath();
+		CacheStore.TtlSeconds = Options.CacheTtlSeconds;
+		CacheStore.Generation = m_ResponseCache->GetGeneration(CacheStore.Path);
+		if ( const TArray<FString> * IfNoneMatch = Request.Headers.Find(TEXT("If-None-Match")) )
+		{
+			CacheStore.IfNoneMatch = *IfNoneMatch;
+		}
+	}
 
-	return Response;
+	return FDTHttpServerPromise(OnComplete, CreateHttpServerResponse(Context.HeaderSet), Compression, CacheStore, Context.Metrics);
+}
+
+// 使缓存失效
+void UDTHttpServerObject::InvalidateCache(const FString& HttpPath)
+{
+	if ( m_ResponseCache.IsValid() )
+	{
+		m_ResponseCache->Invalidate(HttpPath);
+	}
+}
+
+// 匹配路由并执行, 不是本服务器的路径交给引擎路由
+bool UDTHttpServerObject::HandleRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+{
+	FDTHttpServerPathParams PathParams;
+	const FDTHttpServerRoute * Route = m_Router->Match(Request.RelativePath.GetPath(), Request.Verb, PathParams);
+	if ( Route == nullptr ) { return false; }
+
+	// 跨域预检直接用缓存的返回头应答
+	if ( Request.Verb == EHttpServerRequestVerbs::VERB_OPTIONS )
+	{
+		const FDTHttpServerHeaderSet & HeaderSet = Route->Context->HeaderSet.IsValid() ? *Route->Context->HeaderSet : *m_HeaderSet;
+		if ( !HeaderSet.IsCorsEnabled() ) { return false; }
+
+		OnComplete(HeaderSet.CreatePreflightResponse());
+		return true;
+	}
+
+	Route->Context->Metrics->RecordRequest(Request.Body.Num());
+
+	// 限流, 在读取请求和执行回调前直接拒绝
+	const FDTHttpServerRateLimit & RouteRateLimit = Route->Context->Options.RateLimit;
+	if ( PeerRateLimit.bEnabled || RouteRateLimit.bEnabled )
+	{
+		const uint64 PeerKey = FDTHttpServerRateLimiter::MakePeerKey(Request);
+		if ( !m_RateLimiter->TryAcquire(PeerKey, PeerRateLimit) || !m_RateLimiter->TryAcquire(FDTHttpServerRateLimiter::MakeRouteKey(PeerKey, Route), RouteRateLimit) )
+		{
+			OnComplete(DTHttpServer::MakeRateLimitedResponse(*Route->Context));
+			return true;
+		}
+	}
+
+	// 相同的 GET 请求只执行一次
+	if ( Route->Context->Coalescer.IsValid() && Request.Verb == EHttpServerRequestVerbs::VERB_GET )
+	{
+		return Route->Context->Coalescer->Run(Request, PathParams, OnComplete, Route->Handler);
+	}
+
+	return Route->Handler(Request, PathParams, OnComplete);
+}
+
+// 设置服务器返回头
+void UDTHttpServerObject::SetHeaderPolicy(const FDTHttpServerHeaderPolicy& HeaderPolicy)
+{
+	const FDTHttpServerHeaderSetPtr HeaderSet = MakeShared<FDTHttpServerHeaderSet, ESPMode::ThreadSafe>(HeaderPolicy);
+	FScopeLock ScopeLock(&m_HeaderLock);
+	m_HeaderSet = HeaderSet;
 }
 
 // 创建服务对象
@@ -59,21 +400,28 @@ void UDTHttpServerObject::CreateHttpServer(int Port, UDTHttpServerObject*& HttpS
 	HttpServer->StartListen(Port);
 }
 
-// 绑定Get消息
-void UDTHttpServerObject::Bind(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FHttpResponse HttpResponse)
+// 创建路由运行时数据
+FDTHttpServerRouteContextRef UDTHttpServerObject::MakeRouteContext(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const FDTHttpServerRouteOptions& Options, bool bSubRequest)
 {
-	// 无效路由
-	if ( !m_HttpRouter.IsValid() ) { return; }
-
-	// 绑定配置消息
-	FHttpRouteHandle HttpRouteOptions = m_HttpRouter->BindRoute(HttpPath, EHttpServerRequestVerbs::VERB_OPTIONS,
-		[this](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete) {
-
-			OnComplete(CreateHttpServerResponse());
-
-			return true;
-		});
+	TSharedRef<FDTHttpServerRouteContext, ESPMode::ThreadSafe> Context = MakeShared<FDTHttpServerRouteContext, ESPMode::ThreadSafe>();
+	Context->Options = Options;
+	Context->bSubRequest = bSubRequest;
+	if ( Options.bOverrideHeaderPolicy )
+	{
+		Context->HeaderSet = MakeShared<FDTHttpServerHeaderSet, ESPMode::ThreadSafe>(Options.HeaderPolicy);
+	}
+	Context->Metrics = m_Metrics->AddRoute(HttpPath, StaticEnum<EDTHttpServerVerbs>()->GetNameStringByValue((int64)HttpVerbs));
+	if ( Options.bCoalesceRequests && HttpVerbs == EDTHttpServerVerbs::GET )
+	{
+		Context->Coalescer = MakeShared<FDTHttpServerCoalescer, ESPMode::ThreadSafe>(Options.CoalesceMaxWaitSeconds, Options.CoalesceKeyHeaders, Context->Metrics);
+		m_Coalescers.Add(Context->Coalescer);
+	}
+	return Context;
+}
 
+// 绑定路由
+void UDTHttpServerObject::BindRoute(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const TSharedRef<const FDTHttpServerRouteContext, ESPMode::ThreadSafe>& Context, FDTHttpServerRouteHandler && Handler)
+{
 	// 设置类型
 	EHttpServerRequestVerbs Verb = EHttpServerRequestVerbs::VERB_NONE;
 	switch ( HttpVerbs )
@@ -94,60 +442,535 @@ void UDTHttpServerObject::Bind(const FString& HttpPath, EDTHttpServerVerbs HttpV
 		Verb = EHttpServerRequestVerbs::VERB_DELETE;
 		break;
 	}
-	
+
+	// 编译路径模板并加入路由树, 跨域预检统一由预处理返回
+	if ( !m_Router->Insert(HttpPath, Verb, Context, MoveTemp(Handler)) )
+	{
+		UE_LOG(LogDTHttpServer, Warning, TEXT("Bind route failed, duplicate route or invalid wildcard : %s"), *HttpPath);
+	}
+}
+
+// 按执行方式派发任务
+bool UDTHttpServerObject::Dispatch(EDTHttpServerExecution Execution, EDTHttpServerPriority Priority, TUniqueFunction<void()>&& Task)
+{
+	switch ( Execution )
+	{
+	case EDTHttpServerExecution::Inline:
+		Task();
+		break;
+	case EDTHttpServerExecution::TaskGraph:
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, MoveTemp(Task));
+		break;
+	case EDTHttpServerExecution::ThreadPool:
+		// 第一次使用时创建线程池
+		if ( !m_ThreadPool.IsValid() )
+		{
+			m_ThreadPool.Reset(FQueuedThreadPool::Allocate());
+			m_ThreadPool->Create(FMath::Max(ThreadPoolSize, 1), 128 * 1024, TPri_Normal, TEXT("DTHttpServerPool"));
+		}
+		// 任务连同捕获的 Promise 销毁后才计数减一
+		m_PoolTasks.Increment();
+		AsyncPool(*m_ThreadPool, [Task = MoveTemp(Task), PoolTasks = &m_PoolTasks]() mutable
+		{
+			{
+				TUniqueFunction<void()> Run = MoveTemp(Task);
+				Run();
+			}
+			PoolTasks->Decrement();
+		});
+		break;
+	case EDTHttpServerExecution::Queued:
+		return m_RequestQueue->Enqueue(Priority, MoveTemp(Task));
+	}
+	return true;
+}
+
+// 执行子请求
+void UDTHttpServerObject::RunSubRequest(const FHttpServerRequest& Parent, const FDTHttpServerBatchRequest& SubRequest, FHttpResultCallback&& OnComplete)
+{
+	const TSharedRef<FHttpServerRequest, ESPMode::ThreadSafe> Request = FDTHttpServerBatch::MakeRequest(Parent, SubRequest);
+	if ( Request->Verb == EHttpServerRequestVerbs::VERB_NONE )
+	{
+		OnComplete(FDTHttpServerBatch::MakeStatusResponse(EHttpServerResponseCodes::BadMethod));
+		return;
+	}
+
+	// 不支持嵌套的批量请求, 事件流的返回会一直保持到超时, 也不支持
+	FDTHttpServerPathParams PathParams;
+	const FDTHttpServerRoute * Route = m_Router->Match(Request->RelativePath.GetPath(), Request->Verb, PathParams);
+	if ( Route == nullptr || !Route->Context->bSubRequest )
+	{
+		OnComplete(FDTHttpServerBatch::MakeStatusResponse(EHttpServerResponseCodes::NotFound));
+		return;
+	}
+
+	Route->Context->Metrics->RecordRequest(Request->Body.Num());
+
+	// 外层请求已经计入客户端限流, 子请求只按路由限流
+	const FDTHttpServerRateLimit & RouteRateLimit = Route->Context->Options.RateLimit;
+	if ( RouteRateLimit.bEnabled && !m_RateLimiter->TryAcquire(FDTHttpServerRateLimiter::MakeRouteKey(FDTHttpServerRateLimiter::MakePeerKey(Parent), Route), RouteRateLimit) )
+	{
+		OnComplete(DTHttpServer::MakeRateLimitedResponse(*Route->Context));
+		return;
+	}
+
+	// 线程安全的 Inline 路由在线程池中执行, 其它路由按自己的执行方式派发
+	if ( Route->Context->Options.bThreadSafe && Route->Context->Options.Execution == EDTHttpServerExecution::Inline )
+	{
+		Dispatch(EDTHttpServerExecution::ThreadPool, EDTHttpServerPriority::Normal, [Handler = Route->Handler, Request, PathParams, OnComplete = MoveTemp(OnComplete)]()
+		{
+			if ( !Handler(*Request, PathParams, OnComplete) )
+			{
+				OnComplete(FDTHttpServerBatch::MakeStatusResponse(EHttpServerResponseCodes::NotFound));
+			}
+		});
+		return;
+	}
+
+	if ( !Route->Handler(*Request, PathParams, OnComplete) )
+	{
+		OnComplete(FDTHttpServerBatch::MakeStatusResponse(EHttpServerResponseCodes::NotFound));
+	}
+}
+
+// 绑定Get消息
+void UDTHttpServerObject::Bind(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FHttpResponse HttpResponse)
+{
+	BindWithOptions(HttpPath, HttpVerbs, FDTHttpServerRouteOptions(), HttpResponse);
+}
+
+// 绑定蓝图消息
+void UDTHttpServerObject::BindWithOptions(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const FDTHttpServerRouteOptions& Options, FHttpResponse HttpResponse)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() ) { return; }
+
+	// 绑定正常接口
+	const EDTHttpServerExecution Execution = Options.Execution;
+	const EDTHttpServerPriority Priority = Options.Priority;
+	const TSharedRef<FDTHttpServerRequestQueue, ESPMode::ThreadSafe> RequestQueue = m_RequestQueue.ToSharedRef();
+
+	// 蓝图只能在游戏线程执行
+	FDTHttpServerRouteOptions RouteOptions = Options;
+	RouteOptions.bThreadSafe = false;
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, HttpVerbs, RouteOptions);
+	BindRoute(HttpPath, HttpVerbs, Context,
+		[this, HttpResponse, Execution, Priority, RequestQueue, Context](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
+		{
+			// 使用缓存的返回, 不执行回调
+			if ( ServeCachedResponse(Request, OnComplete, *Context) ) { return true; }
+
+			// 创建返回对象
+			const uint64 ArrivalCycles = FPlatformTime::Cycles64();
+			const FDTHttpServerPromise Promise = CreatePromise(Request, OnComplete, *Context);
+
+			// 直接在游戏线程执行
+			if ( Execution == EDTHttpServerExecution::Inline )
+			{
+				DTHttpServer::FBlueprintArgs Args;
+				DTHttpServer::MakeBlueprintArgs(Request, nullptr, PathParams, Args);
+				FString ResponseInfo;
+				{
+					FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+					ResponseInfo = DTHttpServer::ExecuteBlueprint(HttpResponse, Args);
+				}
+				Promise.SetValue(DTHttpServer::EncodeBlueprintResponse(ResponseInfo));
+				return true;
+			}
+
+			// 排队在游戏线程执行
+			if ( Execution == EDTHttpServerExecution::Queued )
+			{
+				const bool bQueued = Dispatch(Execution, Priority, [SharedRequest = DTHttpServer::CopyRequest(Request), PathParams, Promise, HttpResponse, Context, ArrivalCycles]()
+				{
+					DTHttpServer::FBlueprintArgs Args;
+					DTHttpServer::MakeBlueprintArgs(SharedRequest, PathParams, Args);
+					FString ResponseInfo;
+					{
+						FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+						ResponseInfo = DTHttpServer::ExecuteBlueprint(HttpResponse, Args);
+					}
+					Promise.SetValue(DTHttpServer::EncodeBlueprintResponse(ResponseInfo));
+				});
+				if ( !bQueued )
+				{
+					Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::ServiceUnavail));
+				}
+				return true;
+			}
+
+			// 在工作线程中转码, 只有执行蓝图时排队回到游戏线程
+			Dispatch(Execution, Priority, [SharedRequest = DTHttpServer::CopyRequest(Request), PathParams, Promise, HttpResponse, RequestQueue, Priority, Context, ArrivalCycles]()
+			{
+				DTHttpServer::FBlueprintArgs Args;
+				DTHttpServer::MakeBlueprintArgs(SharedRequest, PathParams, Args);
+
+				const bool bQueued = RequestQueue->Enqueue(Priority, [Args = MoveTemp(Args), Promise, HttpResponse, Context, ArrivalCycles]()
+				{
+					FString ResponseInfo;
+					{
+						FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+						ResponseInfo = DTHttpServer::ExecuteBlueprint(HttpResponse, Args);
+					}
+
+					// 返回数据回到工作线程转码
+					AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [ResponseInfo = MoveTemp(ResponseInfo), Promise]()
+					{
+						Promise.SetValue(DTHttpServer::EncodeBlueprintResponse(ResponseInfo));
+					});
+				});
+				if ( !bQueued )
+				{
+					Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::ServiceUnavail));
+				}
+			});
+
+			return true;
+		});
+}
+
+// 绑定原生消息
+void UDTHttpServerObject::BindNative(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FDTHttpServerNativeHandler Handler, const FDTHttpServerRouteOptions& Options)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() || !Handler ) { return; }
+
 	// 绑定正常接口
-	FHttpRouteHandle HttpRouteHandle = m_HttpRouter->BindRoute(HttpPath, Verb,
-		[this, HttpResponse](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+	const EDTHttpServerExecution Execution = Options.Execution;
+	const EDTHttpServerPriority Priority = Options.Priority;
+	TSharedRef<const FDTHttpServerNativeHandler, ESPMode::ThreadSafe> SharedHandler = MakeShared<FDTHttpServerNativeHandler, ESPMode::ThreadSafe>(MoveTemp(Handler));
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, HttpVerbs, Options);
+	BindRoute(HttpPath, HttpVerbs, Context,
+		[this, SharedHandler, Execution, Priority, Context](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
 		{
+			// 使用缓存的返回, 不执行回调
+			if ( ServeCachedResponse(Request, OnComplete, *Context) ) { return true; }
+
 			// 创建返回对象
-			TUniquePtr<FHttpServerResponse> Response = CreateHttpServerResponse();
-			
-			// 有效执行
-			FString ResponseInfo;
-			if ( HttpResponse.IsBound())
-			{
-				// 重新生成头
-				FDTHttpServerHeaders DTHttpServerHeaders;
-				for ( const auto & Header : Request.Headers )
+			const uint64 ArrivalCycles = FPlatformTime::Cycles64();
+			const FDTHttpServerPromise Promise = CreatePromise(Request, OnComplete, *Context);
+
+			// 直接执行, 数据直接引用接收缓存
+			if ( Execution == EDTHttpServerExecution::Inline )
+			{
+				FDTHttpServerNativeResponse NativeResponse;
+				{
+					FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+					NativeResponse = (*SharedHandler)(FDTHttpServerNativeRequest(Request, PathParams));
+				}
+				Promise.SetValue(MoveTemp(NativeResponse));
+				return true;
+			}
+
+			// 延迟或跨线程执行需要持有请求拷贝
+			const bool bDispatched = Dispatch(Execution, Priority, [SharedRequest = DTHttpServer::CopyRequest(Request), PathParams, SharedHandler, Promise, Context, ArrivalCycles]()
+			{
+				FDTHttpServerNativeResponse NativeResponse;
+				{
+					FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+					NativeResponse = (*SharedHandler)(FDTHttpServerNativeRequest(SharedRequest, PathParams));
+				}
+				Promise.SetValue(MoveTemp(NativeResponse));
+			});
+			if ( !bDispatched )
+			{
+				Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::ServiceUnavail));
+			}
+
+			return true;
+		});
+}
+
+// 绑定原生异步消息
+void UDTHttpServerObject::BindNativeAsync(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FDTHttpServerNativeAsyncHandler Handler, const FDTHttpServerRouteOptions& Options)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() || !Handler ) { return; }
+
+	// 绑定正常接口
+	const EDTHttpServerExecution Execution = Options.Execution;
+	const EDTHttpServerPriority Priority = Options.Priority;
+	TSharedRef<const FDTHttpServerNativeAsyncHandler, ESPMode::ThreadSafe> SharedHandler = MakeShared<FDTHttpServerNativeAsyncHandler, ESPMode::ThreadSafe>(MoveTemp(Handler));
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, HttpVerbs, Options);
+	BindRoute(HttpPath, HttpVerbs, Context,
+		[this, SharedHandler, Execution, Priority, Context](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
+		{
+			// 使用缓存的返回, 不执行回调
+			if ( ServeCachedResponse(Request, OnComplete, *Context) ) { return true; }
+
+			// 请求可能在回调返回后才处理, 始终持有拷贝
+			const uint64 ArrivalCycles = FPlatformTime::Cycles64();
+			const FDTHttpServerPromise Promise = CreatePromise(Request, OnComplete, *Context);
+			const FDTHttpServerNativeRequestRef NativeRequest = MakeShared<FDTHttpServerNativeRequest, ESPMode::ThreadSafe>(DTHttpServer::CopyRequest(Request), PathParams);
+
+			// 异步回调只统计到回调返回
+			const bool bDispatched = Dispatch(Execution, Priority, [NativeRequest, SharedHandler, Promise, Context, ArrivalCycles]()
+			{
+				FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+				(*SharedHandler)(NativeRequest, Promise);
+			});
+			if ( !bDispatched )
+			{
+				Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::ServiceUnavail));
+			}
+
+			return true;
+		});
+}
+
+// 绑定结构体消息
+void UDTHttpServerObject::BindStruct(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const UScriptStruct* RequestType, const UScriptStruct* ResponseType, FDTHttpServerStructHandler Handler, const FDTHttpServerRouteOptions& Options)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() || !Handler || RequestType == nullptr || ResponseType == nullptr ) { return; }
+
+	BindNative(HttpPath, HttpVerbs, [RequestType, ResponseType, Handler = MoveTemp(Handler)](const FDTHttpServerNativeRequest& Request)
+	{
+		// 直接从接收缓存解析, 没有数据时使用默认值
+		FStructOnScope RequestData(RequestType);
+		FString Error;
+		if ( Request.GetBody().Num() > 0 && !FDTHttpServerJson::ReadStruct(Request.GetBody(), RequestType, RequestData.GetStructMemory(), &Error) )
+		{
+			return DTHttpServer::MakeErrorResponse(EHttpServerResponseCodes::BadRequest, Error);
+		}
+
+		// 返回数据直接写到返回缓存
+		FDTHttpServerNativeResponse NativeResponse;
+		NativeResponse.ContentType = TEXT("application/json;charset=utf-8");
+		FStructOnScope ResponseData(ResponseType);
+		NativeResponse.Code = Handler(Request, RequestData.GetStructMemory(), ResponseData.GetStructMemory());
+		FDTHttpServerJson::WriteStruct(ResponseType, ResponseData.GetStructMemory(), NativeResponse.Body);
+		return NativeResponse;
+	}, Options);
+}
+
+// 绑定上传路由
+void UDTHttpServerObject::BindUploadRoute(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FDTHttpServerUploadChunkHandler&& ChunkHandler, TFunction<void(const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe>&, const FDTHttpServerPathParams&, FDTHttpServerUploadResult&&, const FDTHttpServerPromise&)>&& OnUploaded)
+{
+	// 相对路径从 Saved 目录开始
+	const FString Directory = FPaths::IsRelative(Options.Directory) ? FPaths::Combine(FPaths::ProjectSavedDir(), Options.Directory) : Options.Directory;
+	const int64 MaxBytes = int64(FMath::Max(Options.MaxMegabytes, 1)) * 1024 * 1024;
+
+	// 上传数据已经写入文件, 不压缩返回
+	FDTHttpServerRouteOptions RouteOptions;
+	RouteOptions.bCompressResponse = false;
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, EDTHttpServerVerbs::POST, RouteOptions);
+	BindRoute(HttpPath, EDTHttpServerVerbs::POST, Context,
+		[this, Options, Directory, MaxBytes, ChunkHandler = MoveTemp(ChunkHandler), OnUploaded = MoveTemp(OnUploaded), Context](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
+		{
+			const uint64 ArrivalCycles = FPlatformTime::Cycles64();
+			const FDTHttpServerPromise Promise = CreatePromise(Request, OnComplete, *Context);
+			if ( Request.Body.Num() > MaxBytes )
+			{
+				Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::RequestTooLarge));
+				return true;
+			}
+
+			Dispatch(EDTHttpServerExecution::ThreadPool, EDTHttpServerPriority::Normal, [OwnedRequest = DTHttpServer::TakeRequest(Request), PathParams, Promise, Options, Directory, ChunkHandler, OnUploaded, Context, ArrivalCycles]()
+			{
+				FDTHttpServerUploadResult Upload;
+				EHttpServerResponseCodes ErrorCode = EHttpServerResponseCodes::BadRequest;
+				FString Error;
+				bool bSucceeded;
 				{
-					DTHttpServerHeaders.Headers.Add(Header.Key, FString::Join(Header.Value, TEXT(",")));
+					FDTHttpServerHandlerScope HandlerScope(Context->Metrics, ArrivalCycles);
+					FDTHttpServerUpload Uploader(Options, Directory, ChunkHandler);
+					bSucceeded = Uploader.Process(*OwnedRequest, Upload, ErrorCode, Error);
 				}
 
-				// 重新生成参数
-				FDTHttpServerParams DTHttpServerParams;
-				DTHttpServerParams.Params = Request.QueryParams;
+				// 数据已经写完, 尽早释放接收缓存
+				OwnedRequest->Body.Empty();
+				if ( !bSucceeded )
+				{
+					Promise.SetValue(DTHttpServer::MakeErrorResponse(ErrorCode, Error));
+					return;
+				}
+				OnUploaded(OwnedRequest, PathParams, MoveTemp(Upload), Promise);
+			});
+			return true;
+		});
+}
 
-				// 获取数据
-				FString Body;
-				if ( Request.Body.Num() > 0 )
+// 绑定上传
+void UDTHttpServerObject::BindUpload(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FHttpUploadResponse HttpResponse)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() ) { return; }
+
+	// 写完文件后排队回到游戏线程执行蓝图
+	const TSharedRef<FDTHttpServerRequestQueue, ESPMode::ThreadSafe> RequestQueue = m_RequestQueue.ToSharedRef();
+	BindUploadRoute(HttpPath, Options, nullptr,
+		[HttpResponse, RequestQueue](const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe>& Request, const FDTHttpServerPathParams& PathParams, FDTHttpServerUploadResult&& Upload, const FDTHttpServerPromise& Promise)
+		{
+			const bool bQueued = RequestQueue->Enqueue(EDTHttpServerPriority::Normal, [Request, PathParams, Upload = MoveTemp(Upload), Promise, HttpResponse]()
+			{
+				DTHttpServer::FBlueprintArgs Args;
+				DTHttpServer::MakeBlueprintArgs(Request, PathParams, Args);
+				FString ResponseInfo;
+				if ( HttpResponse.IsBound() )
 				{
-					const std::string szBody((char*)Request.Body.GetData(), Request.Body.Num());
-					Body = UTF8_TO_TCHAR(szBody.c_str());
+					ResponseInfo = HttpResponse.Execute(Args.RelativePath, Args.Headers, Args.Params, Upload);
 				}
+				Args.View->Reset();
+				Promise.SetValue(DTHttpServer::EncodeBlueprintResponse(ResponseInfo));
+			});
+			if ( !bQueued )
+			{
+				Promise.SetValue(DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::ServiceUnavail));
+			}
+		});
+}
+
+// 绑定原生上传
+void UDTHttpServerObject::BindUploadNative(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FDTHttpServerUploadHandler Handler, FDTHttpServerUploadChunkHandler ChunkHandler)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() || !Handler ) { return; }
+
+	BindUploadRoute(HttpPath, Options, MoveTemp(ChunkHandler),
+		[Handler = MoveTemp(Handler)](const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe>& Request, const FDTHttpServerPathParams& PathParams, FDTHttpServerUploadResult&& Upload, const FDTHttpServerPromise& Promise)
+		{
+			Promise.SetValue(Handler(FDTHttpServerNativeRequest(Request, PathParams), Upload));
+		});
+}
+
+// 设置请求合并键
+void UDTHttpServerObject::SetCoalesceKeyFunction(const FString& HttpPath, FDTHttpServerCoalesceKeyFunction KeyFunction)
+{
+	if ( !m_Router.IsValid() ) { return; }
+
+	FDTHttpServerPathParams PathParams;
+	const FDTHttpServerRoute * Route = m_Router->Match(HttpPath, EHttpServerRequestVerbs::VERB_GET, PathParams);
+	if ( Route == nullptr || !Route->Context->Coalescer.IsValid() )
+	{
+		UE_LOG(LogDTHttpServer, Warning, TEXT("Set coalesce key failed, no GET route with Coalesce Requests : %s"), *HttpPath);
+		return;
+	}
+	Route->Context->Coalescer->SetKeyFunction(MoveTemp(KeyFunction));
+}
+
+// 绑定静态文件目录
+void UDTHttpServerObject::BindStaticDirectory(const FString& UrlPrefix, const FString& DiskPath)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() ) { return; }
+
+	// 相对路径从项目目录开始
+	const FString FullDiskPath = FPaths::IsRelative(DiskPath) ? FPaths::Combine(FPaths::ProjectDir(), DiskPath) : DiskPath;
+	TSharedRef<FDTHttpServerStaticDirectory, ESPMode::ThreadSafe> StaticDirectory = MakeShared<FDTHttpServerStaticDirectory, ESPMode::ThreadSafe>(FullDiskPath, int64(FMath::Max(StaticFileCacheMegabytes, 0)) * 1024 * 1024, int64(FMath::Max(StaticFileMaxResponseMegabytes, 1)) * 1024 * 1024);
+
+	m_StaticDirectories.Add(StaticDirectory);
+
+	// 前缀下的所有路径
+	FString HttpPath = UrlPrefix;
+	if ( !HttpPath.StartsWith(TEXT("/")) )
+	{
+		HttpPath.InsertAt(0, TEXT('/'));
+	}
+	HttpPath.RemoveFromEnd(TEXT("/"));
+	HttpPath.Append(TEXT("/*path"));
+
+	// 在线程池中读取文件, 返回类型由文件决定
+	FDTHttpServerRouteOptions Options;
+	Options.Execution = EDTHttpServerExecution::ThreadPool;
+	BindNative(HttpPath, EDTHttpServerVerbs::GET, [StaticDirectory](const FDTHttpServerNativeRequest& Request)
+	{
+		return StaticDirectory->Serve(Request);
+	}, Options);
+}
+
+// 绑定事件流
+void UDTHttpServerObject::BindEventStream(const FString& HttpPath, int32 ReplayCapacity, int32 RetryMilliseconds)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() || m_EventStreams.Contains(HttpPath) ) { return; }
+
+	TSharedRef<FDTHttpServerEventStream, ESPMode::ThreadSafe> EventStream = MakeShared<FDTHttpServerEventStream, ESPMode::ThreadSafe>(ReplayCapacity, RetryMilliseconds);
+	m_EventStreams.Add(HttpPath, EventStream);
 
-				// 执行回调函数
-				ResponseInfo = HttpResponse.Execute(
-					Request.RelativePath.GetPath(),
-					DTHttpServerHeaders,
-					DTHttpServerParams,
-					Body);
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, EDTHttpServerVerbs::GET, FDTHttpServerRouteOptions(), false);
+	BindRoute(HttpPath, EDTHttpServerVerbs::GET, Context,
+		[this, EventStream, Context](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
+		{
+			// 重连时从上一次收到的事件继续, 不支持自定义头的客户端使用查询参数
+			uint64 LastEventId = 0;
+			const TArray<FString> * LastEventIds = Request.Headers.Find(TEXT("Last-Event-ID"));
+			if ( LastEventIds != nullptr && LastEventIds->Num() > 0 )
+			{
+				LastEventId = FCString::Strtoui64(*(*LastEventIds)[0], nullptr, 10);
+			}
+			else if ( const FString * LastEventIdParam = Request.QueryParams.Find(TEXT("lastEventId")) )
+			{
+				LastEventId = FCString::Strtoui64(**LastEventIdParam, nullptr, 10);
 			}
 
-			// 赋值返回数据
-			if ( !ResponseInfo.IsEmpty() )
+			EventStream->Subscribe(CreatePromise(Request, OnComplete, *Context), LastEventId, FMath::Max(EventStreamHoldSeconds, 0.0f));
+			return true;
+		});
+}
+
+// 发布事件
+void UDTHttpServerObject::PublishEvent(const FString& HttpPath, const FString& EventName, const FString& Data)
+{
+	if ( const TSharedPtr<FDTHttpServerEventStream, ESPMode::ThreadSafe> * EventStream = m_EventStreams.Find(HttpPath) )
+	{
+		(*EventStream)->Publish(EventName, Data);
+	}
+}
+
+// 绑定批量请求
+void UDTHttpServerObject::BindBatch(const FString& HttpPath, int32 MaxSubRequests)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() ) { return; }
+
+	const FDTHttpServerRouteContextRef Context = MakeRouteContext(HttpPath, EDTHttpServerVerbs::POST, FDTHttpServerRouteOptions(), false);
+	BindRoute(HttpPath, EDTHttpServerVerbs::POST, Context,
+		[this, Context, MaxSubRequests](const FHttpServerRequest& Request, const FDTHttpServerPathParams& PathParams, const FHttpResultCallback& OnComplete)
+		{
+			const FDTHttpServerPromise Promise = CreatePromise(Request, OnComplete, *Context);
+
+			// 超过数量时解析立即停止
+			TArray<FDTHttpServerBatchRequest> SubRequests;
+			FString Error;
+			bool bTooManyElements = false;
+			if ( !FDTHttpServerJson::ReadStructArray(Request.Body, SubRequests, MaxSubRequests, bTooManyElements, &Error) )
 			{
-				std::string szInfo;
-				szInfo = TCHAR_TO_UTF8(*ResponseInfo);
-				Response->Body.Append((const uint8*)szInfo.c_str(), szInfo.length());
+				Promise.SetValue(bTooManyElements
+					? DTHttpServer::MakeStatusResponse(EHttpServerResponseCodes::RequestTooLarge)
+					: DTHttpServer::MakeErrorResponse(EHttpServerResponseCodes::BadRequest, Error));
+				return true;
+			}
+			if ( SubRequests.Num() == 0 )
+			{
+				Promise.SetValue(DTHttpServer::EncodeBlueprintResponse(TEXT("[]")));
+				return true;
 			}
 
-			// 返回网页
-			OnComplete(MoveTemp(Response));
-			
+			// 全部子请求同时开始, 最后一个完成时合并返回
+			const TSharedRef<FDTHttpServerBatch, ESPMode::ThreadSafe> Batch = MakeShared<FDTHttpServerBatch, ESPMode::ThreadSafe>(SubRequests.Num(), Promise);
+			for ( int32 Index = 0; Index < SubRequests.Num(); ++Index )
+			{
+				RunSubRequest(Request, SubRequests[Index], Batch->MakeCallback(Index));
+			}
 			return true;
 		});
+}
+
+// 绑定统计接口
+void UDTHttpServerObject::BindMetrics(const FString& HttpPath)
+{
+	// 无效路由
+	if ( !m_HttpRouter.IsValid() ) { return; }
+
+	BindNative(HttpPath, EDTHttpServerVerbs::GET, [this](const FDTHttpServerNativeRequest& Request)
+	{
+		const FString Text = m_Metrics->Scrape(m_RequestQueue->Num());
+		const FTCHARToUTF8 TextConverter(*Text, Text.Len());
 
-	// 添加缓存
-	m_HttpRouteHandles.Add(HttpRouteOptions);
-	m_HttpRouteHandles.Add(HttpRouteHandle);
+		FDTHttpServerNativeResponse NativeResponse;
+		NativeResponse.ContentType = TEXT("text/plain; version=0.0.4; charset=utf-8");
+		NativeResponse.Body.Append((const uint8*)TextConverter.Get(), TextConverter.Length());
+		return NativeResponse;
+	});
 }
@@ -0,0 +1,72 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerQueue.h"
+
+// 入队
+bool FDTHttpServerRequestQueue::Enqueue(EDTHttpServerPriority Priority, TUniqueFunction<void()>&& Task)
+{
+	// 先占位, 超出深度时退回
+	if ( m_Depth.fetch_add(1) >= m_MaxDepth.load() )
+	{
+		m_Depth.fetch_sub(1);
+		m_Rejected.fetch_add(1);
+		return false;
+	}
+
+	FItem Item;
+	Item.Task = MoveTemp(Task);
+	Item.EnqueueTime = FPlatformTime::Seconds();
+	m_Queues[FMath::Min((int32)Priority, 2)].Enqueue(MoveTemp(Item));
+	return true;
+}
+
+// 出队
+bool FDTHttpServerRequestQueue::Dequeue(FItem& Item)
+{
+	for ( auto & Queue : m_Queues )
+	{
+		if ( Queue.Dequeue(Item) )
+		{
+			m_Depth.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 按预算执行
+void FDTHttpServerRequestQueue::Drain(double BudgetSeconds, FDTHttpServerQueueStats& Stats)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	double Now = StartTime;
+	double MaxWait = 0.0;
+	int32 Processed = 0;
+
+	while ( true )
+	{
+		// 每个任务执行后立即释放其持有的请求
+		FItem Item;
+		if ( !Dequeue(Item) ) { break; }
+
+		MaxWait = FMath::Max(MaxWait, Now - Item.EnqueueTime);
+		Item.Task();
+		++Processed;
+
+		// 超出预算留到下一帧
+		Now = FPlatformTime::Seconds();
+		if ( Now - StartTime >= BudgetSeconds ) { break; }
+	}
+
+	// 更新统计
+	const int32 Depth = m_Depth.load();
+	Stats.QueueDepth = Depth;
+	Stats.PeakQueueDepth = FMath::Max(Stats.PeakQueueDepth, Depth + Processed);
+	Stats.ProcessedLastFrame = Processed;
+	Stats.CarriedOver = Depth;
+	Stats.LastFrameMicroseconds = (float)((Now - StartTime) * 1000000.0);
+	Stats.BudgetUsage = BudgetSeconds > 0.0 ? (float)((Now - StartTime) / BudgetSeconds) : 0.f;
+	Stats.MaxWaitMicroseconds = (float)(MaxWait * 1000000.0);
+	Stats.TotalProcessed += Processed;
+	Stats.TotalRejected = m_Rejected.load();
+}
@@ -0,0 +1,42 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "DTHttpServerStruct.h"
+#include <atomic>
+
+// 游戏线程请求队列, 任意线程入队, 游戏线程按帧预算出队
+class FDTHttpServerRequestQueue
+{
+public:
+	// 入队, 超过最大深度时返回 false, 调用者负责返回 503
+	bool Enqueue(EDTHttpServerPriority Priority, TUniqueFunction<void()> && Task);
+
+	// 在预算内按优先级执行任务, 至少执行一个, 剩余的留到下一帧
+	void Drain(double BudgetSeconds, FDTHttpServerQueueStats & Stats);
+
+	// 设置最大深度
+	void SetMaxDepth(int32 MaxDepth) { m_MaxDepth.store(FMath::Max(MaxDepth, 1)); }
+
+	// 当前深度
+	int32 Num() const { return m_Depth.load(); }
+
+private:
+	struct FItem
+	{
+		TUniqueFunction<void()>		Task;
+		double						EnqueueTime = 0.0;
+	};
+
+	// 出队优先级最高的任务
+	bool Dequeue(FItem & Item);
+
+private:
+	TQueue<FItem, EQueueMode::Mpsc>		m_Queues[3];
+	std::atomic<int32>					m_Depth { 0 };
+	std::atomic<int32>					m_MaxDepth { 256 };
+	std::atomic<int64>					m_Rejected { 0 };
+};
@@ -0,0 +1,70 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerRateLimiter.h"
+#include "HttpServerRequest.h"
+#include "IPAddress.h"
+#include "Hash/CityHash.h"
+
+FDTHttpServerRateLimiter::FDTHttpServerRateLimiter(int32 InNumSlots)
+	: m_StartTime(FPlatformTime::Seconds())
+{
+	const uint32 NumSlots = FMath::RoundUpToPowerOfTwo(FMath::Max(InNumSlots, NumProbes));
+	m_Slots.SetNum(NumSlots);
+	m_Mask = NumSlots - 1;
+}
+
+// 客户端地址的键
+uint64 FDTHttpServerRateLimiter::MakePeerKey(const FHttpServerRequest& Request)
+{
+	if ( !Request.PeerAddress.IsValid() ) { return 1; }
+
+	const TArray<uint8> RawIp = Request.PeerAddress->GetRawIp();
+	return CityHash64((const char*)RawIp.GetData(), RawIp.Num()) | 1;
+}
+
+// 客户端在某个路由上的键
+uint64 FDTHttpServerRateLimiter::MakeRouteKey(uint64 PeerKey, const void* Route)
+{
+	return CityHash128to64(Uint128_64(PeerKey, (uint64)(UPTRINT)Route)) | 1;
+}
+
+// 取一个令牌
+bool FDTHttpServerRateLimiter::TryAcquire(uint64 Key, const FDTHttpServerRateLimit& Limit)
+{
+	if ( !Limit.bEnabled ) { return true; }
+
+	const uint32 NowMilliseconds = (uint32)((FPlatformTime::Seconds() - m_StartTime) * 1000.0);
+	const float Burst = (float)FMath::Max(Limit.Burst, 1);
+
+	// 探测范围内查找, 同时记录最久没有请求的桶
+	FSlot * Target = nullptr;
+	uint32 OldestAge = 0;
+	for ( uint32 Probe = 0; Probe < NumProbes; ++Probe )
+	{
+		FSlot & Slot = m_Slots[(uint32(Key) + Probe) & m_Mask];
+		if ( Slot.Key == Key )
+		{
+			// 补充令牌, 无符号相减可以处理计时回绕
+			const float Elapsed = (NowMilliseconds - Slot.LastMilliseconds) / 1000.0f;
+			Slot.Tokens = FMath::Min(Burst, Slot.Tokens + Elapsed * FMath::Max(Limit.RequestsPerSecond, 0.0f));
+			Slot.LastMilliseconds = NowMilliseconds;
+			if ( Slot.Tokens < 1.0f ) { return false; }
+			Slot.Tokens -= 1.0f;
+			return true;
+		}
+
+		const uint32 Age = Slot.Key == 0 ? MAX_uint32 : NowMilliseconds - Slot.LastMilliseconds;
+		if ( Target == nullptr || Age > OldestAge )
+		{
+			Target = &Slot;
+			OldestAge = Age;
+		}
+	}
+
+	// 新的客户端使用满的桶
+	Target->Key = Key;
+	Target->LastMilliseconds = NowMilliseconds;
+	Target->Tokens = Burst - 1.0f;
+	return true;
+}
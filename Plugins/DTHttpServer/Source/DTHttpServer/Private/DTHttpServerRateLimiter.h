@@ -0,0 +1,40 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerStruct.h"
+
+// 令牌桶限流, 所有客户端共用一张固定大小的表, 不随流量增长
+// 按键的哈希开放寻址, 探测范围内没有空位时替换最久没有请求的桶, 只在游戏线程使用
+class FDTHttpServerRateLimiter
+{
+public:
+	// 表大小向上取 2 的幂
+	explicit FDTHttpServerRateLimiter(int32 InNumSlots);
+
+	// 取一个令牌, 没有令牌时返回 false
+	bool TryAcquire(uint64 Key, const FDTHttpServerRateLimit & Limit);
+
+	// 客户端地址的键, 不包含端口
+	static uint64 MakePeerKey(const FHttpServerRequest & Request);
+
+	// 客户端在某个路由上的键
+	static uint64 MakeRouteKey(uint64 PeerKey, const void * Route);
+
+private:
+	static constexpr int32 NumProbes = 4;
+
+	struct FSlot
+	{
+		uint64		Key = 0;
+		uint32		LastMilliseconds = 0;
+		float		Tokens = 0.0f;
+	};
+
+private:
+	TArray<FSlot>	m_Slots;
+	uint32			m_Mask = 0;
+	double			m_StartTime = 0.0;
+};
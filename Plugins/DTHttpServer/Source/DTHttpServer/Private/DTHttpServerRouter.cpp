@@ -0,0 +1,197 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerRouter.h"
+
+FDTHttpServerRouter::FDTHttpServerRouter()
+{
+	// 根节点
+	AddNode();
+}
+
+int32 FDTHttpServerRouter::AddNode()
+{
+	return m_Nodes.AddDefaulted();
+}
+
+// 编译路径模板
+bool FDTHttpServerRouter::Insert(const FString& Pattern, EHttpServerRequestVerbs Verb, const FDTHttpServerRouteContextRef& Context, FDTHttpServerRouteHandler&& Handler)
+{
+	TArray<FString> ParamNames;
+	int32 NodeIndex = 0;
+
+	// 逐段插入
+	int32 Position = 0;
+	const int32 Length = Pattern.Len();
+	while ( Position < Length )
+	{
+		// 跳过分隔符
+		if ( Pattern[Position] == TEXT('/') ) { ++Position; continue; }
+
+		int32 End = Position;
+		while ( End < Length && Pattern[End] != TEXT('/') ) { ++End; }
+		const FStringView Segment = FStringView(Pattern).Mid(Position, End - Position);
+
+		if ( Segment[0] == TEXT(':') )
+		{
+			// 参数段
+			if ( m_Nodes[NodeIndex].ParamChild == INDEX_NONE )
+			{
+				const int32 ChildIndex = AddNode();
+				m_Nodes[NodeIndex].ParamChild = ChildIndex;
+			}
+			ParamNames.Emplace(Segment.Mid(1));
+			NodeIndex = m_Nodes[NodeIndex].ParamChild;
+		}
+		else if ( Segment[0] == TEXT('*') )
+		{
+			// 通配段只能在末尾
+			if ( End < Length ) { return false; }
+			if ( m_Nodes[NodeIndex].WildcardChild == INDEX_NONE )
+			{
+				const int32 ChildIndex = AddNode();
+				m_Nodes[NodeIndex].WildcardChild = ChildIndex;
+			}
+			ParamNames.Emplace(Segment.Len() > 1 ? Segment.Mid(1) : Segment);
+			NodeIndex = m_Nodes[NodeIndex].WildcardChild;
+		}
+		else
+		{
+			// 字面量段
+			if ( const int32 * ChildIndex = m_Nodes[NodeIndex].Literals.FindByHash(HashSegment(Segment), Segment) )
+			{
+				NodeIndex = *ChildIndex;
+			}
+			else
+			{
+				const int32 NewIndex = AddNode();
+				m_Nodes[NodeIndex].Literals.Add(FString(Segment), NewIndex);
+				NodeIndex = NewIndex;
+			}
+		}
+
+		Position = End;
+	}
+
+	// 重复绑定
+	for ( const auto & Route : m_Nodes[NodeIndex].Routes )
+	{
+		if ( Route->Verb == Verb ) { return false; }
+	}
+
+	TSharedRef<FDTHttpServerRoute, ESPMode::ThreadSafe> Route = MakeShared<FDTHttpServerRoute, ESPMode::ThreadSafe>();
+	Route->Pattern = Pattern;
+	Route->Verb = Verb;
+	Route->ParamNames = MakeShared<TArray<FString>, ESPMode::ThreadSafe>(MoveTemp(ParamNames));
+	Route->Context = Context;
+	Route->Handler = MoveTemp(Handler);
+	m_Nodes[NodeIndex].Routes.Add(Route);
+	return true;
+}
+
+// 查找节点上的路由
+const FDTHttpServerRoute* FDTHttpServerRouter::FindRoute(const FNode& Node, EHttpServerRequestVerbs Verb) const
+{
+	for ( const auto & Route : Node.Routes )
+	{
+		if ( Route->Verb == Verb || Verb == EHttpServerRequestVerbs::VERB_OPTIONS )
+		{
+			return &Route.Get();
+		}
+	}
+	return nullptr;
+}
+
+// 递归匹配
+const FDTHttpServerRoute* FDTHttpServerRouter::MatchNode(int32 NodeIndex, int32 Position, FMatchState& State) const
+{
+	const FNode & Node = m_Nodes[NodeIndex];
+	const FString & Path = State.Path;
+	const int32 Length = Path.Len();
+
+	// 跳过分隔符
+	const int32 SegmentSlash = Position;
+	while ( Position < Length && Path[Position] == TEXT('/') ) { ++Position; }
+
+	// 路径结束
+	if ( Position >= Length )
+	{
+		if ( const FDTHttpServerRoute * Route = FindRoute(Node, State.Verb) )
+		{
+			return Route;
+		}
+
+		// 空通配
+		if ( Node.WildcardChild != INDEX_NONE )
+		{
+			if ( const FDTHttpServerRoute * Route = FindRoute(m_Nodes[Node.WildcardChild], State.Verb) )
+			{
+				State.Captures.Emplace(Length, 0);
+				return Route;
+			}
+		}
+		return nullptr;
+	}
+
+	int32 End = Position;
+	while ( End < Length && Path[End] != TEXT('/') ) { ++End; }
+	const FStringView Segment = FStringView(Path).Mid(Position, End - Position);
+
+	// 字面量
+	if ( const int32 * ChildIndex = Node.Literals.FindByHash(HashSegment(Segment), Segment) )
+	{
+		if ( const FDTHttpServerRoute * Route = MatchNode(*ChildIndex, End, State) )
+		{
+			return Route;
+		}
+	}
+
+	// 参数
+	if ( Node.ParamChild != INDEX_NONE )
+	{
+		State.Captures.Emplace(Position, End - Position);
+		if ( const FDTHttpServerRoute * Route = MatchNode(Node.ParamChild, End, State) )
+		{
+			return Route;
+		}
+		State.Captures.Pop(false);
+	}
+
+	// 通配剩余路径
+	if ( Node.WildcardChild != INDEX_NONE )
+	{
+		if ( const FDTHttpServerRoute * Route = FindRoute(m_Nodes[Node.WildcardChild], State.Verb) )
+		{
+			State.Captures.Emplace(Position, Length - Position);
+			State.Remainder = TPair<int32, int32>(SegmentSlash, Length - SegmentSlash);
+			return Route;
+		}
+	}
+
+	// 前缀匹配, 剩余部分作为相对路径
+	if ( const FDTHttpServerRoute * Route = FindRoute(Node, State.Verb) )
+	{
+		State.Remainder = TPair<int32, int32>(SegmentSlash, Length - SegmentSlash);
+		return Route;
+	}
+
+	return nullptr;
+}
+
+// 匹配路由
+const FDTHttpServerRoute* FDTHttpServerRouter::Match(const FString& Path, EHttpServerRequestVerbs Verb, FDTHttpServerPathParams& PathParams) const
+{
+	FMatchState State { Path, Verb };
+	const FDTHttpServerRoute * Route = MatchNode(0, 0, State);
+	if ( Route == nullptr ) { return nullptr; }
+
+	// 只有存在参数或剩余路径时才保存路径
+	PathParams.Names = Route->ParamNames;
+	PathParams.Ranges = State.Captures;
+	PathParams.Remainder = State.Remainder;
+	if ( State.Captures.Num() > 0 || State.Remainder.Value > 0 )
+	{
+		PathParams.Path = Path;
+	}
+	return Route;
+}
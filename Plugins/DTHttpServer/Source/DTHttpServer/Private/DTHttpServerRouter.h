@@ -0,0 +1,93 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpServerRequest.h"
+#include "HttpResultCallback.h"
+#include "DTHttpServerHeaders.h"
+#include "DTHttpServerNative.h"
+#include "DTHttpServerMetrics.h"
+#include "DTHttpServerCoalescer.h"
+
+// 路由运行时数据, 绑定时创建, 所有请求共享
+struct FDTHttpServerRouteContext
+{
+	FDTHttpServerRouteOptions			Options;
+	// 路由单独设置的返回头, 为空时使用服务器的返回头
+	FDTHttpServerHeaderSetPtr			HeaderSet;
+	FDTHttpServerRouteMetricsPtr		Metrics;
+	// 合并相同请求, 没有开启时为空
+	FDTHttpServerCoalescerPtr			Coalescer;
+	// 可以作为批量请求的子请求, 事件流和批量请求不可以
+	bool								bSubRequest = true;
+};
+
+typedef TSharedRef<const FDTHttpServerRouteContext, ESPMode::ThreadSafe> FDTHttpServerRouteContextRef;
+
+// 编译后的路由
+struct FDTHttpServerRoute
+{
+	FString													Pattern;
+	EHttpServerRequestVerbs									Verb = EHttpServerRequestVerbs::VERB_NONE;
+	TSharedRef<const TArray<FString>, ESPMode::ThreadSafe>	ParamNames = MakeShared<TArray<FString>, ESPMode::ThreadSafe>();
+	TSharedPtr<const FDTHttpServerRouteContext, ESPMode::ThreadSafe>	Context;
+	FDTHttpServerRouteHandler								Handler;
+};
+
+// 路径模板路由树, 按路径段逐级匹配, 匹配耗时只与路径长度有关
+// 支持字面量段, :name 参数段, 以及只能放在末尾的 * 或 *name 通配段
+// 与引擎路由一样, 没有完全匹配时使用最长的前缀路由, 剩余部分作为相对路径
+class FDTHttpServerRouter
+{
+public:
+	FDTHttpServerRouter();
+
+	// 编译路径模板并插入, 同一模板同一方法重复绑定时返回 false
+	bool Insert(const FString & Pattern, EHttpServerRequestVerbs Verb, const FDTHttpServerRouteContextRef & Context, FDTHttpServerRouteHandler && Handler);
+
+	// 匹配路由, OPTIONS 匹配任意方法的路由, 用于跨域预检
+	const FDTHttpServerRoute * Match(const FString & Path, EHttpServerRequestVerbs Verb, FDTHttpServerPathParams & PathParams) const;
+
+private:
+	// 路径段哈希, 区分大小写
+	static uint32 HashSegment(FStringView Segment) { return FCrc::MemCrc32(Segment.GetData(), Segment.Len() * sizeof(TCHAR)); }
+
+	// 可以直接用路径视图查找的字面量子节点
+	struct FSegmentKeyFuncs : TDefaultMapKeyFuncs<FString, int32, false>
+	{
+		static FORCEINLINE bool Matches(const FString & A, const FString & B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+		static FORCEINLINE bool Matches(const FString & A, FStringView B) { return FStringView(A).Equals(B, ESearchCase::CaseSensitive); }
+		static FORCEINLINE uint32 GetKeyHash(const FString & Key) { return HashSegment(Key); }
+		static FORCEINLINE uint32 GetKeyHash(FStringView Key) { return HashSegment(Key); }
+	};
+
+	struct FNode
+	{
+		TMap<FString, int32, FDefaultSetAllocator, FSegmentKeyFuncs>			Literals;
+		int32																	ParamChild = INDEX_NONE;
+		int32																	WildcardChild = INDEX_NONE;
+		TArray<TSharedRef<FDTHttpServerRoute, ESPMode::ThreadSafe>, TInlineAllocator<2>>	Routes;
+	};
+
+	struct FMatchState
+	{
+		const FString &								Path;
+		EHttpServerRequestVerbs						Verb;
+		FDTHttpServerPathParams::FRanges			Captures;
+		TPair<int32, int32>							Remainder { 0, 0 };
+	};
+
+	// 查找节点上对应方法的路由
+	const FDTHttpServerRoute * FindRoute(const FNode & Node, EHttpServerRequestVerbs Verb) const;
+
+	// 递归匹配, 优先字面量, 其次参数, 最后通配
+	const FDTHttpServerRoute * MatchNode(int32 NodeIndex, int32 Position, FMatchState & State) const;
+
+	// 新建节点
+	int32 AddNode();
+
+private:
+	TArray<FNode>		m_Nodes;
+};
@@ -0,0 +1,365 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerStatic.h"
+#include "DTHttpServer.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/Parse.h"
+#include "Misc/ScopeLock.h"
+
+namespace DTHttpServer
+{
+	// 解码 URL 中的 %XX
+	static FString DecodeUrlPath(FStringView Path)
+	{
+		TArray<ANSICHAR, TInlineAllocator<256>> Bytes;
+		for ( int32 Index = 0; Index < Path.Len(); ++Index )
+		{
+			const TCHAR Char = Path[Index];
+			if ( Char == TEXT('%') && Index + 2 < Path.Len() && FChar::IsHexDigit(Path[Index + 1]) && FChar::IsHexDigit(Path[Index + 2]) )
+			{
+				Bytes.Add((ANSICHAR)((FParse::HexDigit(Path[Index + 1]) << 4) | FParse::HexDigit(Path[Index + 2])));
+				Index += 2;
+			}
+			else if ( Char < 0x80 )
+			{
+				Bytes.Add((ANSICHAR)Char);
+			}
+			else
+			{
+				// 已经是宽字符, 转回 UTF-8
+				const FTCHARToUTF8 CharConverter(&Path[Index], 1);
+				Bytes.Append(CharConverter.Get(), CharConverter.Length());
+			}
+		}
+		const FUTF8ToTCHAR PathConverter(Bytes.GetData(), Bytes.Num());
+		return FString(PathConverter.Length(), PathConverter.Get());
+	}
+
+	// 解析单个 Range, 不支持多段, 多段时返回整个文件
+	// 返回 false 表示范围无效
+	static bool ParseRange(const FString & Range, int64 FileSize, int64 & OutOffset, int64 & OutSize, bool & bOutPartial)
+	{
+		bOutPartial = false;
+		OutOffset = 0;
+		OutSize = FileSize;
+
+		FStringView Value = Range;
+		Value.TrimStartAndEndInline();
+		if ( !Value.StartsWith(TEXT("bytes="), ESearchCase::IgnoreCase) ) { return true; }
+		Value.RightChopInline(6);
+
+		int32 Index = INDEX_NONE;
+		if ( Value.FindChar(TEXT(','), Index) || !Value.FindChar(TEXT('-'), Index) ) { return true; }
+
+		const FString First(Value.Left(Index).TrimStartAndEnd());
+		const FString Last(Value.Mid(Index + 1).TrimStartAndEnd());
+		if ( (!First.IsEmpty() && !First.IsNumeric()) || (!Last.IsEmpty() && !Last.IsNumeric()) ) { return true; }
+
+		if ( First.IsEmpty() )
+		{
+			// 最后 N 个字节
+			const int64 Suffix = FCString::Atoi64(*Last);
+			if ( Last.IsEmpty() || Suffix <= 0 || FileSize <= 0 ) { return false; }
+			OutSize = FMath::Min(Suffix, FileSize);
+			OutOffset = FileSize - OutSize;
+		}
+		else
+		{
+			const int64 Start = FCString::Atoi64(*First);
+			const int64 End = Last.IsEmpty() ? FileSize - 1 : FMath::Min(FCString::Atoi64(*Last), FileSize - 1);
+			if ( Start >= FileSize || End < Start ) { return false; }
+			OutOffset = Start;
+			OutSize = End - Start + 1;
+		}
+		bOutPartial = true;
+		return true;
+	}
+
+	// 第一个头的值
+	static const FString * FindFirstHeader(const FDTHttpServerNativeRequest & Request, const TCHAR * Key)
+	{
+		const TArray<FString> * Values = Request.FindHeader(Key);
+		return Values != nullptr && Values->Num() > 0 ? &(*Values)[0] : nullptr;
+	}
+
+	// 只有状态码和返回头的静态文件返回
+	static FDTHttpServerNativeResponse MakeStaticResponse(EHttpServerResponseCodes Code)
+	{
+		FDTHttpServerNativeResponse NativeResponse;
+		NativeResponse.Code = Code;
+		NativeResponse.bAllowCompression = false;
+		return NativeResponse;
+	}
+}
+
+FDTHttpServerStaticDirectory::FDTHttpServerStaticDirectory(const FString& InDiskPath, int64 InMaxCacheBytes, int64 InMaxResponseBytes)
+	: m_DiskPath(FPaths::ConvertRelativePathToFull(InDiskPath))
+	, m_MaxBytes(FMath::Max<int64>(InMaxCacheBytes, 0))
+	, m_MaxResponseBytes(FMath::Clamp<int64>(InMaxResponseBytes, 0, MAX_int32))
+{
+	FPaths::NormalizeDirectoryName(m_DiskPath);
+}
+
+// 设置缓存容量和返回体上限
+void FDTHttpServerStaticDirectory::SetLimits(int64 InMaxCacheBytes, int64 InMaxResponseBytes)
+{
+	FScopeLock ScopeLock(&m_Lock);
+	m_MaxBytes = FMath::Max<int64>(InMaxCacheBytes, 0);
+	m_MaxResponseBytes = FMath::Clamp<int64>(InMaxResponseBytes, 0, MAX_int32);
+	Trim();
+}
+
+// 按扩展名猜测返回类型
+const TCHAR* FDTHttpServerStaticDirectory::GuessContentType(const FString& Filename, bool& bOutCompressible)
+{
+	struct FContentType
+	{
+		const TCHAR *	Type;
+		bool			bCompressible;
+	};
+	static const TMap<FString, FContentType> ContentTypes =
+	{
+		{ TEXT("html"), { TEXT("text/html;charset=utf-8"), true } },
+		{ TEXT("htm"), { TEXT("text/html;charset=utf-8"), true } },
+		{ TEXT("css"), { TEXT("text/css;charset=utf-8"), true } },
+		{ TEXT("js"), { TEXT("text/javascript;charset=utf-8"), true } },
+		{ TEXT("mjs"), { TEXT("text/javascript;charset=utf-8"), true } },
+		{ TEXT("json"), { TEXT("application/json;charset=utf-8"), true } },
+		{ TEXT("geojson"), { TEXT("application/geo+json"), true } },
+		{ TEXT("czml"), { TEXT("application/json;charset=utf-8"), true } },
+		{ TEXT("gltf"), { TEXT("model/gltf+json"), true } },
+		{ TEXT("xml"), { TEXT("application/xml"), true } },
+		{ TEXT("txt"), { TEXT("text/plain;charset=utf-8"), true } },
+		{ TEXT("csv"), { TEXT("text/csv;charset=utf-8"), true } },
+		{ TEXT("svg"), { TEXT("image/svg+xml"), true } },
+		{ TEXT("wasm"), { TEXT("application/wasm"), true } },
+		{ TEXT("las"), { TEXT("application/vnd.las"), true } },
+		{ TEXT("b3dm"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("i3dm"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("pnts"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("cmpt"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("subtree"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("terrain"), { TEXT("application/vnd.quantized-mesh"), true } },
+		{ TEXT("glb"), { TEXT("model/gltf-binary"), true } },
+		{ TEXT("bin"), { TEXT("application/octet-stream"), true } },
+		{ TEXT("laz"), { TEXT("application/vnd.laszip"), false } },
+		{ TEXT("png"), { TEXT("image/png"), false } },
+		{ TEXT("jpg"), { TEXT("image/jpeg"), false } },
+		{ TEXT("jpeg"), { TEXT("image/jpeg"), false } },
+		{ TEXT("gif"), { TEXT("image/gif"), false } },
+		{ TEXT("webp"), { TEXT("image/webp"), false } },
+		{ TEXT("ktx2"), { TEXT("image/ktx2"), false } },
+		{ TEXT("ico"), { TEXT("image/x-icon"), false } },
+		{ TEXT("zip"), { TEXT("application/zip"), false } },
+		{ TEXT("gz"), { TEXT("application/gzip"), false } },
+		{ TEXT("mp4"), { TEXT("video/mp4"), false } },
+		{ TEXT("pdf"), { TEXT("application/pdf"), false } },
+	};
+
+	if ( const FContentType * ContentType = ContentTypes.Find(FPaths::GetExtension(Filename)) )
+	{
+		bOutCompressible = ContentType->bCompressible;
+		return ContentType->Type;
+	}
+	bOutCompressible = false;
+	return TEXT("application/octet-stream");
+}
+
+// 转换为磁盘路径
+bool FDTHttpServerStaticDirectory::ResolvePath(FStringView RelativePath, FString& OutFilename) const
+{
+	FString DecodedPath = DTHttpServer::DecodeUrlPath(RelativePath);
+	DecodedPath.ReplaceCharInline(TEXT('\\'), TEXT('/'));
+
+	// 不允许返回上级目录
+	TArray<FString> Segments;
+	DecodedPath.ParseIntoArray(Segments, TEXT("/"));
+	for ( const FString & Segment : Segments )
+	{
+		if ( Segment == TEXT("..") || Segment.Contains(TEXT(":")) ) { return false; }
+	}
+
+	OutFilename = m_DiskPath;
+	for ( const FString & Segment : Segments )
+	{
+		if ( Segment == TEXT(".") ) { continue; }
+		OutFilename.AppendChar(TEXT('/'));
+		OutFilename.Append(Segment);
+	}
+	return true;
+}
+
+// 读取文件的一部分
+bool FDTHttpServerStaticDirectory::ReadFileRange(const FString& Filename, int64 Offset, int64 Size, TArray<uint8>& OutData)
+{
+	OutData.Reset();
+	if ( Size <= 0 ) { return true; }
+	if ( Size > MAX_int32 ) { return false; }
+
+	// 返回体总要完整保存在内存中, 直接读入只复制一次
+	IPlatformFile & PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenRead(*Filename, true));
+	if ( !FileHandle.IsValid() || !FileHandle->Seek(Offset) ) { return false; }
+	OutData.SetNumUninitialized((int32)Size);
+	return FileHandle->Read(OutData.GetData(), Size);
+}
+
+// 读取整个文件
+TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> FDTHttpServerStaticDirectory::LoadCachedFile(const FString& Filename, const FFileStatData& StatData)
+{
+	{
+		FScopeLock ScopeLock(&m_Lock);
+		if ( FCachedFile * CachedFile = m_Files.Find(Filename) )
+		{
+			// 文件已修改
+			if ( CachedFile->ModificationTime == StatData.ModificationTime && CachedFile->Data->Num() == StatData.FileSize )
+			{
+				CachedFile->LastUse = ++m_UseCounter;
+				return CachedFile->Data;
+			}
+			m_UsedBytes -= CachedFile->Data->Num();
+			m_Files.Remove(Filename);
+		}
+	}
+
+	// 读取时不加锁
+	TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> Data = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+	if ( !ReadFileRange(Filename, 0, StatData.FileSize, *Data) ) { return nullptr; }
+
+	FScopeLock ScopeLock(&m_Lock);
+	if ( !m_Files.Contains(Filename) )
+	{
+		FCachedFile & CachedFile = m_Files.Add(Filename);
+		CachedFile.Data = Data;
+		CachedFile.ModificationTime = StatData.ModificationTime;
+		CachedFile.LastUse = ++m_UseCounter;
+		m_UsedBytes += Data->Num();
+		Trim();
+	}
+	return Data;
+}
+
+// 淘汰最久没有使用的文件
+void FDTHttpServerStaticDirectory::Trim()
+{
+	while ( m_UsedBytes > m_MaxBytes && m_Files.Num() > 0 )
+	{
+		const TPair<FString, FCachedFile> * Oldest = nullptr;
+		for ( const auto & File : m_Files )
+		{
+			if ( Oldest == nullptr || File.Value.LastUse < Oldest->Value.LastUse ) { Oldest = &File; }
+		}
+		const FString OldestKey = Oldest->Key;
+		m_UsedBytes -= Oldest->Value.Data->Num();
+		m_Files.Remove(OldestKey);
+	}
+}
+
+// 处理请求
+FDTHttpServerNativeResponse FDTHttpServerStaticDirectory::Serve(const FDTHttpServerNativeRequest& Request)
+{
+	FStringView RelativePath;
+	if ( !Request.FindPathParam(TEXT("path"), RelativePath) )
+	{
+		RelativePath = Request.GetRelativePath();
+	}
+
+	FString Filename;
+	if ( !ResolvePath(RelativePath, Filename) )
+	{
+		return DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::NotFound);
+	}
+
+	// 目录使用 index.html
+	IPlatformFile & PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	FFileStatData StatData = PlatformFile.GetStatData(*Filename);
+	if ( StatData.bIsValid && StatData.bIsDirectory )
+	{
+		Filename /= TEXT("index.html");
+		StatData = PlatformFile.GetStatData(*Filename);
+	}
+	if ( !StatData.bIsValid || StatData.bIsDirectory )
+	{
+		return DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::NotFound);
+	}
+
+	// HTTP 时间只精确到秒
+	const FDateTime ModificationTime = FDateTime(StatData.ModificationTime.GetTicks() - StatData.ModificationTime.GetTicks() % ETimespan::TicksPerSecond);
+	const FString LastModified = ModificationTime.ToHttpDate();
+
+	// 文件没有修改
+	FDateTime IfModifiedSince;
+	const FString * IfModifiedSinceHeader = DTHttpServer::FindFirstHeader(Request, TEXT("If-Modified-Since"));
+	if ( IfModifiedSinceHeader != nullptr && FDateTime::ParseHttpDate(*IfModifiedSinceHeader, IfModifiedSince) && ModificationTime <= IfModifiedSince )
+	{
+		FDTHttpServerNativeResponse NativeResponse = DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::NotModified);
+		NativeResponse.Headers.Add(TEXT("Last-Modified"), { LastModified });
+		return NativeResponse;
+	}
+
+	// 范围请求, If-Range 与文件时间不同时返回整个文件
+	int64 Offset = 0;
+	int64 Size = StatData.FileSize;
+	bool bPartial = false;
+	const FString * RangeHeader = DTHttpServer::FindFirstHeader(Request, TEXT("Range"));
+	const FString * IfRangeHeader = DTHttpServer::FindFirstHeader(Request, TEXT("If-Range"));
+	if ( RangeHeader != nullptr && (IfRangeHeader == nullptr || *IfRangeHeader == LastModified) )
+	{
+		if ( !DTHttpServer::ParseRange(*RangeHeader, StatData.FileSize, Offset, Size, bPartial) )
+		{
+			FDTHttpServerNativeResponse NativeResponse = DTHttpServer::MakeStaticResponse(static_cast<EHttpServerResponseCodes>(416));
+			NativeResponse.Headers.Add(TEXT("Content-Range"), { FString::Printf(TEXT("bytes */%lld"), StatData.FileSize) });
+			return NativeResponse;
+		}
+	}
+
+	int64 MaxCachedFileBytes = 0;
+	int64 MaxResponseBytes = 0;
+	{
+		FScopeLock ScopeLock(&m_Lock);
+		MaxCachedFileBytes = m_MaxBytes / 8;
+		MaxResponseBytes = m_MaxResponseBytes;
+	}
+
+	// 返回体过大, 范围请求只返回上限以内的部分, 客户端按 Content-Range 继续请求
+	if ( Size > MaxResponseBytes && bPartial )
+	{
+		Size = MaxResponseBytes;
+	}
+
+	// 整个文件无法一次返回, 原因在服务器的上限, 客户端需要用 Range 分段请求
+	if ( Size > MaxResponseBytes )
+	{
+		UE_LOG(LogDTHttpServer, Warning, TEXT("Static file %s is %lld bytes, above StaticFileMaxResponseMegabytes (%lld bytes), only Range requests can fetch it"), *Filename, StatData.FileSize, MaxResponseBytes);
+		FDTHttpServerNativeResponse NativeResponse = DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::NotSupported);
+		NativeResponse.Headers.Add(TEXT("Accept-Ranges"), { TEXT("bytes") });
+		return NativeResponse;
+	}
+
+	// 读取数据, 小文件整个缓存
+	FDTHttpServerNativeResponse NativeResponse;
+	if ( StatData.FileSize <= MaxCachedFileBytes )
+	{
+		TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Data = LoadCachedFile(Filename, StatData);
+		if ( !Data.IsValid() ) { return DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::ServerError); }
+		NativeResponse.Body.Append(Data->GetData() + Offset, (int32)Size);
+	}
+	else if ( !ReadFileRange(Filename, Offset, Size, NativeResponse.Body) )
+	{
+		return DTHttpServer::MakeStaticResponse(EHttpServerResponseCodes::ServerError);
+	}
+
+	bool bCompressible = false;
+	NativeResponse.ContentType = GuessContentType(Filename, bCompressible);
+	NativeResponse.bAllowCompression = bCompressible && !bPartial;
+	NativeResponse.Headers.Add(TEXT("Last-Modified"), { LastModified });
+	NativeResponse.Headers.Add(TEXT("Accept-Ranges"), { TEXT("bytes") });
+	if ( bPartial )
+	{
+		NativeResponse.Code = EHttpServerResponseCodes::PartialContent;
+		NativeResponse.Headers.Add(TEXT("Content-Range"), { FString::Printf(TEXT("bytes %lld-%lld/%lld"), Offset, Offset + Size - 1, StatData.FileSize) });
+	}
+	return NativeResponse;
+}
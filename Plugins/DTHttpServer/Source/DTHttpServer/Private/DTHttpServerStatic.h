@@ -0,0 +1,54 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerNative.h"
+
+// 静态文件目录, 文件在工作线程中按范围读取, 小文件保存在按容量淘汰的缓存中
+// 引擎的返回体是完整的 TArray, 不能流式发送, 超过 MaxResponseBytes 的范围只返回前 MaxResponseBytes 字节,
+// 超过的整个文件回复 501, 大文件需要客户端用 Range 分段请求
+class FDTHttpServerStaticDirectory
+{
+public:
+	FDTHttpServerStaticDirectory(const FString & InDiskPath, int64 InMaxCacheBytes, int64 InMaxResponseBytes);
+
+	// 处理请求, 可以在任意线程调用
+	FDTHttpServerNativeResponse Serve(const FDTHttpServerNativeRequest & Request);
+
+	// 设置缓存容量和返回体上限, 游戏线程每帧调用
+	void SetLimits(int64 InMaxCacheBytes, int64 InMaxResponseBytes);
+
+	// 按扩展名猜测返回类型
+	static const TCHAR * GuessContentType(const FString & Filename, bool & bOutCompressible);
+
+private:
+	struct FCachedFile
+	{
+		TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>	Data;
+		FDateTime												ModificationTime;
+		uint64													LastUse = 0;
+	};
+
+	// 转换为磁盘路径, 不允许访问目录以外的文件
+	bool ResolvePath(FStringView RelativePath, FString & OutFilename) const;
+
+	// 读取整个文件, 优先使用缓存
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> LoadCachedFile(const FString & Filename, const FFileStatData & StatData);
+
+	// 读取文件的一部分, 直接读入返回体
+	static bool ReadFileRange(const FString & Filename, int64 Offset, int64 Size, TArray<uint8> & OutData);
+
+	// 淘汰文件直到不超过容量, 调用前需要加锁
+	void Trim();
+
+private:
+	FString						m_DiskPath;
+	FCriticalSection			m_Lock;
+	TMap<FString, FCachedFile>	m_Files;
+	int64						m_UsedBytes = 0;
+	int64						m_MaxBytes = 0;
+	int64						m_MaxResponseBytes = 0;
+	uint64						m_UseCounter = 0;
+};
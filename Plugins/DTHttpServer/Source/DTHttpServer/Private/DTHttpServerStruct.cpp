@@ -2,32 +2,89 @@
 // EMail: 45141961@qq.com
 
 #include "DTHttpServerStruct.h"
+#include "HttpServerRequest.h"
+
+// 查找路径参数
+bool FDTHttpServerPathParams::Find(FStringView Name, FStringView& Value) const
+{
+	for ( int32 Index = 0; Index < Ranges.Num(); ++Index )
+	{
+		if ( GetName(Index).Equals(Name) )
+		{
+			Value = GetValue(Index);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 查找参数
+const FString* FDTHttpServerParams::Find(const FString& Key) const
+{
+	if ( !View.IsValid() || View->Request == nullptr ) { return nullptr; }
+	return View->Request->QueryParams.Find(Key);
+}
+
+// 查找路径参数
+bool FDTHttpServerParams::FindPathParam(FStringView Key, FStringView& Value) const
+{
+	if ( !View.IsValid() || View->Request == nullptr ) { return false; }
+	return View->PathParams.Find(Key, Value);
+}
+
+// 查找头
+const TArray<FString>* FDTHttpServerHeaders::Find(const FString& Key) const
+{
+	if ( !View.IsValid() || View->Request == nullptr ) { return nullptr; }
+	return View->Request->Headers.Find(Key);
+}
 
 void UDTHttpServerBPLib::BreakParams(const FDTHttpServerParams& HttpServerParams, TMap<FString, FString>& Params)
 {
-	Params = HttpServerParams.Params;
+	Params.Empty();
+	if ( HttpServerParams.View.IsValid() && HttpServerParams.View->Request != nullptr )
+	{
+		Params = HttpServerParams.View->Request->QueryParams;
+	}
 }
 
 void UDTHttpServerBPLib::FindParam(const FDTHttpServerParams& HttpServerParams, const FString& Key, FString& Param)
 {
 	Param.Empty();
-	if ( const FString * pParam = HttpServerParams.Params.Find(Key) )
+	if ( const FString * pParam = HttpServerParams.Find(Key) )
 	{
 		Param = *pParam;
 	}
 }
 
+void UDTHttpServerBPLib::FindPathParam(const FDTHttpServerParams& HttpServerParams, const FString& Key, FString& Param)
+{
+	Param.Empty();
+	FStringView Value;
+	if ( HttpServerParams.FindPathParam(Key, Value) )
+	{
+		Param = FString(Value);
+	}
+}
+
 void UDTHttpServerBPLib::BreakHeaders(const FDTHttpServerHeaders& HttpServerHeaders, TMap<FString, FString>& Headers)
 {
-	Headers = HttpServerHeaders.Headers;
+	Headers.Empty();
+	if ( HttpServerHeaders.View.IsValid() && HttpServerHeaders.View->Request != nullptr )
+	{
+		// 只有拆分节点生成完整的头
+		for ( const auto & Header : HttpServerHeaders.View->Request->Headers )
+		{
+			Headers.Add(Header.Key, FString::Join(Header.Value, TEXT(",")));
+		}
+	}
 }
 
 void UDTHttpServerBPLib::FindHeader(const FDTHttpServerHeaders& HttpServerHeaders, const FString& Key, FString& Header)
 {
 	Header.Empty();
-	if ( const FString * pHeader = HttpServerHeaders.Headers.Find(Key) )
+	if ( const TArray<FString> * pHeader = HttpServerHeaders.Find(Key) )
 	{
-		Header = *pHeader;
+		Header = pHeader->Num() == 1 ? (*pHeader)[0] : FString::Join(*pHeader, TEXT(","));
 	}
 }
-
@@ -0,0 +1,376 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#include "DTHttpServerUpload.h"
+#include "DTHttpServer.h"
+#include "HAL/PlatformFileManager.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "Misc/Paths.h"
+#include "Misc/Guid.h"
+
+namespace DTHttpServer
+{
+	// 每次写入和回调的数据大小
+	static constexpr int32 UploadChunkBytes = 1024 * 1024;
+	// 表单字段的最大长度
+	static constexpr int32 UploadMaxFieldBytes = 1024 * 1024;
+
+	// 查找数据, Boyer-Moore-Horspool, 分隔符较长时每次可以跳过多个字节
+	class FUploadDelimiter
+	{
+	public:
+		explicit FUploadDelimiter(TArray<uint8> && InPattern)
+			: m_Pattern(MoveTemp(InPattern))
+		{
+			const int32 Length = m_Pattern.Num();
+			for ( int32 & Skip : m_Skip ) { Skip = Length; }
+			for ( int32 Index = 0; Index < Length - 1; ++Index )
+			{
+				m_Skip[m_Pattern[Index]] = Length - 1 - Index;
+			}
+		}
+
+		int32 Num() const { return m_Pattern.Num(); }
+		const uint8 * GetData() const { return m_Pattern.GetData(); }
+
+		// 从 Start 开始查找, 没有找到返回 INDEX_NONE
+		int32 Find(TArrayView<const uint8> Data, int32 Start) const
+		{
+			const int32 Length = m_Pattern.Num();
+			const uint8 * Pattern = m_Pattern.GetData();
+			const uint8 Last = Pattern[Length - 1];
+			for ( int32 Position = FMath::Max(Start, 0); Position + Length <= Data.Num(); )
+			{
+				const uint8 Byte = Data[Position + Length - 1];
+				if ( Byte == Last && FMemory::Memcmp(Data.GetData() + Position, Pattern, Length - 1) == 0 )
+				{
+					return Position;
+				}
+				Position += m_Skip[Byte];
+			}
+			return INDEX_NONE;
+		}
+
+	private:
+		TArray<uint8>	m_Pattern;
+		int32			m_Skip[256];
+	};
+
+	// 生成分隔符
+	static TArray<uint8> MakeUploadPattern(const ANSICHAR * Prefix, const FString & Text)
+	{
+		TArray<uint8> Pattern;
+		Pattern.Append((const uint8 *)Prefix, FCStringAnsi::Strlen(Prefix));
+		const FTCHARToUTF8 TextConverter(*Text, Text.Len());
+		Pattern.Append((const uint8 *)TextConverter.Get(), TextConverter.Length());
+		return Pattern;
+	}
+
+	// 查找头中的参数, 如 Content-Disposition 中的 name 和 filename
+	static bool FindUploadHeaderParam(const FString & Value, const TCHAR * Name, FString & OutValue)
+	{
+		TArray<FString> Params;
+		Value.ParseIntoArray(Params, TEXT(";"));
+		for ( FString & Param : Params )
+		{
+			FString Key, ParamValue;
+			if ( !Param.Split(TEXT("="), &Key, &ParamValue) ) { continue; }
+			Key.TrimStartAndEndInline();
+			if ( !Key.Equals(Name, ESearchCase::IgnoreCase) ) { continue; }
+			ParamValue.TrimStartAndEndInline();
+			if ( ParamValue.Len() >= 2 && ParamValue.StartsWith(TEXT("\"")) && ParamValue.EndsWith(TEXT("\"")) )
+			{
+				ParamValue.MidInline(1, ParamValue.Len() - 2);
+			}
+			OutValue = MoveTemp(ParamValue);
+			return true;
+		}
+		return false;
+	}
+
+	// 读取头中的参数, 没有时返回空字符串
+	static FString GetUploadHeaderParam(const FString & Value, const TCHAR * Name)
+	{
+		FString ParamValue;
+		FindUploadHeaderParam(Value, Name, ParamValue);
+		return ParamValue;
+	}
+
+	// 查找请求头
+	static FString GetUploadHeader(const FHttpServerRequest & Request, const TCHAR * Name)
+	{
+		const TArray<FString> * Values = Request.Headers.Find(Name);
+		return Values != nullptr && Values->Num() > 0 ? (*Values)[0] : FString();
+	}
+
+	// UTF-8 数据转字符串
+	static FString UploadBytesToString(TArrayView<const uint8> Data)
+	{
+		if ( Data.Num() == 0 ) { return FString(); }
+		const FUTF8ToTCHAR Converter((const ANSICHAR *)Data.GetData(), Data.Num());
+		return FString(Converter.Length(), Converter.Get());
+	}
+}
+
+FDTHttpServerUpload::FDTHttpServerUpload(const FDTHttpServerUploadOptions& InOptions, const FString& InDirectory, const FDTHttpServerUploadChunkHandler& InChunkHandler)
+	: m_Options(InOptions)
+	, m_Directory(InDirectory)
+	, m_ChunkHandler(InChunkHandler)
+{
+}
+
+FDTHttpServerUpload::~FDTHttpServerUpload()
+{
+	AbortPart();
+}
+
+// 记录错误
+bool FDTHttpServerUpload::Fail(EHttpServerResponseCodes Code, const TCHAR* Error)
+{
+	if ( m_Error.IsEmpty() )
+	{
+		m_ErrorCode = Code;
+		m_Error = Error;
+	}
+	return false;
+}
+
+// 解析请求数据
+bool FDTHttpServerUpload::Process(const FHttpServerRequest& Request, FDTHttpServerUploadResult& OutResult, EHttpServerResponseCodes& OutCode, FString& OutError)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const FString ContentType = DTHttpServer::GetUploadHeader(Request, TEXT("Content-Type"));
+
+	bool bSucceeded;
+	if ( ContentType.StartsWith(TEXT("multipart/form-data"), ESearchCase::IgnoreCase) )
+	{
+		const FString Boundary = DTHttpServer::GetUploadHeaderParam(ContentType, TEXT("boundary"));
+		bSucceeded = !Boundary.IsEmpty() ? ProcessMultipart(Request.Body, Boundary, OutResult) : Fail(EHttpServerResponseCodes::BadRequest, TEXT("Missing multipart boundary"));
+	}
+	else
+	{
+		// 原始数据, 文件名由查询参数或 X-File-Name 头指定
+		FDTHttpServerUploadedFile File;
+		File.ContentType = ContentType;
+		const FString * FileNameParam = Request.QueryParams.Find(TEXT("filename"));
+		File.FileName = FileNameParam != nullptr ? *FileNameParam : DTHttpServer::GetUploadHeader(Request, TEXT("X-File-Name"));
+		bSucceeded = BeginPart(File) && WritePart(Request.Body) && EndPart(File);
+		if ( bSucceeded )
+		{
+			OutResult.Files.Add(MoveTemp(File));
+		}
+	}
+
+	if ( !bSucceeded )
+	{
+		AbortPart();
+		for ( const FDTHttpServerUploadedFile & File : OutResult.Files )
+		{
+			if ( !File.SavedPath.IsEmpty() )
+			{
+				FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*File.SavedPath);
+			}
+		}
+		OutCode = m_ErrorCode;
+		OutError = m_Error;
+		return false;
+	}
+
+	UE_LOG(LogDTHttpServer, Verbose, TEXT("Upload of %d bytes, %d files in %.3f seconds"), Request.Body.Num(), OutResult.Files.Num(), FPlatformTime::Seconds() - StartTime);
+	return true;
+}
+
+// 解析 multipart/form-data
+bool FDTHttpServerUpload::ProcessMultipart(TArrayView<const uint8> Body, const FString& Boundary, FDTHttpServerUploadResult& OutResult)
+{
+	// 部分之间的分隔符为 CRLF--boundary, 第一个分隔符前面可以没有 CRLF
+	const DTHttpServer::FUploadDelimiter Delimiter(DTHttpServer::MakeUploadPattern("\r\n--", Boundary));
+	const DTHttpServer::FUploadDelimiter HeaderEnd(DTHttpServer::MakeUploadPattern("\r\n\r\n", FString()));
+
+	// 数据直接以 --boundary 开始时跳过开头的 CRLF 比较
+	int32 Position;
+	const int32 OpeningLength = Delimiter.Num() - 2;
+	if ( Body.Num() >= OpeningLength && FMemory::Memcmp(Body.GetData(), Delimiter.GetData() + 2, OpeningLength) == 0 )
+	{
+		Position = OpeningLength;
+	}
+	else
+	{
+		const int32 First = Delimiter.Find(Body, 0);
+		if ( First == INDEX_NONE ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Multipart boundary not found")); }
+		Position = First + Delimiter.Num();
+	}
+
+	for ( ;; )
+	{
+		// 结束分隔符
+		if ( Position + 2 <= Body.Num() && Body[Position] == '-' && Body[Position + 1] == '-' ) { return true; }
+
+		// 分隔符所在行的剩余部分
+		while ( Position + 1 < Body.Num() && !(Body[Position] == '\r' && Body[Position + 1] == '\n') ) { ++Position; }
+		if ( Position + 1 >= Body.Num() ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Unterminated multipart body")); }
+
+		// 部分的头, 没有头时空行紧跟在分隔符后面
+		const int32 HeaderStart = Position + 2;
+		const int32 HeaderStop = HeaderEnd.Find(Body, Position);
+		if ( HeaderStop == INDEX_NONE ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Unterminated multipart headers")); }
+
+		FDTHttpServerUploadedFile File;
+		FString Disposition;
+		TArray<FString> HeaderLines;
+		DTHttpServer::UploadBytesToString(Body.Slice(HeaderStart, FMath::Max(HeaderStop - HeaderStart, 0))).ParseIntoArrayLines(HeaderLines);
+		for ( const FString & Line : HeaderLines )
+		{
+			FString Name, Value;
+			if ( !Line.Split(TEXT(":"), &Name, &Value) ) { continue; }
+			Name.TrimStartAndEndInline();
+			Value.TrimStartAndEndInline();
+			if ( Name.Equals(TEXT("Content-Disposition"), ESearchCase::IgnoreCase) ) { Disposition = MoveTemp(Value); }
+			else if ( Name.Equals(TEXT("Content-Type"), ESearchCase::IgnoreCase) ) { File.ContentType = MoveTemp(Value); }
+		}
+		File.FieldName = DTHttpServer::GetUploadHeaderParam(Disposition, TEXT("name"));
+
+		// 部分的数据
+		const int32 DataStart = HeaderStop + 4;
+		const int32 DataStop = Delimiter.Find(Body, DataStart);
+		if ( DataStop == INDEX_NONE ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Unterminated multipart body")); }
+		const TArrayView<const uint8> Data = Body.Slice(DataStart, DataStop - DataStart);
+
+		// 没有 filename 参数的部分为表单字段
+		if ( !DTHttpServer::FindUploadHeaderParam(Disposition, TEXT("filename"), File.FileName) )
+		{
+			if ( Data.Num() > DTHttpServer::UploadMaxFieldBytes ) { return Fail(static_cast<EHttpServerResponseCodes>(413), TEXT("Form field too large")); }
+			OutResult.Fields.Add(File.FieldName, DTHttpServer::UploadBytesToString(Data));
+		}
+		else
+		{
+			if ( OutResult.Files.Num() >= m_Options.MaxFiles ) { return Fail(static_cast<EHttpServerResponseCodes>(413), TEXT("Too many files")); }
+			if ( !BeginPart(File) || !WritePart(Data) || !EndPart(File) ) { return false; }
+			OutResult.Files.Add(MoveTemp(File));
+		}
+
+		Position = DataStop + Delimiter.Num();
+	}
+}
+
+// 开始一个文件
+bool FDTHttpServerUpload::BeginPart(const FDTHttpServerUploadedFile& File)
+{
+	m_Current = File;
+	m_Current.Bytes = 0;
+	m_Crc = 0;
+	m_Sha1.Reset();
+	if ( m_ChunkHandler ) { return true; }
+
+	// 只保留文件名, 不允许指向上级目录
+	FString CleanName = FPaths::MakeValidFileName(FPaths::GetCleanFilename(File.FileName));
+	if ( CleanName.IsEmpty() || CleanName.StartsWith(TEXT(".")) )
+	{
+		CleanName.InsertAt(0, TEXT("upload"));
+	}
+
+	IPlatformFile & PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if ( !PlatformFile.CreateDirectoryTree(*m_Directory) ) { return Fail(EHttpServerResponseCodes::ServerError, TEXT("Failed to create the upload directory")); }
+
+	// 同名文件加上序号
+	m_Current.SavedPath = FPaths::Combine(m_Directory, CleanName);
+	if ( !m_Options.bOverwrite )
+	{
+		const FString BaseName = FPaths::GetBaseFilename(CleanName);
+		const FString Extension = FPaths::GetExtension(CleanName, true);
+		for ( int32 Suffix = 1; PlatformFile.FileExists(*m_Current.SavedPath); ++Suffix )
+		{
+			m_Current.SavedPath = FPaths::Combine(m_Directory, FString::Printf(TEXT("%s (%d)%s"), *BaseName, Suffix, *Extension));
+		}
+	}
+
+	// 写入临时文件, 完成后再改名, 其它读取者不会看到不完整的文件
+	m_TempPath = FString::Printf(TEXT("%s.%s.part"), *m_Current.SavedPath, *FGuid::NewGuid().ToString());
+	m_File.Reset(PlatformFile.OpenWrite(*m_TempPath));
+	return m_File.IsValid() || Fail(EHttpServerResponseCodes::ServerError, TEXT("Failed to open the upload file"));
+}
+
+// 按块写入
+bool FDTHttpServerUpload::WritePart(TArrayView<const uint8> Data)
+{
+	for ( int32 Offset = 0; Offset < Data.Num(); Offset += DTHttpServer::UploadChunkBytes )
+	{
+		const TArrayView<const uint8> Chunk = Data.Slice(Offset, FMath::Min(DTHttpServer::UploadChunkBytes, Data.Num() - Offset));
+		switch ( m_Options.Checksum )
+		{
+		case EDTHttpServerChecksum::CRC32:
+			m_Crc = FCrc::MemCrc32(Chunk.GetData(), Chunk.Num(), m_Crc);
+			break;
+		case EDTHttpServerChecksum::SHA1:
+			m_Sha1.Update(Chunk.GetData(), Chunk.Num());
+			break;
+		default:
+			break;
+		}
+
+		if ( m_ChunkHandler )
+		{
+			if ( !m_ChunkHandler(m_Current, Chunk) ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Upload rejected")); }
+		}
+		else if ( !m_File->Write(Chunk.GetData(), Chunk.Num()) )
+		{
+			return Fail(EHttpServerResponseCodes::ServerError, TEXT("Failed to write the upload file"));
+		}
+		m_Current.Bytes += Chunk.Num();
+	}
+	return true;
+}
+
+// 完成文件
+bool FDTHttpServerUpload::EndPart(FDTHttpServerUploadedFile& OutFile)
+{
+	switch ( m_Options.Checksum )
+	{
+	case EDTHttpServerChecksum::CRC32:
+		m_Current.Checksum = FString::Printf(TEXT("%08x"), m_Crc);
+		break;
+	case EDTHttpServerChecksum::SHA1:
+		{
+			uint8 Hash[FSHA1::DigestSize];
+			m_Sha1.Final();
+			m_Sha1.GetHash(Hash);
+			m_Current.Checksum = BytesToHex(Hash, FSHA1::DigestSize).ToLower();
+		}
+		break;
+	default:
+		break;
+	}
+
+	// 空数据块表示结束
+	if ( m_ChunkHandler )
+	{
+		if ( !m_ChunkHandler(m_Current, TArrayView<const uint8>()) ) { return Fail(EHttpServerResponseCodes::BadRequest, TEXT("Upload rejected")); }
+		OutFile = m_Current;
+		return true;
+	}
+
+	m_File.Reset();
+	IPlatformFile & PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if ( m_Options.bOverwrite && PlatformFile.FileExists(*m_Current.SavedPath) )
+	{
+		PlatformFile.DeleteFile(*m_Current.SavedPath);
+	}
+	if ( !PlatformFile.MoveFile(*m_Current.SavedPath, *m_TempPath) )
+	{
+		return Fail(EHttpServerResponseCodes::ServerError, TEXT("Failed to move the upload file"));
+	}
+	m_TempPath.Reset();
+	OutFile = m_Current;
+	return true;
+}
+
+// 删除写了一半的文件
+void FDTHttpServerUpload::AbortPart()
+{
+	m_File.Reset();
+	if ( !m_TempPath.IsEmpty() )
+	{
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*m_TempPath);
+		m_TempPath.Reset();
+	}
+}
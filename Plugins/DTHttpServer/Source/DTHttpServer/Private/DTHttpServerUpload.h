@@ -0,0 +1,52 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerNative.h"
+#include "Misc/SecureHash.h"
+
+class IFileHandle;
+
+// 上传数据解析, 支持 multipart/form-data 和原始数据
+// 每个文件按 1MB 的数据块写入文件或交给回调, 同时计算校验, 不生成完整数据的字符串
+class FDTHttpServerUpload
+{
+public:
+	FDTHttpServerUpload(const FDTHttpServerUploadOptions & InOptions, const FString & InDirectory, const FDTHttpServerUploadChunkHandler & InChunkHandler);
+	~FDTHttpServerUpload();
+
+	// 解析请求数据, 失败时删除写了一半的文件并返回错误码和信息
+	bool Process(const FHttpServerRequest & Request, FDTHttpServerUploadResult & OutResult, EHttpServerResponseCodes & OutCode, FString & OutError);
+
+private:
+	bool ProcessMultipart(TArrayView<const uint8> Body, const FString & Boundary, FDTHttpServerUploadResult & OutResult);
+
+	// 开始一个文件
+	bool BeginPart(const FDTHttpServerUploadedFile & File);
+	// 按块写入并计算校验
+	bool WritePart(TArrayView<const uint8> Data);
+	// 完成文件, 临时文件改为最终名称
+	bool EndPart(FDTHttpServerUploadedFile & OutFile);
+	// 删除写了一半的文件
+	void AbortPart();
+
+	// 记录错误
+	bool Fail(EHttpServerResponseCodes Code, const TCHAR * Error);
+
+private:
+	FDTHttpServerUploadOptions			m_Options;
+	FString								m_Directory;
+	FDTHttpServerUploadChunkHandler		m_ChunkHandler;
+
+	// 当前文件
+	FDTHttpServerUploadedFile			m_Current;
+	TUniquePtr<IFileHandle>				m_File;
+	FString								m_TempPath;
+	uint32								m_Crc = 0;
+	FSHA1								m_Sha1;
+
+	EHttpServerResponseCodes			m_ErrorCode = EHttpServerResponseCodes::BadRequest;
+	FString								m_Error;
+};
@@ -5,6 +5,8 @@
 
 #include "Modules/ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogDTHttpServer, Log, All);
+
 class FDTHttpServerModule : public IModuleInterface
 {
 public:
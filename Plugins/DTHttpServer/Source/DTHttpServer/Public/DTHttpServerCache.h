@@ -0,0 +1,100 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+
+// 缓存的返回, 创建后不再修改, 可以在线程之间共享
+struct FDTHttpServerCachedResponse
+{
+	// 请求路径, 用于按路径失效
+	FString								Path;
+	EHttpServerResponseCodes			Code = EHttpServerResponseCodes::Ok;
+	TMap<FString, TArray<FString>>		Headers;
+	TArray<uint8>						Body;
+	FString								ETag;
+	// 过期时间, 为 0 时只能手动失效
+	double								ExpireTime = 0.0;
+};
+
+typedef TSharedPtr<const FDTHttpServerCachedResponse, ESPMode::ThreadSafe> FDTHttpServerCachedResponsePtr;
+
+// GET 返回缓存, 按路径和查询参数保存, 超过容量时先淘汰过期数据, 再淘汰最早保存的数据
+class DTHTTPSERVER_API FDTHttpServerResponseCache
+{
+public:
+	explicit FDTHttpServerResponseCache(int64 InMaxBytes);
+
+	// 路径加排序后的查询参数
+	static FString MakeKey(const FHttpServerRequest & Request);
+
+	// 由数据生成强 ETag
+	static FString MakeETag(TArrayView<const uint8> Body);
+
+	// If-None-Match 中是否有相同的 ETag, 忽略压缩时附加的后缀
+	static bool MatchesETag(const TArray<FString> & IfNoneMatch, const FString & ETag);
+
+	// 查找没有过期的返回
+	FDTHttpServerCachedResponsePtr Find(const FString & Key) const;
+
+	// 路径的失效计数, 创建请求时记录, 保存时用来丢弃失效前生成的返回
+	uint64 GetGeneration(const FString & Path) const;
+
+	// 保存返回, 路径在 Generation 之后失效过时不保存
+	void Add(const FString & Key, const FDTHttpServerCachedResponsePtr & CachedResponse, uint64 Generation);
+
+	// 使路径下的所有返回失效, 路径为空时清空缓存
+	void Invalidate(const FString & Path);
+
+	// 设置缓存容量
+	void SetMaxBytes(int64 InMaxBytes);
+
+private:
+	struct FEntry
+	{
+		FDTHttpServerCachedResponsePtr	Response;
+		uint64							Sequence = 0;
+	};
+
+	// 淘汰数据直到不超过容量, 调用前需要加锁
+	void Trim();
+
+	// 失效计数, 调用前需要加锁
+	uint64 GetGenerationLocked(const FString & Path) const;
+
+private:
+	mutable FCriticalSection	m_Lock;
+	TMap<FString, FEntry>		m_Entries;
+	int64						m_UsedBytes = 0;
+	int64						m_MaxBytes = 0;
+	uint64						m_Sequence = 0;
+	// 清空缓存的次数和各路径失效的次数, 只增加, 两者之和变化即表示路径失效过
+	uint64						m_Generation = 0;
+	TMap<FString, uint64>		m_PathGenerations;
+};
+
+typedef TSharedPtr<FDTHttpServerResponseCache, ESPMode::ThreadSafe> FDTHttpServerResponseCachePtr;
+
+// 单个请求的缓存设置, 返回时生成 ETag 并保存数据
+struct DTHTTPSERVER_API FDTHttpServerCacheStore
+{
+	// 返回缓存, 为空时不缓存
+	FDTHttpServerResponseCachePtr	Cache;
+	FString							Key;
+	FString							Path;
+	// 有效时间, 小于等于 0 时只能手动失效
+	double							TtlSeconds = 0.0;
+	// 请求的 If-None-Match
+	TArray<FString>					IfNoneMatch;
+	// 创建请求时路径的失效计数
+	uint64							Generation = 0;
+
+	// 是否需要缓存
+	bool IsEnabled() const { return Cache.IsValid(); }
+
+	// 设置 ETag 并保存成功的返回, 客户端已有相同数据时改为 304
+	void Apply(FHttpServerResponse & Response) const;
+};
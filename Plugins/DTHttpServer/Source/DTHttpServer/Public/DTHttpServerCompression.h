@@ -0,0 +1,75 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+
+// 压缩后的数据缓存, 按原始数据的哈希查找, 超过容量时淘汰最久没有使用的数据
+class DTHTTPSERVER_API FDTHttpServerCompressionCache
+{
+public:
+	explicit FDTHttpServerCompressionCache(int64 InMaxBytes);
+
+	// 压缩数据, 相同内容直接返回缓存, 可以在任意线程调用
+	bool Compress(FName Format, TArrayView<const uint8> Body, TArray<uint8> & OutBody);
+
+	// 设置缓存容量
+	void SetMaxBytes(int64 InMaxBytes);
+
+	// 已使用的缓存大小
+	int64 GetUsedBytes() const;
+
+private:
+	struct FKey
+	{
+		uint64		Hash = 0;
+		int32		Size = 0;
+		FName		Format;
+
+		bool operator==(const FKey & Other) const { return Hash == Other.Hash && Size == Other.Size && Format == Other.Format; }
+		friend uint32 GetTypeHash(const FKey & Key) { return HashCombine(::GetTypeHash(Key.Hash), GetTypeHash(Key.Format)); }
+	};
+
+	struct FEntry
+	{
+		TArray<uint8>	Data;
+		uint64			LastUse = 0;
+	};
+
+	// 淘汰数据直到不超过容量, 调用前需要加锁
+	void Trim();
+
+private:
+	mutable FCriticalSection	m_Lock;
+	TMap<FKey, FEntry>			m_Entries;
+	int64						m_UsedBytes = 0;
+	int64						m_MaxBytes = 0;
+	uint64						m_UseCounter = 0;
+};
+
+typedef TSharedPtr<FDTHttpServerCompressionCache, ESPMode::ThreadSafe> FDTHttpServerCompressionCachePtr;
+
+// 单个请求的压缩设置, 由路由根据 Accept-Encoding 生成
+struct DTHTTPSERVER_API FDTHttpServerCompression
+{
+	// 压缩格式, 为空时不压缩
+	FName								Format;
+	// Content-Encoding 返回头
+	const TCHAR *						ContentEncoding = nullptr;
+	// 小于该长度的数据不压缩
+	int32								MinBytes = 0;
+	// 压缩缓存, 为空时不缓存
+	FDTHttpServerCompressionCachePtr	Cache;
+
+	// 是否需要压缩
+	bool ShouldCompress(int32 Size) const { return !Format.IsNone() && Size > 0 && Size >= MinBytes; }
+
+	// 根据请求的 Accept-Encoding 选择压缩格式, gzip 优先
+	static FDTHttpServerCompression Negotiate(const FHttpServerRequest & Request, int32 MinBytes, const FDTHttpServerCompressionCachePtr & Cache);
+
+	// 压缩返回数据并设置返回头, 失败或没有变小时保持原样
+	void Apply(FHttpServerResponse & Response) const;
+};
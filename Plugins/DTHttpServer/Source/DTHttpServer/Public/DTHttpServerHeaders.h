@@ -0,0 +1,32 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DTHttpServerStruct.h"
+#include "HttpServerResponse.h"
+
+// 预先生成的返回头, 创建后不再修改, 可以在线程之间共享
+class DTHTTPSERVER_API FDTHttpServerHeaderSet
+{
+public:
+	explicit FDTHttpServerHeaderSet(const FDTHttpServerHeaderPolicy & Policy);
+
+	// 创建普通返回, 只拷贝预先生成的头
+	TUniquePtr<FHttpServerResponse> CreateResponse() const;
+
+	// 创建跨域预检返回
+	TUniquePtr<FHttpServerResponse> CreatePreflightResponse() const;
+
+	// 是否处理跨域预检
+	bool IsCorsEnabled() const { return m_bCorsEnabled; }
+
+private:
+	TMap<FString, TArray<FString>>		m_ResponseHeaders;
+	TMap<FString, TArray<FString>>		m_PreflightHeaders;
+	bool								m_bCorsEnabled = false;
+};
+
+typedef TSharedRef<const FDTHttpServerHeaderSet, ESPMode::ThreadSafe> FDTHttpServerHeaderSetRef;
+typedef TSharedPtr<const FDTHttpServerHeaderSet, ESPMode::ThreadSafe> FDTHttpServerHeaderSetPtr;
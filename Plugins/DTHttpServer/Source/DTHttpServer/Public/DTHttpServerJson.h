@@ -0,0 +1,58 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+
+// 在 UTF-8 数据和反射结构体之间直接转换的 JSON 读写, 不生成 FString 或 FJsonObject 中间数据
+// 字段名与 FJsonObjectConverter 相同, 写出时首字母小写, 读取时不区分大小写
+class DTHTTPSERVER_API FDTHttpServerJson
+{
+public:
+	// 解析 JSON 对象到结构体, 没有出现的字段保持原值, 未知字段跳过, 失败时返回错误和位置
+	// 字符串字段遇到其它类型的值时保存该值的 JSON 文本
+	static bool ReadStruct(TArrayView<const uint8> Json, const UScriptStruct * Struct, void * Data, FString * OutError = nullptr);
+
+	// 解析结构体数组, 每个元素由 AddElement 分配
+	static bool ReadStructArray(TArrayView<const uint8> Json, const UScriptStruct * Struct, TFunctionRef<void *()> AddElement, FString * OutError = nullptr);
+
+	// 解析结构体数组, 元素超过 MaxElements 时停止解析, 返回 false 并设置 bOutTooManyElements
+	static bool ReadStructArray(TArrayView<const uint8> Json, const UScriptStruct * Struct, TFunctionRef<void *()> AddElement, int32 MaxElements, bool & bOutTooManyElements, FString * OutError = nullptr);
+
+	// 是否为完整有效的 JSON
+	static bool IsValid(TArrayView<const uint8> Json);
+
+	// 结构体写成 JSON 对象, 追加到 Out
+	static void WriteStruct(const UScriptStruct * Struct, const void * Data, TArray<uint8> & Out);
+
+	// 写出带引号和转义的字符串, 追加到 Out
+	static void WriteString(FStringView Value, TArray<uint8> & Out);
+
+	template<typename StructType>
+	static bool ReadStruct(TArrayView<const uint8> Json, StructType & Value, FString * OutError = nullptr)
+	{
+		return ReadStruct(Json, StructType::StaticStruct(), &Value, OutError);
+	}
+
+	template<typename StructType>
+	static bool ReadStructArray(TArrayView<const uint8> Json, TArray<StructType> & Values, FString * OutError = nullptr)
+	{
+		Values.Reset();
+		return ReadStructArray(Json, StructType::StaticStruct(), [&Values]() -> void * { return &Values.AddDefaulted_GetRef(); }, OutError);
+	}
+
+	template<typename StructType>
+	static bool ReadStructArray(TArrayView<const uint8> Json, TArray<StructType> & Values, int32 MaxElements, bool & bOutTooManyElements, FString * OutError = nullptr)
+	{
+		Values.Reset();
+		return ReadStructArray(Json, StructType::StaticStruct(), [&Values]() -> void * { return &Values.AddDefaulted_GetRef(); }, MaxElements, bOutTooManyElements, OutError);
+	}
+
+	template<typename StructType>
+	static void WriteStruct(const StructType & Value, TArray<uint8> & Out)
+	{
+		WriteStruct(StructType::StaticStruct(), &Value, Out);
+	}
+};
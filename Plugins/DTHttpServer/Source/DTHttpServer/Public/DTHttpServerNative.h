@@ -0,0 +1,132 @@
+﻿// Copyright 2023 Dexter.Wan. All Rights Reserved. 
+// EMail: 45141961@qq.com
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpServerRequest.h"
+#include "HttpServerConstants.h"
+#include "HttpServerResponse.h"
+#include "HttpResultCallback.h"
+#include "DTHttpServerStruct.h"
+#include "DTHttpServerCompression.h"
+#include "DTHttpServerCache.h"
+#include <atomic>
+
+class FDTHttpServerRouteMetrics;
+
+// 原生请求, 直接引用连接上的请求数据, 不做任何拷贝和转码
+class DTHTTPSERVER_API FDTHttpServerNativeRequest
+{
+public:
+	explicit FDTHttpServerNativeRequest(const FHttpServerRequest & InRequest, const FDTHttpServerPathParams & InPathParams = FDTHttpServerPathParams())
+		: m_Request(&InRequest)
+		, m_PathParams(InPathParams)
+	{
+	}
+
+	// 持有请求拷贝, 用于延迟或跨线程处理
+	explicit FDTHttpServerNativeRequest(const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe> & InRequest, const FDTHttpServerPathParams & InPathParams = FDTHttpServerPathParams())
+		: m_Request(&InRequest.Get())
+		, m_OwnedRequest(InRequest)
+		, m_PathParams(InPathParams)
+	{
+	}
+
+	// 原始请求
+	const FHttpServerRequest & GetRequest() const { return *m_Request; }
+
+	// 请求数据视图, 指向连接的接收缓存
+	TArrayView<const uint8> GetBody() const { return m_Request->Body; }
+
+	// 完整请求路径
+	const FString & GetPath() const { return m_Request->RelativePath.GetPath(); }
+
+	// 路由没有匹配的剩余路径, 完全匹配时为空
+	FStringView GetRelativePath() const { return m_PathParams.GetRemainder(); }
+
+	// 路径参数
+	const FDTHttpServerPathParams & GetPathParams() const { return m_PathParams; }
+
+	// 查找路径参数, 返回路径上的视图
+	bool FindPathParam(FStringView Name, FStringView & Value) const { return m_PathParams.Find(Name, Value); }
+
+	// 查找头, 不存在返回空
+	const TArray<FString> * FindHeader(const FString & Key) const { return m_Request->Headers.Find(Key); }
+
+	// 查找参数, 不存在返回空
+	const FString * FindQueryParam(const FString & Key) const { return m_Request->QueryParams.Find(Key); }
+
+protected:
+	const FHttpServerRequest *									m_Request;
+	TSharedPtr<const FHttpServerRequest, ESPMode::ThreadSafe>	m_OwnedRequest;
+	FDTHttpServerPathParams										m_PathParams;
+};
+
+typedef TSharedRef<const FDTHttpServerNativeRequest, ESPMode::ThreadSafe> FDTHttpServerNativeRequestRef;
+
+// 原生返回, Body 会被直接移动到返回对象中
+struct FDTHttpServerNativeResponse
+{
+	// 返回码
+	EHttpServerResponseCodes	Code = EHttpServerResponseCodes::Ok;
+	// 返回类型, 为空时使用默认类型
+	FString						ContentType;
+	// 返回数据
+	TArray<uint8>				Body;
+	// 额外的返回头, 覆盖同名的默认头
+	TMap<FString, TArray<FString>>	Headers;
+	// 是否允许按 Accept-Encoding 压缩, 已压缩的数据或部分返回时关闭
+	bool						bAllowCompression = true;
+};
+
+// 异步返回, 可以在任意线程中完成, 完成后转回游戏线程发送
+// 所有拷贝共享同一个状态, 只有第一次设置有效, 全部释放时仍未设置则返回 500
+// 需要压缩或缓存的数据在工作线程中处理, 不占用设置返回的线程
+class DTHTTPSERVER_API FDTHttpServerPromise
+{
+public:
+	FDTHttpServerPromise(const FHttpResultCallback & OnComplete, TUniquePtr<FHttpServerResponse> && Response, const FDTHttpServerCompression & Compression = FDTHttpServerCompression(), const FDTHttpServerCacheStore & CacheStore = FDTHttpServerCacheStore(), const TSharedPtr<FDTHttpServerRouteMetrics, ESPMode::ThreadSafe> & Metrics = nullptr);
+
+	// 设置返回数据
+	void SetValue(FDTHttpServerNativeResponse && NativeResponse) const;
+
+	// 是否已经返回
+	bool IsSet() const { return m_State->bSet.load(); }
+
+private:
+	struct FState
+	{
+		FHttpResultCallback					OnComplete;
+		TUniquePtr<FHttpServerResponse>		Response;
+		FDTHttpServerCompression			Compression;
+		FDTHttpServerCacheStore				CacheStore;
+		TSharedPtr<FDTHttpServerRouteMetrics, ESPMode::ThreadSafe>	Metrics;
+		std::atomic<bool>					bSet { false };
+
+		~FState();
+	};
+
+	TSharedRef<FState, ESPMode::ThreadSafe>	m_State;
+};
+
+// 路由回调, 在游戏线程上执行, 额外带上路径参数
+typedef TFunction<bool(const FHttpServerRequest & Request, const FDTHttpServerPathParams & PathParams, const FHttpResultCallback & OnComplete)> FDTHttpServerRouteHandler;
+
+// 原生回调, 执行线程由路由的执行方式决定
+typedef TFunction<FDTHttpServerNativeResponse(const FDTHttpServerNativeRequest & Request)> FDTHttpServerNativeHandler;
+
+// 原生异步回调, 通过 Promise 在任意线程中完成请求
+typedef TFunction<void(const FDTHttpServerNativeRequestRef & Request, const FDTHttpServerPromise & Promise)> FDTHttpServerNativeAsyncHandler;
+
+// 上传数据块回调, 在线程池中按顺序调用, 每个部分结束时传入空数据块, 返回 false 时中止上传
+typedef TFunction<bool(const FDTHttpServerUploadedFile & File, TArrayView<const uint8> Chunk)> FDTHttpServerUploadChunkHandler;
+
+// 上传完成回调, 在线程池中执行, 请求数据已经释放
+typedef TFunction<FDTHttpServerNativeResponse(const FDTHttpServerNativeRequest & Request, const FDTHttpServerUploadResult & Upload)> FDTHttpServerUploadHandler;
+
+// 请求合并键, 返回相同键的并发 GET 请求只执行一次
+typedef TFunction<FString(const FHttpServerRequest & Request)> FDTHttpServerCoalesceKeyFunction;
+
+// 结构体回调, 请求数据已经解析到 RequestData, 返回数据写到 ResponseData 后序列化, 执行线程由路由的执行方式决定
+typedef TFunction<EHttpServerResponseCodes(const FDTHttpServerNativeRequest & Request, const void * RequestData, void * ResponseData)> FDTHttpServerStructHandler;
@@ -5,43 +5,254 @@
 
 #include "CoreMinimal.h"
 #include "DTHttpServerStruct.h"
+#include "DTHttpServerNative.h"
+#include "DTHttpServerHeaders.h"
 #include "UObject/Object.h"
 #include "HttpServerModule.h"
 #include "IHttpRouter.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Tickable.h"
 #include "DTHttpServerObject.generated.h"
 
+class FDTHttpServerRequestQueue;
+class FDTHttpServerRouter;
+class FDTHttpServerEventStream;
+class FDTHttpServerMetrics;
+class FDTHttpServerRateLimiter;
+class FDTHttpServerCoalescer;
+class FDTHttpServerStaticDirectory;
+struct FDTHttpServerRouteContext;
+
 UCLASS(Blueprintable, BlueprintType, meta=(DisplayName="DT Http Server"))
-class DTHTTPSERVER_API UDTHttpServerObject : public UObject
+class DTHTTPSERVER_API UDTHttpServerObject : public UObject, public FTickableGameObject
 {
 	GENERATED_BODY()
 	
 	DECLARE_DYNAMIC_DELEGATE_RetVal_FourParams(FString, FHttpResponse, const FString &, RelativePath, const FDTHttpServerHeaders &, Headers, const FDTHttpServerParams &, QueryParams, const FString &, Body );
+	DECLARE_DYNAMIC_DELEGATE_RetVal_FourParams(FString, FHttpUploadResponse, const FString &, RelativePath, const FDTHttpServerHeaders &, Headers, const FDTHttpServerParams &, QueryParams, const FDTHttpServerUploadResult &, Upload );
 	
 protected:
-	TArray<FHttpRouteHandle>					m_HttpRouteHandles;
 	TSharedPtr<IHttpRouter>						m_HttpRouter;
+	TSharedPtr<FDTHttpServerRouter>				m_Router;
+	FDelegateHandle								m_RequestHandle;
+	TUniquePtr<FQueuedThreadPool>				m_ThreadPool;
+	FThreadSafeCounter							m_PoolTasks;
+	TSharedPtr<FDTHttpServerRequestQueue, ESPMode::ThreadSafe>	m_RequestQueue;
+	FDTHttpServerQueueStats						m_QueueStats;
+	FDTHttpServerHeaderSetPtr					m_HeaderSet;
+	// 线程池中执行的子请求也会读取返回头
+	mutable FCriticalSection					m_HeaderLock;
+	FDTHttpServerCompressionCachePtr			m_CompressionCache;
+	FDTHttpServerResponseCachePtr				m_ResponseCache;
+	TMap<FString, TSharedPtr<FDTHttpServerEventStream, ESPMode::ThreadSafe>>	m_EventStreams;
+	TSharedPtr<FDTHttpServerMetrics>			m_Metrics;
+	TSharedPtr<FDTHttpServerRateLimiter>		m_RateLimiter;
+	TArray<TSharedPtr<FDTHttpServerCoalescer, ESPMode::ThreadSafe>>	m_Coalescers;
+	TArray<TSharedPtr<FDTHttpServerStaticDirectory, ESPMode::ThreadSafe>>	m_StaticDirectories;
+
+public:
+	// Number of threads in the dedicated pool used by routes with ThreadPool execution, read when the pool is first needed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server")
+	int32 ThreadPoolSize = 4;
+
+	// Game thread time the request queue may use per frame, in microseconds. At least one queued request runs every frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Queue")
+	int32 FrameBudgetMicroseconds = 2000;
+
+	// Queued requests beyond this depth are rejected with 503
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Queue")
+	int32 MaxQueueDepth = 256;
+
+	// Memory kept for compressed copies of response bodies that are served repeatedly, in megabytes. 0 disables the cache
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Compression")
+	int32 CompressionCacheMegabytes = 64;
+
+	// Memory kept for cached GET responses of routes with Cache Response enabled, in megabytes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Cache")
+	int32 ResponseCacheMegabytes = 32;
+
+	// Memory each static directory keeps for small, frequently served files, in megabytes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Static")
+	int32 StaticFileCacheMegabytes = 64;
+
+	// Largest static file response, in megabytes. The engine keeps a whole response body in memory, so larger files can only
+	// be fetched with Range requests: a longer range is answered with its first part (206), a plain GET with 501
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Static")
+	int32 StaticFileMaxResponseMegabytes = 256;
+
+	// Seconds an event stream request is held open without events before it is answered and the client reconnects
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Events")
+	float EventStreamHoldSeconds = 10.0f;
+
+	// Per client limit over all routes of this server, clients are told apart by their address
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="DT Http Server|Rate Limit")
+	FDTHttpServerRateLimit PeerRateLimit;
 
 public:
 	// 开始销毁
 	virtual void BeginDestroy() override;
 
+	// 每帧执行队列中的请求
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual bool IsTickable() const override { return m_HttpRouter.IsValid(); }
+	virtual bool IsTickableInEditor() const override { return false; }
+	virtual bool IsTickableWhenPaused() const override { return true; }
+
 protected:
 	// 开始监听
 	void StartListen(int Port);
-	// 返回跨域查询头
-	TUniquePtr<FHttpServerResponse> CreateHttpServerResponse() const;
+	// 创建带返回头的返回对象
+	TUniquePtr<FHttpServerResponse> CreateHttpServerResponse(const FDTHttpServerHeaderSetPtr& RouteHeaderSet) const;
+	// 使用缓存的返回应答, 没有缓存时返回 false
+	bool ServeCachedResponse(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete, const FDTHttpServerRouteContext& Context) const;
+	// 创建异步返回, 按路由设置和请求的 Accept-Encoding 压缩, 需要缓存时保存返回
+	FDTHttpServerPromise CreatePromise(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete, const FDTHttpServerRouteContext& Context) const;
+	// 在引擎路由前匹配本服务器的路由, 没有匹配时交给引擎路由
+	bool HandleRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete);
+	// 创建路由运行时数据, 包括返回头和统计, bSubRequest 为 false 时不能作为批量请求的子请求
+	TSharedRef<const FDTHttpServerRouteContext, ESPMode::ThreadSafe> MakeRouteContext(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const FDTHttpServerRouteOptions& Options, bool bSubRequest = true);
+	// 绑定路由并登记跨域预检使用的返回头
+	void BindRoute(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const TSharedRef<const FDTHttpServerRouteContext, ESPMode::ThreadSafe>& Context, FDTHttpServerRouteHandler && Handler);
+	// 按执行方式派发任务, 队列已满时返回 false
+	bool Dispatch(EDTHttpServerExecution Execution, EDTHttpServerPriority Priority, TUniqueFunction<void()> && Task);
+	// 绑定上传路由, 上传数据在线程池中写入, 完成后在同一线程中调用 OnUploaded
+	void BindUploadRoute(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FDTHttpServerUploadChunkHandler && ChunkHandler, TFunction<void(const TSharedRef<const FHttpServerRequest, ESPMode::ThreadSafe>&, const FDTHttpServerPathParams&, FDTHttpServerUploadResult&&, const FDTHttpServerPromise&)> && OnUploaded);
+	// 执行批量请求中的一个子请求, 线程安全的 Inline 路由在线程池中并行执行
+	void RunSubRequest(const FHttpServerRequest& Parent, const FDTHttpServerBatchRequest& SubRequest, FHttpResultCallback && OnComplete);
 	
 public:
 	// Per-port-binding access to an http router
 	// Param "Port" : Listening port, range 1-65535
 	UFUNCTION(BlueprintCallable, meta = ( Port=8001 ), Category="DT Http Server")
 	static void CreateHttpServer(int Port, UDTHttpServerObject *& HttpServer);
+
+	// Replaces the response headers used by every route that does not override them
+	// The policy is compiled once and shared by all following responses and CORS preflights
+	// Param "Header Policy" : Content type, cache and CORS headers to send
+	UFUNCTION(BlueprintCallable, Category="DT Http Server")
+	void SetHeaderPolicy(const FDTHttpServerHeaderPolicy& HeaderPolicy);
 	
 	// Binds the caller-supplied Uri to the caller-supplied handler
+	// Param "Http Path" : The respective http path to bind, segments may be ":name" parameters or a trailing "*" wildcard, e.g. /tiles/:z/:x/:y
+	// Param "Http Verbs" : The respective HTTP verbs to bind
+	// Param "Http Response" : The caller-defined closure to execute when the binding is invoked, path parameters are read with Find Http Server Path Params
+	UFUNCTION(BlueprintCallable, Category="DT Http Server")
+	void Bind(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FHttpResponse HttpResponse);
+
+	// Binds the caller-supplied Uri to the caller-supplied handler with per-route options
 	// Param "Http Path" : The respective http path to bind
 	// Param "Http Verbs" : The respective HTTP verbs to bind
+	// Param "Options" : Where the request is processed, the handler itself always executes on the game thread
 	// Param "Http Response" : The caller-defined closure to execute when the binding is invoked
 	UFUNCTION(BlueprintCallable, Category="DT Http Server")
-	void Bind(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FHttpResponse HttpResponse);
+	void BindWithOptions(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const FDTHttpServerRouteOptions& Options, FHttpResponse HttpResponse);
+
+	// Binds the caller-supplied Uri to a native handler that works on raw bytes
+	// The request body is handed over as a view of the connection buffer and the returned body is moved into the response
+	// Param "Http Path" : The respective http path to bind
+	// Param "Http Verbs" : The respective HTTP verbs to bind
+	// Param "Handler" : The native closure to execute when the binding is invoked
+	// Param "Options" : Where the handler runs, only Inline avoids copying the request
+	void BindNative(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FDTHttpServerNativeHandler Handler, const FDTHttpServerRouteOptions& Options = FDTHttpServerRouteOptions());
+
+	// Binds the caller-supplied Uri to a native handler that completes the request later through a promise
+	// The promise can be fulfilled from any thread, the response is always sent from the game thread
+	// Param "Http Path" : The respective http path to bind
+	// Param "Http Verbs" : The respective HTTP verbs to bind
+	// Param "Handler" : The native closure to execute when the binding is invoked
+	// Param "Options" : Where the handler runs
+	void BindNativeAsync(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, FDTHttpServerNativeAsyncHandler Handler, const FDTHttpServerRouteOptions& Options = FDTHttpServerRouteOptions());
+
+	// Binds the caller-supplied Uri to a native handler that works on reflected structs
+	// The JSON request body is parsed straight from the received bytes into the request struct, the response struct is written straight into the response body
+	// Fields are matched case-insensitively, unknown fields are skipped and an invalid body is answered with 400
+	// Param "Http Path" : The respective http path to bind
+	// Param "Http Verbs" : The respective HTTP verbs to bind
+	// Param "Request Type" : The struct the request body is parsed into, an empty body keeps its defaults
+	// Param "Response Type" : The struct the handler fills in
+	// Param "Handler" : The native closure to execute when the binding is invoked, returns the response code
+	// Param "Options" : Where the handler runs, only Inline avoids copying the request
+	void BindStruct(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, const UScriptStruct* RequestType, const UScriptStruct* ResponseType, FDTHttpServerStructHandler Handler, const FDTHttpServerRouteOptions& Options = FDTHttpServerRouteOptions());
+
+	// Typed form of BindStruct, e.g. BindStruct<FTrackUpload, FTrackResult>(TEXT("/track"), EDTHttpServerVerbs::POST, ...)
+	template<typename RequestType, typename ResponseType>
+	void BindStruct(const FString& HttpPath, EDTHttpServerVerbs HttpVerbs, TFunction<EHttpServerResponseCodes(const FDTHttpServerNativeRequest&, const RequestType&, ResponseType&)> Handler, const FDTHttpServerRouteOptions& Options = FDTHttpServerRouteOptions())
+	{
+		if ( !Handler ) { return; }
+		BindStruct(HttpPath, HttpVerbs, RequestType::StaticStruct(), ResponseType::StaticStruct(), [Handler = MoveTemp(Handler)](const FDTHttpServerNativeRequest& Request, const void* RequestData, void* ResponseData)
+		{
+			return Handler(Request, *static_cast<const RequestType*>(RequestData), *static_cast<ResponseType*>(ResponseData));
+		}, Options);
+	}
+
+	// Replaces the key that decides which concurrent GET requests of a route with Coalesce Requests are identical
+	// The default key is the path and the sorted query parameters. Accept-Encoding and conditional headers are always part of the key
+	// Param "Http Path" : The path the route was bound with
+	// Param "Key Function" : Returns the key of a request, called on the game thread
+	void SetCoalesceKeyFunction(const FString& HttpPath, FDTHttpServerCoalesceKeyFunction KeyFunction);
+
+	// Binds an http path that stores uploaded files on disk, accepts multipart/form-data or a raw body
+	// The body is written in chunks on the server's thread pool while its checksum is computed, it is never converted to a string
+	// A raw body is named by the "filename" query parameter or the X-File-Name header
+	// Param "Http Path" : The respective http path to bind
+	// Param "Options" : Target directory, size limits and checksum
+	// Param "Http Response" : Executed on the game thread after all files are written
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Upload")
+	void BindUpload(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FHttpUploadResponse HttpResponse);
+
+	// Binds an http path that receives uploads in a native handler
+	// Param "Http Path" : The respective http path to bind
+	// Param "Options" : Target directory, size limits and checksum
+	// Param "Handler" : Executed on the thread pool after all files are written
+	// Param "Chunk Handler" : Receives the file data in chunks instead of writing files, may be empty
+	void BindUploadNative(const FString& HttpPath, const FDTHttpServerUploadOptions& Options, FDTHttpServerUploadHandler Handler, FDTHttpServerUploadChunkHandler ChunkHandler = nullptr);
+
+	// Drops cached responses so the next request runs the handler again
+	// Param "Http Path" : Request path whose cached responses are dropped for every query string, empty drops all
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Cache")
+	void InvalidateCache(const FString& HttpPath);
+
+	// Serves the files below a disk directory under an url prefix, files are read on the server's thread pool
+	// Supports Range and If-Modified-Since requests, the content type is guessed from the file extension
+	// Files above StaticFileMaxResponseMegabytes are only served to Range requests, a plain GET is answered with 501
+	// Param "Url Prefix" : The http path the directory is mounted at, e.g. /files
+	// Param "Disk Path" : The directory to serve, relative paths start from the project directory
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Static")
+	void BindStaticDirectory(const FString& UrlPrefix, const FString& DiskPath);
+
+	// Binds an http path as a Server-Sent Events stream for EventSource clients
+	// Requests are held until the next event, reconnects resume from Last-Event-ID
+	// Param "Http Path" : The respective http path to bind
+	// Param "Replay Capacity" : Number of recent events kept for clients that reconnect
+	// Param "Retry Milliseconds" : Reconnect delay sent to the clients
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Events", meta=(ReplayCapacity=256, RetryMilliseconds=100))
+	void BindEventStream(const FString& HttpPath, int32 ReplayCapacity = 256, int32 RetryMilliseconds = 100);
+
+	// Publishes an event to every subscriber of an event stream, the event is encoded once and shared by all of them
+	// Param "Http Path" : The path the stream was bound with
+	// Param "Event Name" : The event type, empty sends a default message event
+	// Param "Data" : The event data, multiple lines are allowed
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Events")
+	void PublishEvent(const FString& HttpPath, const FString& EventName, const FString& Data);
+
+	// Binds an http path that runs several requests to the other routes of this server in one round-trip
+	// The body is a JSON array of { "verb", "path", "query", "headers", "body" }, the response is an array of { "status", "headers", "body" } in the same order
+	// Sub-requests are started together, routes marked Thread Safe run in parallel on the server's thread pool
+	// Param "Http Path" : The respective http path to bind
+	// Param "Max Sub Requests" : Larger batches are rejected with 413
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Batch", meta=(HttpPath="/batch", MaxSubRequests=64))
+	void BindBatch(const FString& HttpPath = TEXT("/batch"), int32 MaxSubRequests = 64);
+
+	// Exposes per-route request counts, byte totals, status classes and latency percentiles in Prometheus text format
+	// The same counters are published in the DTHttpServer stat group
+	// Param "Http Path" : The respective http path to bind
+	UFUNCTION(BlueprintCallable, Category="DT Http Server|Metrics", meta=(HttpPath="/metrics"))
+	void BindMetrics(const FString& HttpPath = TEXT("/metrics"));
+
+	// Returns the game thread request queue usage
+	UFUNCTION(BlueprintPure, Category="DT Http Server|Queue")
+	FDTHttpServerQueueStats GetQueueStats() const;
 	
 };
@@ -17,18 +17,357 @@ enum class EDTHttpServerVerbs : uint8
 	DELETE,
 };
 
+UENUM(BlueprintType)
+enum class EDTHttpServerExecution : uint8
+{
+	// Run the handler directly inside the router callback on the game thread
+	Inline,
+	// Run the handler on a task graph background worker
+	TaskGraph,
+	// Run the handler on the server's dedicated thread pool
+	ThreadPool,
+	// Queue the handler and run it on the game thread within the server's per-frame time budget
+	Queued,
+};
+
+UENUM(BlueprintType)
+enum class EDTHttpServerPriority : uint8
+{
+	High,
+	Normal,
+	Low,
+};
+
+UENUM(BlueprintType)
+enum class EDTHttpServerChecksum : uint8
+{
+	None,
+	CRC32,
+	SHA1,
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Header Policy"))
+struct FDTHttpServerHeaderPolicy
+{
+	GENERATED_BODY()
+
+	// Content-Type sent when the handler does not set one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers")
+	FString ContentType = TEXT("application/json;charset=utf-8");
+
+	// Cache-Control sent with every response, omitted when empty
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers")
+	FString CacheControl;
+
+	// Answer CORS preflights and add Access-Control-Allow-Origin to responses
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers")
+	bool bEnableCors = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers", meta=(EditCondition="bEnableCors"))
+	FString AllowOrigin = TEXT("*");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers", meta=(EditCondition="bEnableCors"))
+	FString AllowMethods = TEXT("GET,POST,PUT,PATCH,DELETE,OPTIONS");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers", meta=(EditCondition="bEnableCors"))
+	FString AllowHeaders = TEXT("Origin,X-Requested-With,Content-Type,Accept");
+
+	// Seconds a browser may cache the preflight result
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers", meta=(EditCondition="bEnableCors"))
+	int32 MaxAge = 600;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers", meta=(EditCondition="bEnableCors"))
+	bool bAllowCredentials = true;
+
+	// Additional headers sent with every response
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Headers")
+	TMap<FString, FString> ExtraHeaders;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Rate Limit"))
+struct FDTHttpServerRateLimit
+{
+	GENERATED_BODY()
+
+	// Requests beyond the limit are answered with 429 before the handler runs
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server")
+	bool bEnabled = false;
+
+	// Tokens added to each client's bucket per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server", meta=(EditCondition="bEnabled", ClampMin=0))
+	float RequestsPerSecond = 10.0f;
+
+	// Bucket size, the number of requests a client may send at once
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server", meta=(EditCondition="bEnabled", ClampMin=1))
+	int32 Burst = 20;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Route Options"))
+struct FDTHttpServerRouteOptions
+{
+	GENERATED_BODY()
+
+	// Where the handler runs. Blueprint handlers always execute on the game thread, only the body conversion moves to the worker
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server")
+	EDTHttpServerExecution Execution = EDTHttpServerExecution::Inline;
+
+	// Order in the game thread queue, higher priorities are drained first
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server")
+	EDTHttpServerPriority Priority = EDTHttpServerPriority::Normal;
+
+	// Use HeaderPolicy for this route instead of the server's header policy
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server")
+	bool bOverrideHeaderPolicy = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server", meta=(EditCondition="bOverrideHeaderPolicy"))
+	FDTHttpServerHeaderPolicy HeaderPolicy;
+
+	// Compress responses with gzip or deflate when the client accepts it. Compression runs on a worker thread
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Compression")
+	bool bCompressResponse = true;
+
+	// Responses smaller than this are sent uncompressed, in bytes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Compression", meta=(EditCondition="bCompressResponse", ClampMin=1))
+	int32 CompressMinBytes = 1024;
+
+	// Cache GET responses by path and query parameters. Cached responses carry a strong ETag and
+	// are answered with 304 when the client already has them, without running the handler
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Cache")
+	bool bCacheResponse = false;
+
+	// Seconds a cached response stays valid, 0 keeps it until Invalidate Cache is called
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Cache", meta=(EditCondition="bCacheResponse", ClampMin=0))
+	float CacheTtlSeconds = 1.0f;
+
+	// Per client limit for this route, counted separately from the server's per client limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Rate Limit")
+	FDTHttpServerRateLimit RateLimit;
+
+	// Identical GET requests that arrive while the first one is still running wait for it and share its response
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Coalesce")
+	bool bCoalesceRequests = false;
+
+	// Seconds a request waits for an identical running request before running the handler itself
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Coalesce", meta=(EditCondition="bCoalesceRequests", ClampMin=0))
+	float CoalesceMaxWaitSeconds = 5.0f;
+
+	// Request headers that tell identical requests apart besides path and query, e.g. Authorization
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Coalesce", meta=(EditCondition="bCoalesceRequests"))
+	TArray<FString> CoalesceKeyHeaders;
+
+	// The native handler may run on any thread, several at a time. Batched requests to thread safe Inline routes
+	// run in parallel on the server's thread pool. Ignored for Blueprint handlers
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Batch")
+	bool bThreadSafe = false;
+};
+
+// 批量请求中的子请求
+USTRUCT()
+struct FDTHttpServerBatchRequest
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FString Verb = TEXT("GET");
+
+	// 请求路径, 可以带查询字符串
+	UPROPERTY()
+	FString Path;
+
+	UPROPERTY()
+	TMap<FString, FString> Query;
+
+	// 覆盖外层请求的头
+	UPROPERTY()
+	TMap<FString, FString> Headers;
+
+	// 字符串按原样发送, 对象或数组发送其 JSON 文本
+	UPROPERTY()
+	FString Body;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Upload Options"))
+struct FDTHttpServerUploadOptions
+{
+	GENERATED_BODY()
+
+	// Directory the uploaded files are written to, relative paths start from the project's Saved directory
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Upload")
+	FString Directory = TEXT("Uploads");
+
+	// Larger request bodies are rejected with 413 before anything is written, in megabytes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Upload", meta=(ClampMin=1))
+	int32 MaxMegabytes = 1024;
+
+	// Multipart requests with more files are rejected with 413
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Upload", meta=(ClampMin=1))
+	int32 MaxFiles = 16;
+
+	// Checksum computed while the data is written
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Upload")
+	EDTHttpServerChecksum Checksum = EDTHttpServerChecksum::CRC32;
+
+	// Replace files with the same name, otherwise a number is appended to the new file
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DT Http Server|Upload")
+	bool bOverwrite = false;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Uploaded File"))
+struct FDTHttpServerUploadedFile
+{
+	GENERATED_BODY()
+
+	// Form field of a multipart upload, empty for a raw upload
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	FString FieldName;
+
+	// File name sent by the client
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	FString FileName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	FString ContentType;
+
+	// Where the file was written, empty when the data went to a chunk handler
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	FString SavedPath;
+
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	int64 Bytes = 0;
+
+	// Lowercase hex checksum of the data, empty when disabled
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	FString Checksum;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Upload Result"))
+struct FDTHttpServerUploadResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	TArray<FDTHttpServerUploadedFile> Files;
+
+	// Multipart form fields without a file name
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Upload")
+	TMap<FString, FString> Fields;
+};
+
+USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Queue Stats"))
+struct FDTHttpServerQueueStats
+{
+	GENERATED_BODY()
+
+	// Requests waiting in the game thread queue
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int32 QueueDepth = 0;
+
+	// Highest queue depth seen since the server started
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int32 PeakQueueDepth = 0;
+
+	// Requests executed during the last tick
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int32 ProcessedLastFrame = 0;
+
+	// Requests left over for the next frame after the last tick
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int32 CarriedOver = 0;
+
+	// Time spent draining the queue during the last tick, in microseconds
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	float LastFrameMicroseconds = 0.f;
+
+	// Share of the frame budget used during the last tick, can exceed 1 when a single handler overruns
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	float BudgetUsage = 0.f;
+
+	// Longest time a request executed during the last tick waited in the queue, in microseconds
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	float MaxWaitMicroseconds = 0.f;
+
+	// Requests executed since the server started
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int64 TotalProcessed = 0;
+
+	// Requests rejected with 503 because the queue was full
+	UPROPERTY(BlueprintReadOnly, Category = "DT Http Server|Queue")
+	int64 TotalRejected = 0;
+};
+
+struct FHttpServerRequest;
+
+// 路径参数, 只记录参数在路径中的位置, 查找时返回路径上的视图
+struct DTHTTPSERVER_API FDTHttpServerPathParams
+{
+	typedef TArray<TPair<int32, int32>, TInlineAllocator<4>> FRanges;
+
+	// 请求路径, 只有存在参数或剩余路径时才保存
+	FString													Path;
+	// 参数名, 由路由模板编译生成, 所有请求共享
+	TSharedPtr<const TArray<FString>, ESPMode::ThreadSafe>	Names;
+	// 参数在路径中的起点和长度, 与参数名一一对应
+	FRanges												Ranges;
+	// 路由没有匹配的剩余路径的起点和长度
+	TPair<int32, int32>										Remainder { 0, 0 };
+
+	// 参数数量
+	int32 Num() const { return Ranges.Num(); }
+
+	// 参数名
+	FStringView GetName(int32 Index) const { return (*Names)[Index]; }
+
+	// 参数值
+	FStringView GetValue(int32 Index) const { return FStringView(Path).Mid(Ranges[Index].Key, Ranges[Index].Value); }
+
+	// 路由没有匹配的剩余路径, 以 / 开头, 完全匹配时为空
+	FStringView GetRemainder() const { return FStringView(Path).Mid(Remainder.Key, Remainder.Value); }
+
+	// 查找参数
+	bool Find(FStringView Name, FStringView & Value) const;
+};
+
+// 请求视图, 只在回调执行期间指向请求, 执行结束后失效, 之后的查找只会得到空值
+struct FDTHttpServerRequestView
+{
+	const FHttpServerRequest *									Request = nullptr;
+	TSharedPtr<const FHttpServerRequest, ESPMode::ThreadSafe>	OwnedRequest;
+	FDTHttpServerPathParams										PathParams;
+
+	// 执行结束后失效
+	void Reset()
+	{
+		Request = nullptr;
+		OwnedRequest.Reset();
+		PathParams = FDTHttpServerPathParams();
+	}
+};
+
+typedef TSharedPtr<FDTHttpServerRequestView, ESPMode::ThreadSafe> FDTHttpServerRequestViewPtr;
+
+// 查询参数视图, 查找时才读取请求中的参数
 USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Params", HasNativeBreak = "DTHttpServer.DTHttpServerBPLib.BreakParams"))
-struct FDTHttpServerParams
+struct DTHTTPSERVER_API FDTHttpServerParams
 {
 	GENERATED_BODY()
-	TMap<FString, FString> Params;
+	FDTHttpServerRequestViewPtr View;
+
+	// 查找参数, 不拷贝
+	const FString * Find(const FString & Key) const;
+
+	// 查找路径参数, 返回路径上的视图
+	bool FindPathParam(FStringView Key, FStringView & Value) const;
 };
 
+// 请求头视图, 查找时才读取请求中的头
 USTRUCT(BlueprintType, meta=(DisplayName="DT Http Server Headers", HasNativeBreak = "DTHttpServer.DTHttpServerBPLib.BreakHeaders"))
-struct FDTHttpServerHeaders
+struct DTHTTPSERVER_API FDTHttpServerHeaders
 {
 	GENERATED_BODY()
-	TMap<FString, FString> Headers;
+	FDTHttpServerRequestViewPtr View;
+
+	// 查找头, 不拷贝
+	const TArray<FString> * Find(const FString & Key) const;
 };
 
 UCLASS(NotBlueprintable, NotBlueprintType, meta=(DisplayName="DT Http Server BP Library"))
@@ -44,6 +383,10 @@ public:
 	// Find DT Http Server Params
 	UFUNCTION(BlueprintPure, meta = (DisplayName="Find Http Server Params"), Category = "DT Http Server|Params")
 	static void FindParam(const FDTHttpServerParams& HttpServerParams, const FString & Key, FString & Param );
+
+	// Find a parameter captured by a :name or * segment of the bound path
+	UFUNCTION(BlueprintPure, meta = (DisplayName="Find Http Server Path Params"), Category = "DT Http Server|Params")
+	static void FindPathParam(const FDTHttpServerParams& HttpServerParams, const FString & Key, FString & Param );
 	
 	// Break DT Http Server Headers
 	UFUNCTION(BlueprintPure, meta = (DisplayName="Break Http Server Headers"), Category = "DT Http Server|Headers")
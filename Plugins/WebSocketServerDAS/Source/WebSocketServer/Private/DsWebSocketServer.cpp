@@ -4,9 +4,6 @@
 #include "DsWebSocketServer.h"
 #include "Containers/Ticker.h"
 #include "IPAddress.h"
-#include "IWebSocketNetworkingModule.h"
-#include "WebSocketNetworkingDelegates.h"
-#include <string>
 #include "Runtime/Core/Public/Misc/CString.h"
 
 
@@ -34,135 +31,146 @@ UDsWebSocketServer::~UDsWebSocketServer()
 	Stop();
 }
 
-
-
-bool UDsWebSocketServer::Start(int Port)
+void UDsWebSocketServer::BeginDestroy()
 {
-	FWebSocketClientConnectedCallBack CallBack;
-	CallBack.BindUObject(this, &UDsWebSocketServer::OnWebSocketClientConnected);
+	// the network thread and the socket callbacks point into this object, they have to stop before it is finished
+	Stop();
+	Super::BeginDestroy();
+}
 
-	Server = FModuleManager::Get().LoadModuleChecked<IWebSocketNetworkingModule>(TEXT("WebSocketNetworking")).CreateServer();
 
-	if (!Server || !Server->Init(Port, CallBack))
-	{
-		Server.Reset();
-		return false;
-	}
 
-	return true;
+bool UDsWebSocketServer::Start(int Port)
+{
+	return Core.Start(Port, bUseNetworkThread ? NetworkTickRate : 0);
 }
 
 void UDsWebSocketServer::Stop()
 {
-	if (IsRunning()) {
-		Server.Reset();
-	}
+	Core.Stop();
 }
 
 bool UDsWebSocketServer::WebSocketServerTick(float DeltaTime)
 {
-	if (IsRunning()) {
-		Server->Tick();
-		return true;
-	}
-	else {
-		return false;
-	}
+	return Core.Tick(SendQueueSettings);
 }
 
-void UDsWebSocketServer::Send(const FGuid& InTargetClientId, const TArray<uint8>& InUTF8Payload)
+void UDsWebSocketServer::OnClientConnected(const FString& ClientId)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([&InTargetClientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id == InTargetClientId; }))
-	{
-		Connection->Socket->Send(InUTF8Payload.GetData(), InUTF8Payload.Num(), /*PrependSize=*/false);
-	}
+	_DebugLog("----OnWebSocketClientConnected " + ClientId, 10, FColor::Red);
+	//有新客户端连接 delegate
+	WsClientOnConnected.Broadcast(ClientId);
 }
 
-void UDsWebSocketServer::Send(const FString msg)
+void UDsWebSocketServer::OnClientClosed(const FString& ClientId)
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	_DebugLog("----OnSocketClose " + ClientId, 10, FColor::Red);
+	WsClientOnClosed.Broadcast(ClientId);
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
+void UDsWebSocketServer::OnClientDisconnected(const FString& ClientId)
+{
+	_DebugLog("----Send queue overflow, disconnect " + ClientId, 10, FColor::Red);
+	WsClientOnClosed.Broadcast(ClientId);
+}
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
+void UDsWebSocketServer::OnClientMessage(FWebSocketClientHandle Client, const TArray<uint8>& Data)
+{
+	//收到数据 delegate, 没有蓝图监听时不查找 ID
+	if (WsClientOnRawMessage.IsBound())
+	{
+		WsClientOnRawMessage.Broadcast(Data, Data.Num(), Core.GetClientId(Client));
 	}
 }
 
+void UDsWebSocketServer::Send(const FGuid& InTargetClientId, const TArray<uint8>& InUTF8Payload)
+{
+	Core.SendEncoded(InTargetClientId, FWebSocketMessage::FromBytes(InUTF8Payload));
+}
 
-void UDsWebSocketServer::SendBytesToClientId(const FString clientId, const TArray<uint8>& uint8Array)
+void UDsWebSocketServer::SendEncoded(const FGuid& InTargetClientId, const FWebSocketMessageRef& Message)
 {
-	//for (auto& ws : Connections) {
-	//	if (ws->getId() == clientId)
-	//		ws->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	//}
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientId; }))
-	{
-		Connection->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+	Core.SendEncoded(InTargetClientId, Message);
 }
 
+void UDsWebSocketServer::SendEncoded(FWebSocketClientHandle Client, const FWebSocketMessageRef& Message)
+{
+	Core.SendEncoded(Client, Message);
+}
 
-void UDsWebSocketServer::SendToClientId(const FString clientId, const FString msg)
+FString UDsWebSocketServer::GetClientId(FWebSocketClientHandle Client) const
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	return Core.GetClientId(Client);
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
+void UDsWebSocketServer::PublishEncoded(const FString& Topic, const FWebSocketMessageRef& Message)
+{
+	Core.PublishEncoded(Topic, Message);
+}
 
-	//for (auto& ws : Connections) {
-	//	if (ws->Id.ToString() == clientId)
-	//		ws->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	//}
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientId; }))
-	{
-		Connection->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void UDsWebSocketServer::publishEntity(FString topic, FString key, double longitude, double latitude, FString jsonValue)
+{
+	Core.PublishEntity(topic, key, longitude, latitude, jsonValue);
+}
 
+void UDsWebSocketServer::removeEntity(FString topic, FString key)
+{
+	Core.RemoveEntity(topic, key);
 }
 
+void UDsWebSocketServer::publish(FString topic, FString msg)
+{
+	Core.PublishEncoded(topic, FWebSocketMessage::FromString(msg));
+}
 
-void UDsWebSocketServer::SendBytesToAllClients(const TArray<uint8>& uint8Array)
+void UDsWebSocketServer::publishBytes(FString topic, const TArray<uint8>& uint8Array)
 {
+	Core.PublishEncoded(topic, FWebSocketMessage::FromBytes(uint8Array));
+}
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void UDsWebSocketServer::SendEncodedToAllClients(const FWebSocketMessageRef& Message)
+{
+	Core.SendEncodedToAllClients(Message);
+}
 
+void UDsWebSocketServer::Send(const FString msg)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromString(msg));
 }
 
 
-void UDsWebSocketServer::SendToAllClients(const FString msg)
+void UDsWebSocketServer::SendBytesToClientId(const FString clientId, const TArray<uint8>& uint8Array)
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	Core.SendEncoded(clientId, FWebSocketMessage::FromBytes(uint8Array));
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void UDsWebSocketServer::SendToClientId(const FString clientId, const FString msg)
+{
+	Core.SendEncoded(clientId, FWebSocketMessage::FromString(msg));
 }
 
 
+void UDsWebSocketServer::SendBytesToAllClients(const TArray<uint8>& uint8Array)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromBytes(uint8Array));
+}
 
 
+void UDsWebSocketServer::SendToAllClients(const FString msg)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromString(msg));
+}
 
+void UDsWebSocketServer::publishState(FString topic, FString key, FString jsonValue)
+{
+	Core.PublishState(topic, key, jsonValue);
+}
 
 
 bool UDsWebSocketServer::IsRunning() const
 {
-	return !!Server;
+	return Core.IsRunning();
 }
 
 void UDsWebSocketServer::_DebugLog(FString msg, float delayTime, FColor color)
@@ -173,106 +181,65 @@ void UDsWebSocketServer::_DebugLog(FString msg, float delayTime, FColor color)
 }
 
 
-void UDsWebSocketServer::OnClientSocketError(INetworkingWebSocket* Socket)
+int UDsWebSocketServer::getClientCount()
 {
-
+	return Core.NumClients();
 }
 
-void UDsWebSocketServer::OnWebSocketClientConnected(INetworkingWebSocket* Socket)
-{
-	_DebugLog("----OnWebSocketClientConnected ", 10, FColor::Red);
-	if (ensureMsgf(Socket, TEXT("Socket was null while creating a new websocket connection.")))
-	{
-		FWebSocketConnection Connection = FWebSocketConnection{ Socket };
-
-		FWebSocketPacketReceivedCallBack ReceiveCallBack;
-		ReceiveCallBack.BindUObject(this, &UDsWebSocketServer::ReceivedRawPacket, Connection.Id);
-		Socket->SetReceiveCallBack(ReceiveCallBack);
-
-		FWebSocketInfoCallBack CloseCallback;
-		CloseCallback.BindUObject(this, &UDsWebSocketServer::OnSocketClose, Socket);
-		Socket->SetSocketClosedCallBack(CloseCallback);
-
-		FWebSocketInfoCallBack ErrorCallBack;
-		ErrorCallBack.BindUObject(this, &UDsWebSocketServer::OnClientSocketError, Socket);
-		Socket->SetErrorCallBack(ErrorCallBack);
-
 
-		Connections.Add(MoveTemp(Connection));
-
-		//有新客户端连接 delegate
-		WsClientOnConnected.Broadcast(Connection.Id.ToString());
-	}
+TArray<FString> UDsWebSocketServer::getClients()
+{
+	return Core.GetClientIds();
 }
 
-void UDsWebSocketServer::ReceivedRawPacket(void* Data, int32 Size, FGuid ClientId)
+void UDsWebSocketServer::setClientNameById(FString clientid, FString name)
 {
-	TArrayView<uint8> dataArrayView = MakeArrayView(static_cast<uint8*>(Data), Size);
-	const std::string cstr(reinterpret_cast<const char*>(
-		dataArrayView.GetData()),
-		dataArrayView.Num());
-	//FString frameAsFString = UTF8_TO_TCHAR(cstr.c_str());
-	//OnH5MsgCallback(frameAsFString);
-
-
-	TArray<uint8> bytesArray;
-	bytesArray.Append((uint8*)Data, Size);
-
-	//收到数据 delegate
-	WsClientOnRawMessage.Broadcast(bytesArray, Size, ClientId.ToString());
+	Core.SetClientName(clientid, name);
 }
 
-
-void UDsWebSocketServer::OnSocketClose(INetworkingWebSocket* Socket)
+void UDsWebSocketServer::setClientBackpressureById(FString clientid, EWebSocketBackpressurePolicy policy)
 {
-	int32 Index = Connections.IndexOfByPredicate([Socket](const FWebSocketConnection& Connection) { return Connection.Socket == Socket; });
-
-	_DebugLog("----OnSocketClose " + FString::FromInt(Index), 10, FColor::Red);
-	if (Index != INDEX_NONE)
-	{
-		//OnConnectionClosed().Broadcast(Connections[Index].Id);
-		WsClientOnClosed.Broadcast(Connections[Index].Id.ToString());
-		Connections.RemoveAtSwap(Index);
-	}
+	Core.SetClientBackpressure(clientid, policy);
 }
 
+bool UDsWebSocketServer::subscribeClient(FString clientid, FString pattern)
+{
+	return Core.Subscribe(clientid, pattern);
+}
 
+bool UDsWebSocketServer::unsubscribeClient(FString clientid, FString pattern)
+{
+	return Core.Unsubscribe(clientid, pattern);
+}
 
-
-int UDsWebSocketServer::getClientCount()
+bool UDsWebSocketServer::setClientInterestArea(FString clientid, double minLongitude, double minLatitude, double maxLongitude, double maxLatitude)
 {
+	return Core.SetInterestArea(clientid, minLongitude, minLatitude, maxLongitude, maxLatitude);
+}
 
-	return Connections.Num();
+bool UDsWebSocketServer::clearClientInterestArea(FString clientid)
+{
+	return Core.ClearInterestArea(clientid);
 }
 
+int UDsWebSocketServer::getClientVisibleEntityCount(FString clientid)
+{
+	return Core.NumVisibleEntities(clientid);
+}
 
-TArray<FString> UDsWebSocketServer::getClients()
+int UDsWebSocketServer::getTopicSubscriberCount(FString topic)
 {
-	TArray<FString> result;
-	for (int i = 0; i < Connections.Num(); i++)
-	{
-		result.Add(Connections[i].Id.ToString());
-	}
-	return result;
+	return Core.NumSubscribers(topic);
 }
 
-void UDsWebSocketServer::setClientNameById(FString clientid, FString name)
+int UDsWebSocketServer::getClientQueueLength(FString clientid)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientid](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientid; }))
-	{
-		Connection->clientName = name;
-	}
+	return Core.GetQueueLength(clientid);
 }
 
 FString UDsWebSocketServer::getClientIdByName(FString name)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([name](const FWebSocketConnection& InConnection)
-		{ return InConnection.clientName == name; }))
-	{
-		return Connection->Id.ToString();
-	}
-	return FString(TEXT(""));
+	return Core.FindClientIdByName(name);
 }
 
 
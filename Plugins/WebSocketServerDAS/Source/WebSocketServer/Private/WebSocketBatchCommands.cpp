@@ -0,0 +1,287 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketBatchFrame.h"
+#include "WebSocketSendQueue.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+#include "Math/RandomStream.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+namespace
+{
+	bool IsSameMessage(const TArray<uint8>& Expected, TArrayView<const uint8> Message)
+	{
+		return Expected.Num() == Message.Num() && FMemory::Memcmp(Expected.GetData(), Message.GetData(), Message.Num()) == 0;
+	}
+
+	TArray<TArray<uint8>> MakeMessages(FRandomStream& Random, int32 Count, int32 MinSize, int32 MaxSize)
+	{
+		TArray<TArray<uint8>> Result;
+		Result.SetNum(Count);
+		for (TArray<uint8>& Message : Result)
+		{
+			Message.SetNumUninitialized(Random.RandRange(MinSize, MaxSize));
+			for (uint8& Byte : Message)
+			{
+				Byte = uint8(Random.RandRange(0, 255));
+			}
+		}
+		return Result;
+	}
+
+	/** Pumps Messages through a send queue and splits the frames it writes, every message has to come out once and in order. */
+	bool RoundTripQueue(const TArray<TArray<uint8>>& Messages, const FWebSocketSendQueueSettings& Settings, FString& OutError)
+	{
+		FWebSocketSendQueue Queue;
+		for (const TArray<uint8>& Message : Messages)
+		{
+			Queue.Enqueue(FWebSocketMessage::FromBytes(Message), Settings);
+		}
+
+		const int64 MaxBytes = int64(Settings.BatchMaxKilobytes) * 1024;
+		TArray<uint8> Scratch;
+		int32 Received = 0;
+		bool bOk = true;
+		while (bOk && Queue.Num() > 0)
+		{
+			Queue.Pump([&](TArrayView<const uint8> Frame) {
+				int32 InFrame = 0;
+				const bool bSplit = FWebSocketBatchFrame::Split(Frame, [&](TArrayView<const uint8> Message) {
+					bOk &= Messages.IsValidIndex(Received) && IsSameMessage(Messages[Received], Message);
+					++Received;
+					++InFrame;
+				});
+				if (!bSplit)
+				{
+					OutError = TEXT("the queue wrote a frame that is not a container");
+					bOk = false;
+				}
+				else if (Frame.Num() > MaxBytes && InFrame > 1)
+				{
+					OutError = FString::Printf(TEXT("a container of %d messages exceeds the size cap"), InFrame);
+					bOk = false;
+				}
+			}, Settings, Scratch, FPlatformTime::Seconds());
+		}
+
+		if (bOk && Received != Messages.Num())
+		{
+			OutError = FString::Printf(TEXT("%d of %d messages came out of the queue"), Received, Messages.Num());
+			bOk = false;
+		}
+		else if (!bOk && OutError.IsEmpty())
+		{
+			OutError = FString::Printf(TEXT("message %d came out changed or out of order"), Received - 1);
+		}
+		return bOk;
+	}
+
+	void RunSelfTest()
+	{
+		FRandomStream Random(0x5742);
+		FString Error;
+		bool bOk = true;
+
+		// containers written and split directly, empty messages included
+		for (int32 Round = 0; bOk && Round < 200; ++Round)
+		{
+			const TArray<TArray<uint8>> Messages = MakeMessages(Random, Random.RandRange(0, 64), 0, 300);
+			TArray<uint8> Frame;
+			FWebSocketBatchFrame::Begin(Frame);
+			for (const TArray<uint8>& Message : Messages)
+			{
+				FWebSocketBatchFrame::Append(Frame, Message);
+			}
+
+			int32 Index = 0;
+			bOk = FWebSocketBatchFrame::Split(Frame, [&](TArrayView<const uint8> Message) {
+				bOk &= Messages.IsValidIndex(Index) && IsSameMessage(Messages[Index], Message);
+				++Index;
+			}) && bOk && Index == Messages.Num();
+
+			// a truncated container is rejected as a whole
+			if (bOk && Frame.Num() > FWebSocketBatchFrame::HeaderSize)
+			{
+				bOk = !FWebSocketBatchFrame::IsBatch(TArrayView<const uint8>(Frame.GetData(), Frame.Num() - 1));
+			}
+			if (!bOk)
+			{
+				Error = FString::Printf(TEXT("container round %d did not round-trip"), Round);
+			}
+		}
+
+		// plain text is never a container
+		if (bOk)
+		{
+			const FTCHARToUTF8 Text(TEXT("{\"subscribe\":\"tracks/*\"}"));
+			bOk = !FWebSocketBatchFrame::IsBatch(TArrayView<const uint8>(reinterpret_cast<const uint8*>(Text.Get()), Text.Length()));
+			if (!bOk)
+			{
+				Error = TEXT("a text message was taken for a container");
+			}
+		}
+
+		// the batching send queue, with messages above the size cap
+		if (bOk)
+		{
+			FWebSocketSendQueueSettings Settings;
+			Settings.bBatchMessages = true;
+			Settings.BatchMaxKilobytes = 1;
+			Settings.HighWaterMessages = MAX_int32;
+			Settings.HighWaterKilobytes = MAX_int32 / 1024;
+			TArray<TArray<uint8>> Messages = MakeMessages(Random, 2000, 60, 200);
+			Messages.Append(MakeMessages(Random, 8, 1500, 4000));
+			bOk = RoundTripQueue(Messages, Settings, Error);
+		}
+
+		if (bOk)
+		{
+			UE_LOG(LogTemp, Log, TEXT("WebSocketServer.BatchSelfTest passed"));
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("WebSocketServer.BatchSelfTest failed: %s"), *Error);
+		}
+	}
+
+	/** Size of a server frame's web socket header. */
+	int32 GetFrameHeaderSize(int32 PayloadSize)
+	{
+		return PayloadSize < 126 ? 2 : (PayloadSize < 65536 ? 4 : 10);
+	}
+
+	struct FBenchmarkResult
+	{
+		int64 Frames = 0;
+		double Seconds = 0.0;
+	};
+
+	/**
+	 * Writes every frame the queue produces to a loopback TCP connection, one send per frame like the engine socket,
+	 * while a reader thread drains the other end.
+	 */
+	bool RunBenchmarkPass(const TArray<FWebSocketMessageRef>& Pool, int32 NumMessages, int32 MessagesPerTick, const FWebSocketSendQueueSettings& Settings, FBenchmarkResult& OutResult)
+	{
+		ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+		Address->SetLoopbackAddress();
+		Address->SetPort(0);
+
+		FSocket* Listener = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("WebSocketBatchBenchmark"), Address->GetProtocolType());
+		FSocket* Writer = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("WebSocketBatchBenchmark"), Address->GetProtocolType());
+		FSocket* Reader = nullptr;
+		if (Listener && Writer && Listener->Bind(*Address) && Listener->Listen(1))
+		{
+			Listener->GetAddress(*Address);
+			if (Writer->Connect(*Address))
+			{
+				Reader = Listener->Accept(TEXT("WebSocketBatchBenchmark"));
+			}
+		}
+		if (!Reader)
+		{
+			SocketSubsystem->DestroySocket(Writer);
+			SocketSubsystem->DestroySocket(Listener);
+			return false;
+		}
+		Writer->SetNoDelay(true);
+
+		// the reader stops once the writer closes its end
+		TFuture<void> Drain = Async(EAsyncExecution::Thread, [Reader]() {
+			TArray<uint8> Buffer;
+			Buffer.SetNumUninitialized(256 * 1024);
+			int32 BytesRead = 0;
+			while (Reader->Recv(Buffer.GetData(), Buffer.Num(), BytesRead) && BytesRead > 0)
+			{
+			}
+		});
+
+		FWebSocketSendQueue Queue;
+		TArray<uint8> Scratch;
+		TArray<uint8> Wire;
+		int64 Frames = 0;
+		bool bOk = true;
+		auto Write = [&](TArrayView<const uint8> Frame) {
+			Wire.SetNumUninitialized(GetFrameHeaderSize(Frame.Num()), false);
+			Wire.Append(Frame.GetData(), Frame.Num());
+			int32 Offset = 0;
+			while (bOk && Offset < Wire.Num())
+			{
+				int32 BytesSent = 0;
+				bOk = Writer->Send(Wire.GetData() + Offset, Wire.Num() - Offset, BytesSent);
+				Offset += BytesSent;
+			}
+			++Frames;
+		};
+
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Sent = 0; bOk && Sent < NumMessages; )
+		{
+			// one server tick worth of messages, then everything queued is written
+			for (int32 Index = 0; Index < MessagesPerTick && Sent < NumMessages; ++Index, ++Sent)
+			{
+				Queue.Enqueue(Pool[Sent % Pool.Num()], Settings);
+			}
+			while (bOk && Queue.Num() > 0)
+			{
+				Queue.Pump(Write, Settings, Scratch, FPlatformTime::Seconds());
+			}
+		}
+		OutResult.Frames = Frames;
+		OutResult.Seconds = FPlatformTime::Seconds() - Start;
+
+		Writer->Shutdown(ESocketShutdownMode::Write);
+		Drain.Wait();
+		SocketSubsystem->DestroySocket(Reader);
+		SocketSubsystem->DestroySocket(Writer);
+		SocketSubsystem->DestroySocket(Listener);
+		return bOk;
+	}
+
+	void RunBenchmark(const TArray<FString>& Args)
+	{
+		const int32 NumMessages = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 200000;
+		const int32 BatchKilobytes = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 16;
+		const int32 MessagesPerTick = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 1000;
+
+		// 60 to 200 byte messages, as sent by state streams
+		FRandomStream Random(0x5742);
+		TArray<FWebSocketMessageRef> Pool;
+		for (TArray<uint8>& Message : MakeMessages(Random, 256, 60, 200))
+		{
+			Pool.Add(FWebSocketMessage::FromBytes(MoveTemp(Message)));
+		}
+
+		FWebSocketSendQueueSettings Settings;
+		Settings.Policy = EWebSocketBackpressurePolicy::Block;
+		Settings.HighWaterMessages = MAX_int32;
+		Settings.HighWaterKilobytes = MAX_int32 / 1024;
+		Settings.BatchMaxKilobytes = BatchKilobytes;
+
+		for (const bool bBatch : { false, true })
+		{
+			Settings.bBatchMessages = bBatch;
+			FBenchmarkResult Result;
+			if (!RunBenchmarkPass(Pool, NumMessages, MessagesPerTick, Settings, Result))
+			{
+				UE_LOG(LogTemp, Error, TEXT("WebSocketServer.BatchBenchmark could not write to a loopback connection"));
+				return;
+			}
+			const double Seconds = FMath::Max(Result.Seconds, 1e-9);
+			UE_LOG(LogTemp, Log, TEXT("WebSocketServer.BatchBenchmark %s: %d messages in %lld frames, %.3f s, %.0f frames/s, %.0f messages/s"),
+				bBatch ? TEXT("batched") : TEXT("unbatched"), NumMessages, Result.Frames, Result.Seconds, Result.Frames / Seconds, NumMessages / Seconds);
+		}
+	}
+}
+
+static FAutoConsoleCommand WebSocketBatchSelfTestCommand(
+	TEXT("WebSocketServer.BatchSelfTest"),
+	TEXT("Round-trips messages through the container frame format and the batching send queue."),
+	FConsoleCommandDelegate::CreateStatic(&RunSelfTest));
+
+static FAutoConsoleCommand WebSocketBatchBenchmarkCommand(
+	TEXT("WebSocketServer.BatchBenchmark"),
+	TEXT("Writes messages over loopback one frame per message, then batched. Args: [Messages=200000] [BatchKilobytes=16] [MessagesPerTick=1000]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunBenchmark));
@@ -0,0 +1,82 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketBatchFrame.h"
+
+namespace
+{
+	const uint8 BatchHeader[FWebSocketBatchFrame::HeaderSize] = { 0x00, 'W', 'B', '1' };
+
+	void WriteSize(uint8* Dest, uint32 Size)
+	{
+		Dest[0] = uint8(Size);
+		Dest[1] = uint8(Size >> 8);
+		Dest[2] = uint8(Size >> 16);
+		Dest[3] = uint8(Size >> 24);
+	}
+
+	uint32 ReadSize(const uint8* Source)
+	{
+		return uint32(Source[0]) | (uint32(Source[1]) << 8) | (uint32(Source[2]) << 16) | (uint32(Source[3]) << 24);
+	}
+}
+
+void FWebSocketBatchFrame::Begin(TArray<uint8>& Frame)
+{
+	Frame.Reset();
+	Frame.Append(BatchHeader, HeaderSize);
+}
+
+void FWebSocketBatchFrame::Append(TArray<uint8>& Frame, TArrayView<const uint8> Message)
+{
+	const int32 Offset = Frame.AddUninitialized(SizePrefix + Message.Num());
+	WriteSize(Frame.GetData() + Offset, Message.Num());
+	FMemory::Memcpy(Frame.GetData() + Offset + SizePrefix, Message.GetData(), Message.Num());
+}
+
+int32 FWebSocketBatchFrame::BeginMessage(TArray<uint8>& Frame)
+{
+	return Frame.AddZeroed(SizePrefix);
+}
+
+void FWebSocketBatchFrame::EndMessage(TArray<uint8>& Frame, int32 Offset)
+{
+	WriteSize(Frame.GetData() + Offset, Frame.Num() - Offset - SizePrefix);
+}
+
+bool FWebSocketBatchFrame::IsBatch(TArrayView<const uint8> Data)
+{
+	if (Data.Num() < HeaderSize || FMemory::Memcmp(Data.GetData(), BatchHeader, HeaderSize) != 0)
+	{
+		return false;
+	}
+
+	int64 Offset = HeaderSize;
+	while (Offset < Data.Num())
+	{
+		if (Offset + SizePrefix > Data.Num())
+		{
+			return false;
+		}
+		Offset += SizePrefix + int64(ReadSize(Data.GetData() + Offset));
+	}
+	return Offset == Data.Num();
+}
+
+bool FWebSocketBatchFrame::Split(TArrayView<const uint8> Data, TFunctionRef<void(TArrayView<const uint8>)> Func)
+{
+	// validated first, a malformed container delivers nothing
+	if (!IsBatch(Data))
+	{
+		return false;
+	}
+
+	int32 Offset = HeaderSize;
+	while (Offset < Data.Num())
+	{
+		const int32 Size = ReadSize(Data.GetData() + Offset);
+		Offset += SizePrefix;
+		Func(TArrayView<const uint8>(Data.GetData() + Offset, Size));
+		Offset += Size;
+	}
+	return true;
+}
@@ -0,0 +1,700 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketConnectionRegistry.h"
+#include "INetworkingWebSocket.h"
+#include "Misc/Parse.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+FWebSocketServerConnection::FWebSocketServerConnection(INetworkingWebSocket* InSocket)
+	: Socket(InSocket)
+	, Id(FGuid::NewGuid())
+	, IdString(Id.ToString())
+{
+}
+
+FWebSocketServerConnection::~FWebSocketServerConnection()
+{
+	if (Socket)
+	{
+		delete Socket;
+		Socket = nullptr;
+	}
+}
+
+FWebSocketConnectionRegistry::~FWebSocketConnectionRegistry()
+{
+	Empty();
+}
+
+FWebSocketClientHandle FWebSocketConnectionRegistry::Add(INetworkingWebSocket* Socket)
+{
+	// reuse a free slot, a new slab is only allocated when all slots are in use
+	if (FreeSlots.Num() == 0)
+	{
+		const int32 First = Slabs.Num() * SlabSize;
+		Slabs.Add(MakeUnique<FSlot[]>(SlabSize));
+		for (int32 Index = First + SlabSize - 1; Index >= First; --Index)
+		{
+			FreeSlots.Add(Index);
+		}
+	}
+
+	FWebSocketClientHandle Handle;
+	Handle.Index = FreeSlots.Pop(false);
+	FSlot& Slot = GetSlot(Handle.Index);
+	Handle.Generation = Slot.Generation;
+
+	FWebSocketServerConnection* Connection = new (Slot.Connection.GetTypedPtr()) FWebSocketServerConnection(Socket);
+	Slot.bOccupied = true;
+	Slot.ActiveIndex = Active.Add(Handle);
+	IdIndex.Add(Connection->Id, Handle);
+	SocketIndex.Add(Socket, Handle);
+	return Handle;
+}
+
+bool FWebSocketConnectionRegistry::Remove(FWebSocketClientHandle Handle)
+{
+	FSlot* Slot = FindOccupied(Handle);
+	if (!Slot)
+	{
+		return false;
+	}
+
+	FWebSocketServerConnection* Connection = Slot->Connection.GetTypedPtr();
+	if (Slot->ActiveIndex != INDEX_NONE)
+	{
+		Deactivate(Handle, *Slot);
+	}
+	SocketIndex.Remove(Connection->Socket);
+
+	Connection->~FWebSocketServerConnection();
+	Slot->bOccupied = false;
+	++Slot->Generation;
+	FreeSlots.Add(Handle.Index);
+	return true;
+}
+
+void FWebSocketConnectionRegistry::Detach(FWebSocketClientHandle Handle)
+{
+	FSlot* Slot = FindOccupied(Handle);
+	if (Slot && Slot->ActiveIndex != INDEX_NONE)
+	{
+		Deactivate(Handle, *Slot);
+		Slot->Connection.GetTypedPtr()->SendQueue.Empty();
+	}
+}
+
+void FWebSocketConnectionRegistry::Deactivate(FWebSocketClientHandle Handle, FSlot& Slot)
+{
+	FWebSocketServerConnection* Connection = Slot.Connection.GetTypedPtr();
+	IdIndex.Remove(Connection->Id);
+	Subscribers.RemoveSubscriber(Handle.Index, Connection->Subscriptions);
+	Interest.RemoveClient(Handle.Index);
+	Connection->Subscriptions.Empty();
+	if (!Connection->ClientName.IsEmpty())
+	{
+		NameIndex.RemoveSingle(Connection->ClientName, Handle);
+	}
+
+	// keep Active dense, the last connection takes the removed one's place
+	const FWebSocketClientHandle Last = Active.Last();
+	Active.RemoveAtSwap(Slot.ActiveIndex, 1, false);
+	if (Last != Handle)
+	{
+		GetSlot(Last.Index).ActiveIndex = Slot.ActiveIndex;
+	}
+	Slot.ActiveIndex = INDEX_NONE;
+}
+
+FWebSocketConnectionRegistry::FSlot* FWebSocketConnectionRegistry::FindOccupied(FWebSocketClientHandle Handle) const
+{
+	if (Handle.Index < 0 || Handle.Index >= Slabs.Num() * SlabSize)
+	{
+		return nullptr;
+	}
+
+	FSlot& Slot = GetSlot(Handle.Index);
+	return Slot.bOccupied && Slot.Generation == Handle.Generation ? &Slot : nullptr;
+}
+
+void FWebSocketConnectionRegistry::Empty()
+{
+	for (int32 Index = 0; Index < Slabs.Num() * SlabSize; ++Index)
+	{
+		const FSlot& Slot = GetSlot(Index);
+		if (Slot.bOccupied)
+		{
+			Remove(FWebSocketClientHandle{ Index, Slot.Generation });
+		}
+	}
+}
+
+FWebSocketServerConnection* FWebSocketConnectionRegistry::Get(FWebSocketClientHandle Handle) const
+{
+	FSlot* Slot = FindOccupied(Handle);
+	return Slot && Slot->ActiveIndex != INDEX_NONE ? Slot->Connection.GetTypedPtr() : nullptr;
+}
+
+FWebSocketClientHandle FWebSocketConnectionRegistry::FindById(const FGuid& Id) const
+{
+	const FWebSocketClientHandle* Handle = IdIndex.Find(Id);
+	return Handle ? *Handle : FWebSocketClientHandle();
+}
+
+FWebSocketClientHandle FWebSocketConnectionRegistry::FindById(const FString& Id) const
+{
+	FGuid Guid;
+	if (!ParseId(Id, Guid) && !FGuid::Parse(Id, Guid))
+	{
+		return FWebSocketClientHandle();
+	}
+	return FindById(Guid);
+}
+
+FWebSocketClientHandle FWebSocketConnectionRegistry::FindByName(const FString& Name) const
+{
+	const FWebSocketClientHandle* Handle = NameIndex.Find(Name);
+	return Handle ? *Handle : FWebSocketClientHandle();
+}
+
+FWebSocketClientHandle FWebSocketConnectionRegistry::FindBySocket(const INetworkingWebSocket* Socket) const
+{
+	const FWebSocketClientHandle* Handle = SocketIndex.Find(Socket);
+	return Handle ? *Handle : FWebSocketClientHandle();
+}
+
+void FWebSocketConnectionRegistry::SetName(FWebSocketClientHandle Handle, const FString& Name)
+{
+	FWebSocketServerConnection* Connection = Get(Handle);
+	if (!Connection)
+	{
+		return;
+	}
+
+	if (!Connection->ClientName.IsEmpty())
+	{
+		NameIndex.RemoveSingle(Connection->ClientName, Handle);
+	}
+	Connection->ClientName = Name;
+	if (!Name.IsEmpty())
+	{
+		NameIndex.Add(Name, Handle);
+	}
+}
+
+bool FWebSocketConnectionRegistry::Send(FWebSocketClientHandle Handle, const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected)
+{
+	FWebSocketServerConnection* Connection = Get(Handle);
+	if (!Connection)
+	{
+		return false;
+	}
+
+	const EWebSocketEnqueueResult Result = Connection->SendQueue.Enqueue(Message, SendQueueSettings);
+	if (Result == EWebSocketEnqueueResult::Disconnect)
+	{
+		OutDisconnected.Add(Connection->IdString);
+		Detach(Handle);
+	}
+	return Result == EWebSocketEnqueueResult::Blocked;
+}
+
+bool FWebSocketConnectionRegistry::Broadcast(const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected)
+{
+	// the message is encoded once, each queue only takes a reference
+	TArray<FWebSocketClientHandle, TInlineAllocator<8>> Overflowed;
+	bool bBlocked = false;
+	ForEach([this, &Message, &Overflowed, &bBlocked](FWebSocketClientHandle Handle, FWebSocketServerConnection& Connection) {
+		const EWebSocketEnqueueResult Result = Connection.SendQueue.Enqueue(Message, SendQueueSettings);
+		bBlocked |= Result == EWebSocketEnqueueResult::Blocked;
+		if (Result == EWebSocketEnqueueResult::Disconnect)
+		{
+			Overflowed.Add(Handle);
+		}
+	});
+
+	for (const FWebSocketClientHandle& Handle : Overflowed)
+	{
+		OutDisconnected.Add(Get(Handle)->IdString);
+		Detach(Handle);
+	}
+	return bBlocked;
+}
+
+namespace
+{
+	/** Appends Text as a JSON string in UTF-8. */
+	void AppendJsonString(TArray<uint8>& Out, const FString& Text)
+	{
+		FString Escaped;
+		Escaped.Reserve(Text.Len() + 2);
+		Escaped += TEXT('"');
+		for (const TCHAR Char : Text)
+		{
+			switch (Char)
+			{
+			case TEXT('"'): Escaped += TEXT("\\\""); break;
+			case TEXT('\\'): Escaped += TEXT("\\\\"); break;
+			case TEXT('\n'): Escaped += TEXT("\\n"); break;
+			case TEXT('\r'): Escaped += TEXT("\\r"); break;
+			case TEXT('\t'): Escaped += TEXT("\\t"); break;
+			default:
+				if (Char < 0x20)
+				{
+					Escaped += FString::Printf(TEXT("\\u%04x"), uint32(Char));
+				}
+				else
+				{
+					Escaped += Char;
+				}
+			}
+		}
+		Escaped += TEXT('"');
+
+		FTCHARToUTF8 Utf8(*Escaped);
+		Out.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	const FString NullStateValue(TEXT("null"));
+
+	/**
+	 * Values are pasted into state frames as they are, so they have to be exactly one JSON value. An empty value is null,
+	 * returns nullptr and logs for anything that does not parse.
+	 */
+	const FString* ValidateStateValue(const FString& Topic, const FString& Key, const FString& Value)
+	{
+		if (Value.IsEmpty())
+		{
+			return &NullStateValue;
+		}
+
+		// the reader only accepts an object or an array as the root, the value is parsed as the single element of an array
+		TArray<TSharedPtr<FJsonValue>> Values;
+		if (FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(TEXT("[") + Value + TEXT("]")), Values) && Values.Num() == 1)
+		{
+			return &Value;
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("WebSocketServer: value of %s in state topic %s is not valid JSON, the update is dropped"), *Key, *Topic);
+		return nullptr;
+	}
+}
+
+int32 FWebSocketConnectionRegistry::InternStateKey(const FString& Topic, const FString& Key, int32& OutKeyIndex)
+{
+	int32 TopicIndex;
+	if (const int32* Found = StateTopicIndex.Find(Topic))
+	{
+		TopicIndex = *Found;
+	}
+	else
+	{
+		TArray<uint8> Name;
+		AppendJsonString(Name, Topic);
+		TopicIndex = StateTopics.Add(FStateTopic{ Topic, MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Name)) });
+		StateTopicIndex.Add(Topic, TopicIndex);
+	}
+
+	FStateKeyMap& Keys = StateTopics[TopicIndex].Keys;
+	if (const int32* Found = Keys.Find(Key))
+	{
+		OutKeyIndex = *Found;
+	}
+	else
+	{
+		OutKeyIndex = NumStateKeys++;
+		Keys.Add(Key, OutKeyIndex);
+	}
+	return TopicIndex;
+}
+
+FWebSocketStateUpdateRef FWebSocketConnectionRegistry::MakeStateUpdate(int32 TopicIndex, int32 KeyIndex, const FString& Key, const FString& Value) const
+{
+	TArray<uint8> Member;
+	AppendJsonString(Member, Key);
+	Member.Add(':');
+	FTCHARToUTF8 Utf8(*Value);
+	Member.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	return MakeShared<const FWebSocketStateUpdate, ESPMode::ThreadSafe>(TopicIndex, KeyIndex, StateTopics[TopicIndex].Name, MoveTemp(Member));
+}
+
+void FWebSocketConnectionRegistry::PublishState(const FString& Topic, const FString& Key, const FString& InValue)
+{
+	const FString* ValidValue = ValidateStateValue(Topic, Key, InValue);
+	if (ValidValue == nullptr)
+	{
+		return;
+	}
+	const FString& Value = *ValidValue;
+
+	int32 KeyIndex;
+	const int32 TopicIndex = InternStateKey(Topic, Key, KeyIndex);
+
+	// "Key":Value is encoded once for every subscriber and kept for later ones, a removed key is not
+	const FWebSocketStateUpdateRef Update = MakeStateUpdate(TopicIndex, KeyIndex, Key, Value);
+	if (LatestState.Num() <= KeyIndex)
+	{
+		LatestState.SetNum(KeyIndex + 1);
+	}
+	if (Value == TEXT("null"))
+	{
+		LatestState[KeyIndex].Reset();
+	}
+	else
+	{
+		LatestState[KeyIndex] = Update;
+	}
+
+	for (TConstSetBitIterator<> It(Subscribers.Resolve(Topic)); It; ++It)
+	{
+		const FSlot& Slot = GetSlot(It.GetIndex());
+		if (Slot.ActiveIndex != INDEX_NONE)
+		{
+			Slot.Connection.GetTypedPtr()->SendQueue.SetState(Update);
+		}
+	}
+}
+
+void FWebSocketConnectionRegistry::SendEntity(int32 Client, const FWebSocketStateUpdateRef& Update)
+{
+	// areas are removed with their client, the slot holds an active connection
+	GetSlot(Client).Connection.GetTypedPtr()->SendQueue.SetState(Update);
+}
+
+bool FWebSocketConnectionRegistry::IsStateSubscriber(int32 Client, int32 TopicIndex)
+{
+	const TBitArray<>& Bits = Subscribers.Resolve(StateTopics[TopicIndex].Topic);
+	return Client < Bits.Num() && Bits[Client];
+}
+
+void FWebSocketConnectionRegistry::SendStateSnapshot(int32 Client, TArrayView<const int32> TopicIndexes)
+{
+	if (TopicIndexes.Num() == 0)
+	{
+		return;
+	}
+
+	FWebSocketServerConnection& Connection = *GetSlot(Client).Connection.GetTypedPtr();
+	for (const int32 TopicIndex : TopicIndexes)
+	{
+		for (const TPair<FString, int32>& Key : StateTopics[TopicIndex].Keys)
+		{
+			if (LatestState.IsValidIndex(Key.Value) && LatestState[Key.Value].IsValid())
+			{
+				Connection.SendQueue.SetState(LatestState[Key.Value].ToSharedRef());
+			}
+		}
+	}
+
+	// entities inside the area were not sent while the client was not subscribed
+	Interest.ForEachVisible(Client, [&Connection, TopicIndexes](const FWebSocketStateUpdateRef& Update) {
+		if (TopicIndexes.Contains(Update->TopicIndex))
+		{
+			Connection.SendQueue.SetState(Update);
+		}
+	});
+}
+
+void FWebSocketConnectionRegistry::PublishEntity(const FString& Topic, const FString& Key, double Longitude, double Latitude, const FString& InValue)
+{
+	const FString* ValidValue = ValidateStateValue(Topic, Key, InValue);
+	if (ValidValue == nullptr)
+	{
+		return;
+	}
+	const FString& Value = *ValidValue;
+
+	int32 KeyIndex;
+	const int32 TopicIndex = InternStateKey(Topic, Key, KeyIndex);
+
+	// the leave update is encoded once per entity
+	TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe> Leave;
+	if (!Interest.HasEntity(KeyIndex))
+	{
+		Leave = MakeStateUpdate(TopicIndex, KeyIndex, Key, NullStateValue);
+	}
+	// only subscribers are sent the entity, the area of interest is tracked for all clients
+	const TBitArray<>& Subscribed = Subscribers.Resolve(Topic);
+	Interest.SetEntity(KeyIndex, Longitude, Latitude, MakeStateUpdate(TopicIndex, KeyIndex, Key, Value), Leave,
+		[this, &Subscribed](int32 Client, const FWebSocketStateUpdateRef& Update) {
+			if (Client < Subscribed.Num() && Subscribed[Client])
+			{
+				SendEntity(Client, Update);
+			}
+		});
+}
+
+void FWebSocketConnectionRegistry::RemoveEntity(const FString& Topic, const FString& Key)
+{
+	const int32* TopicIndex = StateTopicIndex.Find(Topic);
+	const int32* KeyIndex = TopicIndex ? StateTopics[*TopicIndex].Keys.Find(Key) : nullptr;
+	if (KeyIndex)
+	{
+		const TBitArray<>& Subscribed = Subscribers.Resolve(Topic);
+		Interest.RemoveEntity(*KeyIndex, [this, &Subscribed](int32 Client, const FWebSocketStateUpdateRef& Update) {
+			if (Client < Subscribed.Num() && Subscribed[Client])
+			{
+				SendEntity(Client, Update);
+			}
+		});
+	}
+}
+
+bool FWebSocketConnectionRegistry::SetInterestArea(FWebSocketClientHandle Handle, const FWebSocketInterestArea& Area)
+{
+	if (!Get(Handle))
+	{
+		return false;
+	}
+	Interest.SetArea(Handle.Index, Area, [this](int32 Client, const FWebSocketStateUpdateRef& Update) {
+		if (IsStateSubscriber(Client, Update->TopicIndex))
+		{
+			SendEntity(Client, Update);
+		}
+	});
+	return true;
+}
+
+bool FWebSocketConnectionRegistry::ClearInterestArea(FWebSocketClientHandle Handle)
+{
+	if (!Get(Handle))
+	{
+		return false;
+	}
+	Interest.ClearArea(Handle.Index, [this](int32 Client, const FWebSocketStateUpdateRef& Update) {
+		if (IsStateSubscriber(Client, Update->TopicIndex))
+		{
+			SendEntity(Client, Update);
+		}
+	});
+	return true;
+}
+
+int32 FWebSocketConnectionRegistry::NumVisibleEntities(FWebSocketClientHandle Handle) const
+{
+	return Get(Handle) ? Interest.NumVisible(Handle.Index) : 0;
+}
+
+bool FWebSocketConnectionRegistry::Subscribe(FWebSocketClientHandle Handle, const FString& Pattern)
+{
+	FWebSocketServerConnection* Connection = Get(Handle);
+	if (!Connection || Pattern.IsEmpty())
+	{
+		return false;
+	}
+
+	// state topics the pattern adds for the client, checked before the subscription changes the index
+	TArray<int32, TInlineAllocator<8>> NewStateTopics;
+	for (int32 TopicIndex = 0; TopicIndex < StateTopics.Num(); ++TopicIndex)
+	{
+		if (FWebSocketTopicIndex::Matches(Pattern, StateTopics[TopicIndex].Topic) && !IsStateSubscriber(Handle.Index, TopicIndex))
+		{
+			NewStateTopics.Add(TopicIndex);
+		}
+	}
+
+	if (!Subscribers.Subscribe(Handle.Index, Pattern))
+	{
+		return false;
+	}
+	Connection->Subscriptions.Add(Pattern);
+	SendStateSnapshot(Handle.Index, NewStateTopics);
+	return true;
+}
+
+bool FWebSocketConnectionRegistry::Unsubscribe(FWebSocketClientHandle Handle, const FString& Pattern)
+{
+	FWebSocketServerConnection* Connection = Get(Handle);
+	if (!Connection || !Subscribers.Unsubscribe(Handle.Index, Pattern))
+	{
+		return false;
+	}
+	Connection->Subscriptions.RemoveSingleSwap(Pattern, false);
+	return true;
+}
+
+bool FWebSocketConnectionRegistry::Publish(const FString& Topic, const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected)
+{
+	// only the subscribers are visited, they share the encoded message
+	TArray<FWebSocketClientHandle, TInlineAllocator<8>> Overflowed;
+	bool bBlocked = false;
+	for (TConstSetBitIterator<> It(Subscribers.Resolve(Topic)); It; ++It)
+	{
+		FSlot& Slot = GetSlot(It.GetIndex());
+		if (Slot.ActiveIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const EWebSocketEnqueueResult Result = Slot.Connection.GetTypedPtr()->SendQueue.Enqueue(Message, SendQueueSettings);
+		bBlocked |= Result == EWebSocketEnqueueResult::Blocked;
+		if (Result == EWebSocketEnqueueResult::Disconnect)
+		{
+			Overflowed.Add(FWebSocketClientHandle{ It.GetIndex(), Slot.Generation });
+		}
+	}
+
+	for (const FWebSocketClientHandle& Handle : Overflowed)
+	{
+		OutDisconnected.Add(Get(Handle)->IdString);
+		Detach(Handle);
+	}
+	return bBlocked;
+}
+
+int32 FWebSocketConnectionRegistry::NumSubscribers(const FString& Topic)
+{
+	return Subscribers.Resolve(Topic).CountSetBits();
+}
+
+bool FWebSocketConnectionRegistry::HandleControlMessage(FWebSocketClientHandle Handle, TArrayView<const uint8> Data)
+{
+	// {"subscribe":, {"unsubscribe": or {"interest":, application messages are rejected without parsing
+	const int32 MaxPrefix = 16;
+	int32 Start = 0;
+	while (Start < Data.Num() && FChar::IsWhitespace(Data[Start]))
+	{
+		++Start;
+	}
+	if (Start >= Data.Num() || Data[Start] != '{')
+	{
+		return false;
+	}
+	auto HasKeyword = [&Data, Start](const ANSICHAR* Keyword) {
+		const int32 Length = FCStringAnsi::Strlen(Keyword);
+		for (int32 Index = Start + 1; Index <= Start + MaxPrefix && Index + Length <= Data.Num(); ++Index)
+		{
+			if (FMemory::Memcmp(&Data[Index], Keyword, Length) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+	if (!HasKeyword("subscribe\"") && !HasKeyword("interest\""))
+	{
+		return false;
+	}
+
+	FUTF8ToTCHAR Text(reinterpret_cast<const ANSICHAR*>(Data.GetData()), Data.Num());
+	TSharedPtr<FJsonObject> Object;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(FString(Text.Length(), Text.Get())), Object) || !Object.IsValid())
+	{
+		return false;
+	}
+
+	auto ForEachPattern = [&Object](const TCHAR* Field, TFunctionRef<void(const FString&)> Func) {
+		const TSharedPtr<FJsonValue> Value = Object->TryGetField(Field);
+		if (!Value.IsValid())
+		{
+			return false;
+		}
+		if (Value->Type == EJson::Array)
+		{
+			for (const TSharedPtr<FJsonValue>& Element : Value->AsArray())
+			{
+				Func(Element->AsString());
+			}
+		}
+		else
+		{
+			Func(Value->AsString());
+		}
+		return true;
+	};
+
+	const bool bSubscribe = ForEachPattern(TEXT("subscribe"), [this, Handle](const FString& Pattern) { Subscribe(Handle, Pattern); });
+	const bool bUnsubscribe = ForEachPattern(TEXT("unsubscribe"), [this, Handle](const FString& Pattern) { Unsubscribe(Handle, Pattern); });
+
+	const TSharedPtr<FJsonValue> InterestValue = Object->TryGetField(TEXT("interest"));
+	if (!InterestValue.IsValid())
+	{
+		return bSubscribe || bUnsubscribe;
+	}
+
+	const TSharedPtr<FJsonObject>* AreaObject;
+	const TArray<TSharedPtr<FJsonValue>>* Values;
+	if (InterestValue->TryGetObject(AreaObject) && (*AreaObject)->TryGetArrayField(TEXT("bbox"), Values) && Values->Num() == 4)
+	{
+		// a box that can not be normalized leaves the current area as it is
+		FWebSocketInterestArea Area;
+		if (FWebSocketInterestArea::FromBounds((*Values)[0]->AsNumber(), (*Values)[1]->AsNumber(), (*Values)[2]->AsNumber(), (*Values)[3]->AsNumber(), Area))
+		{
+			SetInterestArea(Handle, Area);
+		}
+	}
+	else if (InterestValue->TryGetObject(AreaObject) && (*AreaObject)->TryGetArrayField(TEXT("frustum"), Values))
+	{
+		TArray<FVector2D, TInlineAllocator<8>> Corners;
+		for (const TSharedPtr<FJsonValue>& Value : *Values)
+		{
+			const TArray<TSharedPtr<FJsonValue>>* Corner;
+			if (Value->TryGetArray(Corner) && Corner->Num() >= 2)
+			{
+				Corners.Emplace((*Corner)[0]->AsNumber(), (*Corner)[1]->AsNumber());
+			}
+		}
+		// like a box, a footprint that can not be normalized leaves the current area as it is
+		FWebSocketInterestArea Area;
+		if (Corners.Num() == 0)
+		{
+			ClearInterestArea(Handle);
+		}
+		else if (FWebSocketInterestArea::FromFootprint(Corners, Area))
+		{
+			SetInterestArea(Handle, Area);
+		}
+	}
+	else
+	{
+		ClearInterestArea(Handle);
+	}
+	return true;
+}
+
+bool FWebSocketConnectionRegistry::HasBlockedQueue() const
+{
+	for (const FWebSocketClientHandle& Handle : Active)
+	{
+		const FWebSocketSendQueue& SendQueue = GetSlot(Handle.Index).Connection.GetTypedPtr()->SendQueue;
+		if (SendQueue.GetPolicy(SendQueueSettings) == EWebSocketBackpressurePolicy::Block && SendQueue.IsAboveHighWater(SendQueueSettings))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FWebSocketConnectionRegistry::PumpSendQueues()
+{
+	const double Now = FPlatformTime::Seconds();
+	ForEach([this, Now](FWebSocketClientHandle, FWebSocketServerConnection& Connection) {
+		INetworkingWebSocket* Socket = Connection.Socket;
+		Connection.SendQueue.Pump([Socket](TArrayView<const uint8> Frame) { Socket->Send(Frame.GetData(), Frame.Num(), /*PrependSize=*/false); },
+			SendQueueSettings, FrameScratch, Now);
+	});
+}
+
+bool FWebSocketConnectionRegistry::ParseId(const FString& Id, FGuid& OutId)
+{
+	// FGuid::ToString writes 32 hex digits, FGuid::Parse would copy the string before parsing it
+	if (Id.Len() != 32)
+	{
+		return false;
+	}
+
+	uint32 Values[4] = {};
+	for (int32 Index = 0; Index < 32; ++Index)
+	{
+		const TCHAR Char = Id[Index];
+		if (!FChar::IsHexDigit(Char))
+		{
+			return false;
+		}
+		Values[Index / 8] = (Values[Index / 8] << 4) | FParse::HexDigit(Char);
+	}
+	OutId = FGuid(Values[0], Values[1], Values[2], Values[3]);
+	return true;
+}
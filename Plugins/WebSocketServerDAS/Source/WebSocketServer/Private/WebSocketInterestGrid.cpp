@@ -0,0 +1,326 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketInterestGrid.h"
+
+namespace
+{
+	double NormalizeLongitude(double Longitude)
+	{
+		const double Wrapped = FMath::Fmod(Longitude + 180.0, 360.0);
+		return (Wrapped < 0.0 ? Wrapped + 360.0 : Wrapped) - 180.0;
+	}
+}
+
+bool FWebSocketInterestArea::Contains(double Longitude, double Latitude) const
+{
+	if (Latitude < MinLatitude || Latitude > MaxLatitude)
+	{
+		return false;
+	}
+	return MinLongitude <= MaxLongitude
+		? Longitude >= MinLongitude && Longitude <= MaxLongitude
+		: Longitude >= MinLongitude || Longitude <= MaxLongitude;
+}
+
+bool FWebSocketInterestArea::FromBounds(double MinLongitude, double MinLatitude, double MaxLongitude, double MaxLatitude, FWebSocketInterestArea& OutArea)
+{
+	if (!FMath::IsFinite(MinLongitude) || !FMath::IsFinite(MinLatitude) || !FMath::IsFinite(MaxLongitude) || !FMath::IsFinite(MaxLatitude))
+	{
+		return false;
+	}
+
+	// the width is kept, a min longitude above the max longitude is the client's way of crossing the antimeridian
+	const double Width = MaxLongitude - MinLongitude;
+	if (Width >= 360.0)
+	{
+		OutArea.MinLongitude = -180.0;
+		OutArea.MaxLongitude = 180.0;
+	}
+	else
+	{
+		const double WrappedWidth = Width < 0.0 ? FMath::Fmod(Width, 360.0) + 360.0 : Width;
+		OutArea.MinLongitude = NormalizeLongitude(MinLongitude);
+		OutArea.MaxLongitude = OutArea.MinLongitude + WrappedWidth;
+		if (OutArea.MaxLongitude > 180.0)
+		{
+			OutArea.MaxLongitude -= 360.0;
+		}
+	}
+
+	OutArea.MinLatitude = FMath::Clamp(FMath::Min(MinLatitude, MaxLatitude), -90.0, 90.0);
+	OutArea.MaxLatitude = FMath::Clamp(FMath::Max(MinLatitude, MaxLatitude), -90.0, 90.0);
+	return true;
+}
+
+bool FWebSocketInterestArea::FromFootprint(TArrayView<const FVector2D> Corners, FWebSocketInterestArea& OutArea)
+{
+	if (Corners.Num() == 0)
+	{
+		return false;
+	}
+
+	TArray<double, TInlineAllocator<8>> Longitudes;
+	double MinLatitude = 90.0, MaxLatitude = -90.0;
+	for (const FVector2D& Corner : Corners)
+	{
+		if (!FMath::IsFinite(Corner.X) || !FMath::IsFinite(Corner.Y))
+		{
+			return false;
+		}
+		Longitudes.Add(NormalizeLongitude(Corner.X));
+		MinLatitude = FMath::Min(MinLatitude, Corner.Y);
+		MaxLatitude = FMath::Max(MaxLatitude, Corner.Y);
+	}
+	Longitudes.Sort();
+
+	// the smallest arc covering all corners leaves out the largest gap between neighbouring longitudes,
+	// the area crosses the antimeridian unless that gap is the one around it
+	int32 GapEnd = 0;
+	double LargestGap = Longitudes[0] + 360.0 - Longitudes.Last();
+	for (int32 Index = 1; Index < Longitudes.Num(); ++Index)
+	{
+		const double Gap = Longitudes[Index] - Longitudes[Index - 1];
+		if (Gap > LargestGap)
+		{
+			LargestGap = Gap;
+			GapEnd = Index;
+		}
+	}
+	OutArea.MinLongitude = Longitudes[GapEnd];
+	OutArea.MaxLongitude = GapEnd == 0 ? Longitudes.Last() : Longitudes[GapEnd - 1];
+
+	OutArea.MinLatitude = FMath::Clamp(MinLatitude, -90.0, 90.0);
+	OutArea.MaxLatitude = FMath::Clamp(MaxLatitude, -90.0, 90.0);
+	return true;
+}
+
+int32 FWebSocketInterestGrid::GetCellX(double Longitude)
+{
+	return FMath::Clamp(FMath::FloorToInt32((Longitude + 180.0) / CellDegrees), 0, NumCellsX - 1);
+}
+
+int32 FWebSocketInterestGrid::GetCellY(double Latitude)
+{
+	return FMath::Clamp(FMath::FloorToInt32((Latitude + 90.0) / CellDegrees), 0, NumCellsY - 1);
+}
+
+bool FWebSocketInterestGrid::IsCellInside(const FWebSocketInterestArea& Area, int32 X, int32 Y)
+{
+	const double West = X * CellDegrees - 180.0;
+	const double South = Y * CellDegrees - 90.0;
+	return Area.Contains(West, South) && Area.Contains(West + CellDegrees, South + CellDegrees)
+		&& (Area.MinLongitude <= Area.MaxLongitude || West >= Area.MinLongitude || West + CellDegrees <= Area.MaxLongitude);
+}
+
+template<typename FuncType>
+void FWebSocketInterestGrid::ForEachCell(const FWebSocketInterestArea& Area, FuncType&& Func)
+{
+	if (Area.MinLatitude > Area.MaxLatitude)
+	{
+		return;
+	}
+
+	const int32 MinY = GetCellY(Area.MinLatitude);
+	const int32 MaxY = GetCellY(Area.MaxLatitude);
+	const int32 MinX = GetCellX(Area.MinLongitude);
+	const int32 MaxX = GetCellX(Area.MaxLongitude);
+	for (int32 Y = MinY; Y <= MaxY; ++Y)
+	{
+		if (Area.MinLongitude <= Area.MaxLongitude)
+		{
+			for (int32 X = MinX; X <= MaxX; ++X)
+			{
+				Func(X, Y);
+			}
+		}
+		else
+		{
+			// across the antimeridian
+			for (int32 X = MinX; X < NumCellsX; ++X)
+			{
+				Func(X, Y);
+			}
+			for (int32 X = 0; X <= MaxX; ++X)
+			{
+				Func(X, Y);
+			}
+		}
+	}
+}
+
+void FWebSocketInterestGrid::SetVisible(FEntity& Entity, int32 Client, bool bVisible)
+{
+	if (Client >= Entity.Visible.Num())
+	{
+		if (!bVisible)
+		{
+			return;
+		}
+		Entity.Visible.Add(false, Client + 1 - Entity.Visible.Num());
+	}
+	Entity.Visible[Client] = bVisible;
+}
+
+void FWebSocketInterestGrid::SetEntity(int32 EntityIndex, double Longitude, double Latitude, const FWebSocketStateUpdateRef& Update, const TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe>& Leave, FSendFunc Send)
+{
+	Longitude = NormalizeLongitude(Longitude);
+	Latitude = FMath::Clamp(Latitude, -90.0, 90.0);
+
+	FEntity& Entity = Entities.FindOrAdd(EntityIndex);
+	const int32 Cell = GetCellX(Longitude) + GetCellY(Latitude) * NumCellsX;
+	if (Cell != Entity.Cell)
+	{
+		if (Entity.Cell != INDEX_NONE)
+		{
+			Cells.FindChecked(Entity.Cell).Remove(EntityIndex);
+		}
+		Cells.FindOrAdd(Cell).Add(EntityIndex);
+		Entity.Cell = Cell;
+	}
+	Entity.Longitude = Longitude;
+	Entity.Latitude = Latitude;
+	Entity.Update = Update;
+	if (Leave.IsValid())
+	{
+		Entity.Leave = Leave;
+	}
+	check(Entity.Leave.IsValid());
+
+	// operators are few, every area is checked against the new position
+	for (TPair<int32, FClient>& Pair : Clients)
+	{
+		const bool bInside = Pair.Value.Area.Contains(Longitude, Latitude);
+		if (bInside)
+		{
+			Send(Pair.Key, Update);
+			if (!IsVisible(Entity, Pair.Key))
+			{
+				SetVisible(Entity, Pair.Key, true);
+				Pair.Value.Visible.Add(EntityIndex);
+			}
+		}
+		else if (IsVisible(Entity, Pair.Key))
+		{
+			Send(Pair.Key, Entity.Leave.ToSharedRef());
+			SetVisible(Entity, Pair.Key, false);
+			Pair.Value.Visible.Remove(EntityIndex);
+		}
+	}
+}
+
+void FWebSocketInterestGrid::RemoveEntity(int32 EntityIndex, FSendFunc Send)
+{
+	FEntity* Entity = Entities.Find(EntityIndex);
+	if (!Entity)
+	{
+		return;
+	}
+
+	for (TConstSetBitIterator<> It(Entity->Visible); It; ++It)
+	{
+		Send(It.GetIndex(), Entity->Leave.ToSharedRef());
+		Clients.FindChecked(It.GetIndex()).Visible.Remove(EntityIndex);
+	}
+	Cells.FindChecked(Entity->Cell).Remove(EntityIndex);
+	Entities.Remove(EntityIndex);
+}
+
+void FWebSocketInterestGrid::SetArea(int32 ClientIndex, const FWebSocketInterestArea& Area, FSendFunc Send)
+{
+	FClient* Client = Clients.Find(ClientIndex);
+	const bool bHadArea = Client != nullptr;
+	const FWebSocketInterestArea Previous = bHadArea ? Client->Area : FWebSocketInterestArea();
+	if (!Client)
+	{
+		Client = &Clients.Add(ClientIndex);
+	}
+	Client->Area = Area;
+
+	// leave: only the entities that were visible
+	for (TSet<int32>::TIterator It = Client->Visible.CreateIterator(); It; ++It)
+	{
+		FEntity& Entity = Entities.FindChecked(*It);
+		if (!Area.Contains(Entity.Longitude, Entity.Latitude))
+		{
+			Send(ClientIndex, Entity.Leave.ToSharedRef());
+			SetVisible(Entity, ClientIndex, false);
+			It.RemoveCurrent();
+		}
+	}
+
+	// enter: cells inside the previous area only hold entities that are visible already
+	ForEachCell(Area, [this, ClientIndex, Client, &Area, &Previous, bHadArea, &Send](int32 X, int32 Y) {
+		if (bHadArea && IsCellInside(Previous, X, Y))
+		{
+			return;
+		}
+		const TSet<int32>* Cell = Cells.Find(X + Y * NumCellsX);
+		if (!Cell)
+		{
+			return;
+		}
+		for (const int32 EntityIndex : *Cell)
+		{
+			FEntity& Entity = Entities.FindChecked(EntityIndex);
+			if (!IsVisible(Entity, ClientIndex) && Area.Contains(Entity.Longitude, Entity.Latitude))
+			{
+				Send(ClientIndex, Entity.Update.ToSharedRef());
+				SetVisible(Entity, ClientIndex, true);
+				Client->Visible.Add(EntityIndex);
+			}
+		}
+	});
+}
+
+void FWebSocketInterestGrid::ClearArea(int32 ClientIndex, FSendFunc Send)
+{
+	FClient* Client = Clients.Find(ClientIndex);
+	if (!Client)
+	{
+		return;
+	}
+
+	for (const int32 EntityIndex : Client->Visible)
+	{
+		FEntity& Entity = Entities.FindChecked(EntityIndex);
+		Send(ClientIndex, Entity.Leave.ToSharedRef());
+		SetVisible(Entity, ClientIndex, false);
+	}
+	Clients.Remove(ClientIndex);
+}
+
+void FWebSocketInterestGrid::RemoveClient(int32 ClientIndex)
+{
+	if (FClient* Client = Clients.Find(ClientIndex))
+	{
+		for (const int32 EntityIndex : Client->Visible)
+		{
+			SetVisible(Entities.FindChecked(EntityIndex), ClientIndex, false);
+		}
+		Clients.Remove(ClientIndex);
+	}
+}
+
+int32 FWebSocketInterestGrid::NumVisible(int32 ClientIndex) const
+{
+	const FClient* Client = Clients.Find(ClientIndex);
+	return Client ? Client->Visible.Num() : 0;
+}
+
+void FWebSocketInterestGrid::ForEachVisible(int32 ClientIndex, TFunctionRef<void(const FWebSocketStateUpdateRef&)> Func) const
+{
+	if (const FClient* Client = Clients.Find(ClientIndex))
+	{
+		for (const int32 EntityIndex : Client->Visible)
+		{
+			Func(Entities.FindChecked(EntityIndex).Update.ToSharedRef());
+		}
+	}
+}
+
+void FWebSocketInterestGrid::Empty()
+{
+	Entities.Empty();
+	Cells.Empty();
+	Clients.Empty();
+}
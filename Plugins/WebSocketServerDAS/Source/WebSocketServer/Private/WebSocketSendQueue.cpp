@@ -0,0 +1,192 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketSendQueue.h"
+#include "WebSocketBatchFrame.h"
+#include "Algo/Sort.h"
+
+FWebSocketMessageRef FWebSocketMessage::FromString(const FString& Message)
+{
+	FTCHARToUTF8 utf8Str(*Message);
+	TArray<uint8> Data;
+	Data.Append(reinterpret_cast<const uint8*>(utf8Str.Get()), utf8Str.Length());
+	return MakeShared<const FWebSocketMessage, ESPMode::ThreadSafe>(MoveTemp(Data));
+}
+
+FWebSocketMessageRef FWebSocketMessage::FromBytes(TArrayView<const uint8> Bytes)
+{
+	return MakeShared<const FWebSocketMessage, ESPMode::ThreadSafe>(TArray<uint8>(Bytes.GetData(), Bytes.Num()));
+}
+
+FWebSocketMessageRef FWebSocketMessage::FromBytes(TArray<uint8>&& Bytes)
+{
+	return MakeShared<const FWebSocketMessage, ESPMode::ThreadSafe>(MoveTemp(Bytes));
+}
+
+bool FWebSocketSendQueue::IsAboveHighWater(const FWebSocketSendQueueSettings& Settings, int32 IncomingBytes) const
+{
+	return Num() >= FMath::Max(Settings.HighWaterMessages, 1)
+		|| QueuedBytes + IncomingBytes > int64(FMath::Max(Settings.HighWaterKilobytes, 1)) * 1024;
+}
+
+EWebSocketEnqueueResult FWebSocketSendQueue::Enqueue(const FWebSocketMessageRef& Message, const FWebSocketSendQueueSettings& Settings)
+{
+	const int32 Size = Message->Data.Num();
+	EWebSocketEnqueueResult Result = EWebSocketEnqueueResult::Queued;
+	if (IsAboveHighWater(Settings, Size))
+	{
+		switch (GetPolicy(Settings))
+		{
+		case EWebSocketBackpressurePolicy::Block:
+			Result = EWebSocketEnqueueResult::Blocked;
+			break;
+		case EWebSocketBackpressurePolicy::DropOldest:
+			while (Num() > 0 && IsAboveHighWater(Settings, Size))
+			{
+				PopFront();
+				++Dropped;
+			}
+			break;
+		case EWebSocketBackpressurePolicy::Disconnect:
+			return EWebSocketEnqueueResult::Disconnect;
+		}
+	}
+
+	if (IsEmpty())
+	{
+		BatchStartTime = FPlatformTime::Seconds();
+	}
+	Messages.Add(Message);
+	QueuedBytes += Size;
+	return Result;
+}
+
+void FWebSocketSendQueue::SetState(const FWebSocketStateUpdateRef& Update)
+{
+	if (IsEmpty())
+	{
+		BatchStartTime = FPlatformTime::Seconds();
+	}
+	PendingState.Add(Update->KeyIndex, Update);
+}
+
+void FWebSocketSendQueue::Pump(TFunctionRef<void(TArrayView<const uint8>)> Write, const FWebSocketSendQueueSettings& Settings, TArray<uint8>& Scratch, double Now)
+{
+	if (Settings.bBatchMessages)
+	{
+		PumpBatches(Write, Settings, Scratch, Now);
+		return;
+	}
+
+	// the engine socket buffers every frame it is handed, more than one per pass would only move the backlog there
+	if (Num() > 0)
+	{
+		Write(Messages[Head]->Data);
+		PopFront();
+	}
+	else if (PendingState.Num() > 0)
+	{
+		Scratch.Reset();
+		PackState(Scratch);
+		Write(Scratch);
+	}
+}
+
+void FWebSocketSendQueue::PumpBatches(TFunctionRef<void(TArrayView<const uint8>)> Write, const FWebSocketSendQueueSettings& Settings, TArray<uint8>& Scratch, double Now)
+{
+	const int64 MaxBytes = int64(FMath::Max(Settings.BatchMaxKilobytes, 1)) * 1024;
+	if (IsEmpty() || (QueuedBytes < MaxBytes && Now - BatchStartTime < Settings.BatchMaxDelayMilliseconds * 0.001))
+	{
+		// wait for a full container or the latency cap
+		return;
+	}
+
+	// one container per pass, like one frame per pass without batching
+	FWebSocketBatchFrame::Begin(Scratch);
+	if (Num() > 0)
+	{
+		// a message always goes into the open container, the size cap closes it before the next one
+		do
+		{
+			FWebSocketBatchFrame::Append(Scratch, Messages[Head]->Data);
+			PopFront();
+		}
+		while (Num() > 0 && Scratch.Num() + FWebSocketBatchFrame::SizePrefix + Messages[Head]->Data.Num() <= MaxBytes);
+	}
+
+	// the state frame rides along in the last container
+	if (Num() == 0 && PendingState.Num() > 0)
+	{
+		const int32 Offset = FWebSocketBatchFrame::BeginMessage(Scratch);
+		PackState(Scratch);
+		FWebSocketBatchFrame::EndMessage(Scratch, Offset);
+	}
+	Write(Scratch);
+
+	// whatever is left waits from now on
+	BatchStartTime = Now;
+}
+
+void FWebSocketSendQueue::PackState(TArray<uint8>& OutFrame)
+{
+	TArray<const FWebSocketStateUpdate*, TInlineAllocator<64>> Updates;
+	Updates.Reserve(PendingState.Num());
+	for (const TPair<int32, TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe>>& Pair : PendingState)
+	{
+		Updates.Add(Pair.Value.Get());
+	}
+	Algo::Sort(Updates, [](const FWebSocketStateUpdate* A, const FWebSocketStateUpdate* B) { return A->TopicIndex < B->TopicIndex; });
+
+	auto Append = [&OutFrame](const char* Text) { OutFrame.Append(reinterpret_cast<const uint8*>(Text), FCStringAnsi::Strlen(Text)); };
+
+	Append("{\"state\":{");
+	for (int32 Index = 0; Index < Updates.Num(); ++Index)
+	{
+		const FWebSocketStateUpdate& Update = *Updates[Index];
+		const bool bFirstOfTopic = Index == 0 || Updates[Index - 1]->TopicIndex != Update.TopicIndex;
+		if (bFirstOfTopic)
+		{
+			if (Index > 0)
+			{
+				Append("},");
+			}
+			OutFrame.Append(*Update.TopicName);
+			Append(":{");
+		}
+		else
+		{
+			Append(",");
+		}
+		OutFrame.Append(Update.Member);
+	}
+	Append("}}}");
+
+	// the keys stay allocated, a topic tends to update the same keys again
+	PendingState.Reset();
+}
+
+void FWebSocketSendQueue::Empty()
+{
+	Messages.Empty();
+	Head = 0;
+	QueuedBytes = 0;
+	PendingState.Empty();
+}
+
+void FWebSocketSendQueue::PopFront()
+{
+	QueuedBytes -= Messages[Head]->Data.Num();
+	Messages[Head].Reset();
+	++Head;
+
+	// compact once the sent part outweighs the queued part
+	if (Head == Messages.Num())
+	{
+		Messages.Reset();
+		Head = 0;
+	}
+	else if (Head >= 64 && Head * 2 >= Messages.Num())
+	{
+		Messages.RemoveAt(0, Head, false);
+		Head = 0;
+	}
+}
@@ -4,9 +4,6 @@
 #include "WebSocketServerActor.h"
 #include "Containers/Ticker.h"
 #include "IPAddress.h"
-#include "IWebSocketNetworkingModule.h"
-#include "WebSocketNetworkingDelegates.h"
-#include <string>
 #include "Runtime/Core/Public/Misc/CString.h"
 
 
@@ -50,131 +47,139 @@ void AWebSocketServerActor::BeginDestroy()
 
 bool AWebSocketServerActor::Start(int Port)
 {
-	FWebSocketClientConnectedCallBack CallBack;
-	CallBack.BindUObject(this, &AWebSocketServerActor::OnWebSocketClientConnected);
+	const bool bStarted = Core.Start(Port, bUseNetworkThread ? NetworkTickRate : 0);
 
-	Server = FModuleManager::Get().LoadModuleChecked<IWebSocketNetworkingModule>(TEXT("WebSocketNetworking")).CreateServer();
-
-	if (!Server || !Server->Init(Port, CallBack))
-	{
-		Server.Reset();
-		return false;
-	}
-
-	return true;
+	// the network thread keeps receiving while paused, its events are drained in Tick
+	SetTickableWhenPaused(Core.HasNetworkThread());
+	return bStarted;
 }
 
 void AWebSocketServerActor::Stop()
 {
-	if (IsRunning()) {
-		Server.Reset();
-	}
+	Core.Stop();
 }
 
 bool AWebSocketServerActor::WebSocketServerTick(float DeltaTime)
 {
-	if (IsRunning()) {
-		Server->Tick();
-		return true;
-	}
-	else {
-		return false;
-	}
+	return Core.Tick(SendQueueSettings);
 }
 
-void AWebSocketServerActor::Send(const FGuid& InTargetClientId, const TArray<uint8>& InUTF8Payload)
+void AWebSocketServerActor::OnClientConnected(const FString& ClientId)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([&InTargetClientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id == InTargetClientId; }))
-	{
-		Connection->Socket->Send(InUTF8Payload.GetData(), InUTF8Payload.Num(), /*PrependSize=*/false);
-	}
+	_DebugLog("----OnWebSocketClientConnected " + ClientId, 10, FColor::Red);
+	//有新客户端连接 delegate
+	WsClientOnConnected.Broadcast(ClientId);
 }
 
-void AWebSocketServerActor::Send(const FString msg)
+void AWebSocketServerActor::OnClientClosed(const FString& ClientId)
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	_DebugLog("----OnSocketClose " + ClientId, 10, FColor::Red);
+	WsClientOnClosed.Broadcast(ClientId);
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
+void AWebSocketServerActor::OnClientDisconnected(const FString& ClientId)
+{
+	_DebugLog("----Send queue overflow, disconnect " + ClientId, 10, FColor::Red);
+	WsClientOnClosed.Broadcast(ClientId);
+}
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
+void AWebSocketServerActor::OnClientMessage(FWebSocketClientHandle Client, const TArray<uint8>& Data)
+{
+	//收到数据 delegate, 没有蓝图监听时不查找 ID
+	if (WsClientOnRawMessage.IsBound())
+	{
+		WsClientOnRawMessage.Broadcast(Data, Data.Num(), Core.GetClientId(Client));
 	}
 }
 
+void AWebSocketServerActor::Send(const FGuid& InTargetClientId, const TArray<uint8>& InUTF8Payload)
+{
+	Core.SendEncoded(InTargetClientId, FWebSocketMessage::FromBytes(InUTF8Payload));
+}
 
-void AWebSocketServerActor::SendBytesToClientId(const FString clientId, const TArray<uint8>& uint8Array)
+void AWebSocketServerActor::SendEncoded(const FGuid& InTargetClientId, const FWebSocketMessageRef& Message)
 {
-	//for (auto& ws : Connections) {
-	//	if (ws->getId() == clientId)
-	//		ws->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	//}
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientId; }))
-	{
-		Connection->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+	Core.SendEncoded(InTargetClientId, Message);
 }
 
+void AWebSocketServerActor::SendEncoded(FWebSocketClientHandle Client, const FWebSocketMessageRef& Message)
+{
+	Core.SendEncoded(Client, Message);
+}
 
-void AWebSocketServerActor::SendToClientId(const FString clientId, const FString msg)
+FString AWebSocketServerActor::GetClientId(FWebSocketClientHandle Client) const
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	return Core.GetClientId(Client);
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
+void AWebSocketServerActor::PublishEncoded(const FString& Topic, const FWebSocketMessageRef& Message)
+{
+	Core.PublishEncoded(Topic, Message);
+}
 
-	//for (auto& ws : Connections) {
-	//	if (ws->Id.ToString() == clientId)
-	//		ws->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	//}
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientId](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientId; }))
-	{
-		Connection->Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void AWebSocketServerActor::publishEntity(FString topic, FString key, double longitude, double latitude, FString jsonValue)
+{
+	Core.PublishEntity(topic, key, longitude, latitude, jsonValue);
+}
 
+void AWebSocketServerActor::removeEntity(FString topic, FString key)
+{
+	Core.RemoveEntity(topic, key);
 }
 
+void AWebSocketServerActor::publish(FString topic, FString msg)
+{
+	Core.PublishEncoded(topic, FWebSocketMessage::FromString(msg));
+}
 
-void AWebSocketServerActor::SendBytesToAllClients(const TArray<uint8>& uint8Array)
+void AWebSocketServerActor::publishBytes(FString topic, const TArray<uint8>& uint8Array)
 {
+	Core.PublishEncoded(topic, FWebSocketMessage::FromBytes(uint8Array));
+}
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void AWebSocketServerActor::SendEncodedToAllClients(const FWebSocketMessageRef& Message)
+{
+	Core.SendEncodedToAllClients(Message);
+}
 
+void AWebSocketServerActor::Send(const FString msg)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromString(msg));
 }
 
 
-void AWebSocketServerActor::SendToAllClients(const FString msg)
+void AWebSocketServerActor::SendBytesToClientId(const FString clientId, const TArray<uint8>& uint8Array)
 {
-	FTCHARToUTF8 utf8Str(*msg);
-	int32 utf8StrLen = utf8Str.Length();
+	Core.SendEncoded(clientId, FWebSocketMessage::FromBytes(uint8Array));
+}
 
-	TArray<uint8> uint8Array;
-	uint8Array.SetNum(utf8StrLen);
-	memcpy(uint8Array.GetData(), utf8Str.Get(), utf8StrLen);
 
-	for (auto& ws : Connections) {
-		ws.Socket->Send(uint8Array.GetData(), uint8Array.Num(), /*PrependSize=*/false);
-	}
+void AWebSocketServerActor::SendToClientId(const FString clientId, const FString msg)
+{
+	Core.SendEncoded(clientId, FWebSocketMessage::FromString(msg));
 }
 
 
+void AWebSocketServerActor::SendBytesToAllClients(const TArray<uint8>& uint8Array)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromBytes(uint8Array));
+}
 
 
+void AWebSocketServerActor::SendToAllClients(const FString msg)
+{
+	Core.SendEncodedToAllClients(FWebSocketMessage::FromString(msg));
+}
 
+void AWebSocketServerActor::publishState(FString topic, FString key, FString jsonValue)
+{
+	Core.PublishState(topic, key, jsonValue);
+}
 
 
 bool AWebSocketServerActor::IsRunning() const
 {
-	return !!Server;
+	return Core.IsRunning();
 }
 
 void AWebSocketServerActor::_DebugLog(FString msg, float delayTime, FColor color)
@@ -185,124 +190,65 @@ void AWebSocketServerActor::_DebugLog(FString msg, float delayTime, FColor color
 }
 
 
-void AWebSocketServerActor::OnClientSocketError(INetworkingWebSocket* Socket)
+int AWebSocketServerActor::getClientCount()
 {
-	//int32 Index = -1;
-	//for (int32 k = 0; k < Connections.Num(); k++)
-	//{
-	//	if (Connections[k]->isSocket(Socket))
-	//	{
-	//		Index = k;
-	//		break;
-	//	}
-	//}
-	//_DebugLog("----OnSocketClose " + FString::FromInt(Index), 10, FColor::Red);
-	//if (Index != -1)
-	//{
-	//	//有客户端离线 delegate
-	//	WsClientOnError.Broadcast(Connections[Index]->getId());
-	//	Connections.RemoveAtSwap(Index);
-	//}
-
+	return Core.NumClients();
 }
 
 
-
-void AWebSocketServerActor::OnWebSocketClientConnected(INetworkingWebSocket* Socket)
+TArray<FString> AWebSocketServerActor::getClients()
 {
-	_DebugLog("----OnWebSocketClientConnected ", 10, FColor::Red);
-	if (ensureMsgf(Socket, TEXT("Socket was null while creating a new websocket connection.")))
-	{
-		FWebSocketConnection Connection = FWebSocketConnection{ Socket };
-
-		FWebSocketPacketReceivedCallBack ReceiveCallBack;
-		ReceiveCallBack.BindUObject(this, &AWebSocketServerActor::ReceivedRawPacket, Connection.Id);
-		Socket->SetReceiveCallBack(ReceiveCallBack);
-
-		FWebSocketInfoCallBack CloseCallback;
-		CloseCallback.BindUObject(this, &AWebSocketServerActor::OnSocketClose, Socket);
-		Socket->SetSocketClosedCallBack(CloseCallback);
-
-		FWebSocketInfoCallBack ErrorCallBack;
-		ErrorCallBack.BindUObject(this, &AWebSocketServerActor::OnClientSocketError, Socket);
-		Socket->SetErrorCallBack(ErrorCallBack);
-
-
-		Connections.Add(MoveTemp(Connection));
-
-		//有新客户端连接 delegate
-		WsClientOnConnected.Broadcast(Connection.Id.ToString());
-	}
+	return Core.GetClientIds();
 }
 
-void AWebSocketServerActor::ReceivedRawPacket(void* Data, int32 Size, FGuid ClientId)
+void AWebSocketServerActor::setClientNameById(FString clientid, FString name)
 {
-	TArrayView<uint8> dataArrayView = MakeArrayView(static_cast<uint8*>(Data), Size);
-	const std::string cstr(reinterpret_cast<const char*>(
-		dataArrayView.GetData()),
-		dataArrayView.Num());
-	//FString frameAsFString = UTF8_TO_TCHAR(cstr.c_str());
-	//OnH5MsgCallback(frameAsFString);
-
-
-	TArray<uint8> bytesArray;
-	bytesArray.Append((uint8*)Data, Size);
-
-	//收到数据 delegate
-	WsClientOnRawMessage.Broadcast(bytesArray, Size, ClientId.ToString());
+	Core.SetClientName(clientid, name);
 }
 
-
-void AWebSocketServerActor::OnSocketClose(INetworkingWebSocket* Socket)
+void AWebSocketServerActor::setClientBackpressureById(FString clientid, EWebSocketBackpressurePolicy policy)
 {
-	int32 Index = Connections.IndexOfByPredicate([Socket](const FWebSocketConnection& Connection) { return Connection.Socket == Socket; });
-
-	_DebugLog("----OnSocketClose " + FString::FromInt(Index), 10, FColor::Red);
-	if (Index != INDEX_NONE)
-	{
-		//OnConnectionClosed().Broadcast(Connections[Index].Id);
-		WsClientOnClosed.Broadcast(Connections[Index].Id.ToString());
-		Connections.RemoveAtSwap(Index);
-	}
+	Core.SetClientBackpressure(clientid, policy);
 }
 
+bool AWebSocketServerActor::subscribeClient(FString clientid, FString pattern)
+{
+	return Core.Subscribe(clientid, pattern);
+}
 
+bool AWebSocketServerActor::unsubscribeClient(FString clientid, FString pattern)
+{
+	return Core.Unsubscribe(clientid, pattern);
+}
 
-
-int AWebSocketServerActor::getClientCount()
+bool AWebSocketServerActor::setClientInterestArea(FString clientid, double minLongitude, double minLatitude, double maxLongitude, double maxLatitude)
 {
+	return Core.SetInterestArea(clientid, minLongitude, minLatitude, maxLongitude, maxLatitude);
+}
 
-	return Connections.Num();
+bool AWebSocketServerActor::clearClientInterestArea(FString clientid)
+{
+	return Core.ClearInterestArea(clientid);
 }
 
+int AWebSocketServerActor::getClientVisibleEntityCount(FString clientid)
+{
+	return Core.NumVisibleEntities(clientid);
+}
 
-TArray<FString> AWebSocketServerActor::getClients()
+int AWebSocketServerActor::getTopicSubscriberCount(FString topic)
 {
-	TArray<FString> result;
-	for (int i = 0; i < Connections.Num(); i++)
-	{
-		result.Add(Connections[i].Id.ToString());
-	}
-	return result;
+	return Core.NumSubscribers(topic);
 }
 
-void AWebSocketServerActor::setClientNameById(FString clientid, FString name)
+int AWebSocketServerActor::getClientQueueLength(FString clientid)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([clientid](const FWebSocketConnection& InConnection)
-		{ return InConnection.Id.ToString() == clientid; }))
-	{
-		Connection->clientName = name;
-	}
+	return Core.GetQueueLength(clientid);
 }
 
 FString AWebSocketServerActor::getClientIdByName(FString name)
 {
-	if (FWebSocketConnection* Connection = Connections.FindByPredicate([name](const FWebSocketConnection& InConnection)
-		{ return InConnection.clientName == name; }))
-	{
-		return Connection->Id.ToString();
-	}
-	return FString(TEXT(""));
+	return Core.FindClientIdByName(name);
 }
 
 
@@ -0,0 +1,382 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketServerCore.h"
+#include "INetworkingWebSocket.h"
+#include "IWebSocketServer.h"
+#include "IWebSocketNetworkingModule.h"
+#include "WebSocketNetworkingDelegates.h"
+#include "WebSocketBatchFrame.h"
+#include "Modules/ModuleManager.h"
+
+FWebSocketServerCore::FWebSocketServerCore(IWebSocketServerListener& InListener)
+	: Listener(InListener)
+{
+}
+
+FWebSocketServerCore::~FWebSocketServerCore()
+{
+	Stop();
+}
+
+bool FWebSocketServerCore::Start(int32 Port, int32 NetworkTickRate)
+{
+	FWebSocketClientConnectedCallBack CallBack;
+	CallBack.BindRaw(this, &FWebSocketServerCore::OnWebSocketClientConnected);
+
+	Server = FModuleManager::Get().LoadModuleChecked<IWebSocketNetworkingModule>(TEXT("WebSocketNetworking")).CreateServer();
+
+	if (!Server || !Server->Init(Port, CallBack))
+	{
+		Server.Reset();
+		return false;
+	}
+
+	if (NetworkTickRate > 0)
+	{
+		NetworkThread = MakeUnique<FWebSocketServerThread>([this]() { ServiceServer(); }, NetworkTickRate);
+	}
+
+	return true;
+}
+
+void FWebSocketServerCore::Stop()
+{
+	if (IsRunning()) {
+		// the network thread has to stop servicing before the server goes away
+		NetworkThread.Reset();
+		Server.Reset();
+		Events.Empty();
+		ClientIds.Empty();
+	}
+}
+
+bool FWebSocketServerCore::Tick(const FWebSocketSendQueueSettings& InSendQueueSettings)
+{
+	if (!IsRunning())
+	{
+		return false;
+	}
+
+	SendQueueSettings = InSendQueueSettings;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		Connections.SetSendQueueSettings(SendQueueSettings);
+	}
+	if (!NetworkThread)
+	{
+		ServiceServer();
+	}
+	RaiseEvents();
+	return true;
+}
+
+void FWebSocketServerCore::ServiceServer()
+{
+	// hand queued messages to the sockets, they are written while the server is serviced
+	FScopeLock Lock(&ConnectionsLock);
+	Connections.PumpSendQueues();
+	Server->Tick();
+}
+
+void FWebSocketServerCore::RaiseEvents()
+{
+	FWebSocketServerEvent Event;
+	while (Events.Dequeue(Event))
+	{
+		switch (Event.Type)
+		{
+		case FWebSocketServerEvent::EType::Connected:
+			//有新客户端连接 delegate
+			Listener.OnClientConnected(ClientIds.Add(Event.Client, MoveTemp(Event.ClientId)));
+			break;
+		case FWebSocketServerEvent::EType::Closed:
+			if (const FString* ClientId = ClientIds.Find(Event.Client))
+			{
+				Listener.OnClientClosed(*ClientId);
+			}
+			ClientIds.Remove(Event.Client);
+			break;
+		case FWebSocketServerEvent::EType::Released:
+			ClientIds.Remove(Event.Client);
+			break;
+		case FWebSocketServerEvent::EType::Message:
+			NativeMessageDelegate.Broadcast(Event.Client, Event.Data);
+			//收到数据 delegate
+			Listener.OnClientMessage(Event.Client, Event.Data);
+			ReceivePool.Release(MoveTemp(Event.Data));
+			break;
+		}
+	}
+}
+
+void FWebSocketServerCore::WaitForBlockedQueues()
+{
+	if (!NetworkThread)
+	{
+		return;
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + FMath::Max(SendQueueSettings.BlockTimeoutMilliseconds, 0) / 1000.0;
+	while (FPlatformTime::Seconds() < EndTime)
+	{
+		{
+			FScopeLock Lock(&ConnectionsLock);
+			if (!Connections.HasBlockedQueue())
+			{
+				return;
+			}
+		}
+		FPlatformProcess::SleepNoStats(0.0005f);
+	}
+}
+
+void FWebSocketServerCore::FinishSend(const TArray<FString>& Disconnected, bool bBlocked)
+{
+	for (const FString& ClientId : Disconnected)
+	{
+		Listener.OnClientDisconnected(ClientId);
+	}
+	if (bBlocked)
+	{
+		WaitForBlockedQueues();
+	}
+}
+
+void FWebSocketServerCore::SendEncoded(const FGuid& ClientId, const FWebSocketMessageRef& Message)
+{
+	TArray<FString> Disconnected;
+	bool bBlocked;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		bBlocked = Connections.Send(Connections.FindById(ClientId), Message, Disconnected);
+	}
+	FinishSend(Disconnected, bBlocked);
+}
+
+void FWebSocketServerCore::SendEncoded(FWebSocketClientHandle Client, const FWebSocketMessageRef& Message)
+{
+	TArray<FString> Disconnected;
+	bool bBlocked;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		bBlocked = Connections.Send(Client, Message, Disconnected);
+	}
+	FinishSend(Disconnected, bBlocked);
+}
+
+void FWebSocketServerCore::SendEncoded(const FString& ClientId, const FWebSocketMessageRef& Message)
+{
+	TArray<FString> Disconnected;
+	bool bBlocked;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		bBlocked = Connections.Send(Connections.FindById(ClientId), Message, Disconnected);
+	}
+	FinishSend(Disconnected, bBlocked);
+}
+
+void FWebSocketServerCore::SendEncodedToAllClients(const FWebSocketMessageRef& Message)
+{
+	TArray<FString> Disconnected;
+	bool bBlocked;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		bBlocked = Connections.Broadcast(Message, Disconnected);
+	}
+	FinishSend(Disconnected, bBlocked);
+}
+
+void FWebSocketServerCore::PublishEncoded(const FString& Topic, const FWebSocketMessageRef& Message)
+{
+	TArray<FString> Disconnected;
+	bool bBlocked;
+	{
+		FScopeLock Lock(&ConnectionsLock);
+		bBlocked = Connections.Publish(Topic, Message, Disconnected);
+	}
+	FinishSend(Disconnected, bBlocked);
+}
+
+void FWebSocketServerCore::PublishState(const FString& Topic, const FString& Key, const FString& Value)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	Connections.PublishState(Topic, Key, Value);
+}
+
+void FWebSocketServerCore::PublishEntity(const FString& Topic, const FString& Key, double Longitude, double Latitude, const FString& Value)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	Connections.PublishEntity(Topic, Key, Longitude, Latitude, Value);
+}
+
+void FWebSocketServerCore::RemoveEntity(const FString& Topic, const FString& Key)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	Connections.RemoveEntity(Topic, Key);
+}
+
+FString FWebSocketServerCore::GetClientId(FWebSocketClientHandle Client) const
+{
+	const FString* ClientId = ClientIds.Find(Client);
+	return ClientId ? *ClientId : FString();
+}
+
+int32 FWebSocketServerCore::NumClients() const
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.Num();
+}
+
+TArray<FString> FWebSocketServerCore::GetClientIds() const
+{
+	FScopeLock Lock(&ConnectionsLock);
+	TArray<FString> Result;
+	Result.Reserve(Connections.Num());
+	Connections.ForEach([&Result](FWebSocketClientHandle, const FWebSocketServerConnection& Connection) {
+		Result.Add(Connection.IdString);
+	});
+	return Result;
+}
+
+FString FWebSocketServerCore::FindClientIdByName(const FString& Name) const
+{
+	FScopeLock Lock(&ConnectionsLock);
+	if (const FWebSocketServerConnection* Connection = Connections.Get(Connections.FindByName(Name)))
+	{
+		return Connection->IdString;
+	}
+	return FString();
+}
+
+void FWebSocketServerCore::SetClientName(const FString& ClientId, const FString& Name)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	Connections.SetName(Connections.FindById(ClientId), Name);
+}
+
+void FWebSocketServerCore::SetClientBackpressure(const FString& ClientId, EWebSocketBackpressurePolicy Policy)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	if (FWebSocketServerConnection* Connection = Connections.Get(Connections.FindById(ClientId)))
+	{
+		Connection->SendQueue.SetPolicy(Policy);
+	}
+}
+
+bool FWebSocketServerCore::Subscribe(const FString& ClientId, const FString& Pattern)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.Subscribe(Connections.FindById(ClientId), Pattern);
+}
+
+bool FWebSocketServerCore::Unsubscribe(const FString& ClientId, const FString& Pattern)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.Unsubscribe(Connections.FindById(ClientId), Pattern);
+}
+
+int32 FWebSocketServerCore::NumSubscribers(const FString& Topic)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.NumSubscribers(Topic);
+}
+
+bool FWebSocketServerCore::SetInterestArea(const FString& ClientId, double MinLongitude, double MinLatitude, double MaxLongitude, double MaxLatitude)
+{
+	FWebSocketInterestArea Area;
+	if (!FWebSocketInterestArea::FromBounds(MinLongitude, MinLatitude, MaxLongitude, MaxLatitude, Area))
+	{
+		return false;
+	}
+
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.SetInterestArea(Connections.FindById(ClientId), Area);
+}
+
+bool FWebSocketServerCore::ClearInterestArea(const FString& ClientId)
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.ClearInterestArea(Connections.FindById(ClientId));
+}
+
+int32 FWebSocketServerCore::NumVisibleEntities(const FString& ClientId) const
+{
+	FScopeLock Lock(&ConnectionsLock);
+	return Connections.NumVisibleEntities(Connections.FindById(ClientId));
+}
+
+int32 FWebSocketServerCore::GetQueueLength(const FString& ClientId) const
+{
+	FScopeLock Lock(&ConnectionsLock);
+	const FWebSocketServerConnection* Connection = Connections.Get(Connections.FindById(ClientId));
+	return Connection ? Connection->SendQueue.Num() : 0;
+}
+
+void FWebSocketServerCore::OnClientSocketError(INetworkingWebSocket* Socket)
+{
+
+}
+
+void FWebSocketServerCore::OnWebSocketClientConnected(INetworkingWebSocket* Socket)
+{
+	if (ensureMsgf(Socket, TEXT("Socket was null while creating a new websocket connection.")))
+	{
+		const FWebSocketClientHandle Handle = Connections.Add(Socket);
+		const FWebSocketServerConnection& Connection = *Connections.Get(Handle);
+
+		FWebSocketPacketReceivedCallBack ReceiveCallBack;
+		ReceiveCallBack.BindRaw(this, &FWebSocketServerCore::ReceivedRawPacket, Handle);
+		Socket->SetReceiveCallBack(ReceiveCallBack);
+
+		FWebSocketInfoCallBack CloseCallback;
+		CloseCallback.BindRaw(this, &FWebSocketServerCore::OnSocketClose, Socket);
+		Socket->SetSocketClosedCallBack(CloseCallback);
+
+		FWebSocketInfoCallBack ErrorCallBack;
+		ErrorCallBack.BindRaw(this, &FWebSocketServerCore::OnClientSocketError, Socket);
+		Socket->SetErrorCallBack(ErrorCallBack);
+
+		Events.Enqueue(FWebSocketServerEvent{ FWebSocketServerEvent::EType::Connected, Handle, Connection.IdString });
+	}
+}
+
+void FWebSocketServerCore::ReceivedRawPacket(void* Data, int32 Size, FWebSocketClientHandle Client)
+{
+	// clients detached by the Disconnect policy are no longer listened to
+	if (!Connections.Get(Client))
+	{
+		return;
+	}
+
+	// containers sent by batching clients are split into their messages
+	const TArrayView<const uint8> Packet(static_cast<const uint8*>(Data), Size);
+	if (!FWebSocketBatchFrame::Split(Packet, [this, Client](TArrayView<const uint8> Message) { ReceivedMessage(Client, Message); }))
+	{
+		ReceivedMessage(Client, Packet);
+	}
+}
+
+void FWebSocketServerCore::ReceivedMessage(FWebSocketClientHandle Client, TArrayView<const uint8> Message)
+{
+	// subscriptions and areas of interest are applied while the server is serviced, they never reach the delegates
+	if (Connections.HandleControlMessage(Client, Message))
+	{
+		return;
+	}
+
+	// the only copy, the engine reuses its receive buffer once the callback returns
+	Events.Enqueue(FWebSocketServerEvent{ FWebSocketServerEvent::EType::Message, Client, FString(), ReceivePool.Acquire(Message.GetData(), Message.Num()) });
+}
+
+void FWebSocketServerCore::OnSocketClose(INetworkingWebSocket* Socket)
+{
+	const FWebSocketClientHandle Handle = Connections.FindBySocket(Socket);
+
+	if (Handle.IsValid())
+	{
+		const bool bActive = Connections.Get(Handle) != nullptr;
+		Events.Enqueue(FWebSocketServerEvent{ bActive ? FWebSocketServerEvent::EType::Closed : FWebSocketServerEvent::EType::Released, Handle });
+	}
+	// clients detached by the Disconnect policy were reported already, their socket is released here
+	Connections.Remove(Handle);
+}
@@ -0,0 +1,71 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketServerThread.h"
+#include "HAL/RunnableThread.h"
+
+FWebSocketServerThread::FWebSocketServerThread(TFunction<void()>&& InService, int32 TickRate)
+	: Service(MoveTemp(InService))
+	, Period(1.0 / FMath::Clamp(TickRate, 1, 10000))
+{
+	Thread = FRunnableThread::Create(this, TEXT("WebSocketServer"), 0, TPri_AboveNormal);
+}
+
+FWebSocketServerThread::~FWebSocketServerThread()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+FWebSocketReceivePool::FWebSocketReceivePool()
+	: Free(256)
+{
+}
+
+TArray<uint8> FWebSocketReceivePool::Acquire(const void* Data, int32 Size)
+{
+	TArray<uint8> Buffer;
+	Free.Dequeue(Buffer);
+	Buffer.Reset();
+	Buffer.Append(static_cast<const uint8*>(Data), Size);
+	return Buffer;
+}
+
+void FWebSocketReceivePool::Release(TArray<uint8>&& Buffer)
+{
+	if (Buffer.Max() <= MaxPooledBytes)
+	{
+		// a full pool frees the buffer
+		Free.Enqueue(MoveTemp(Buffer));
+	}
+}
+
+uint32 FWebSocketServerThread::Run()
+{
+	double NextTime = FPlatformTime::Seconds();
+	while (!bStopping.load(std::memory_order_relaxed))
+	{
+		Service();
+
+		// fixed rate, a late pass starts the next one right away instead of catching up
+		NextTime += Period;
+		const double Now = FPlatformTime::Seconds();
+		if (NextTime > Now)
+		{
+			FPlatformProcess::SleepNoStats(static_cast<float>(NextTime - Now));
+		}
+		else
+		{
+			NextTime = Now;
+		}
+	}
+	return 0;
+}
+
+void FWebSocketServerThread::Stop()
+{
+	bStopping.store(true, std::memory_order_relaxed);
+}
@@ -0,0 +1,154 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#include "WebSocketTopicIndex.h"
+
+void FWebSocketTopicIndex::SetBit(TBitArray<>& Bits, int32 Index, bool bValue)
+{
+	if (Index >= Bits.Num())
+	{
+		if (!bValue)
+		{
+			return;
+		}
+		Bits.Add(false, Index + 1 - Bits.Num());
+	}
+	Bits[Index] = bValue;
+}
+
+bool FWebSocketTopicIndex::Subscribe(int32 Subscriber, const FString& Pattern)
+{
+	TBitArray<>& Bits = Patterns.FindOrAdd(Pattern);
+	if (Subscriber < Bits.Num() && Bits[Subscriber])
+	{
+		return false;
+	}
+	SetBit(Bits, Subscriber, true);
+
+	// adding a subscriber keeps the cached topics valid
+	for (TPair<FString, TBitArray<>>& Topic : Topics)
+	{
+		if (Matches(Pattern, Topic.Key))
+		{
+			SetBit(Topic.Value, Subscriber, true);
+		}
+	}
+	return true;
+}
+
+bool FWebSocketTopicIndex::Unsubscribe(int32 Subscriber, const FString& Pattern)
+{
+	TBitArray<>* Bits = Patterns.Find(Pattern);
+	if (!Bits || Subscriber >= Bits->Num() || !(*Bits)[Subscriber])
+	{
+		return false;
+	}
+
+	SetBit(*Bits, Subscriber, false);
+	if (Bits->Find(true) == INDEX_NONE)
+	{
+		Patterns.Remove(Pattern);
+	}
+
+	// the subscriber may still match a topic through another pattern, resolve again
+	Topics.Reset();
+	return true;
+}
+
+void FWebSocketTopicIndex::RemoveSubscriber(int32 Subscriber, const TArray<FString>& SubscriberPatterns)
+{
+	for (const FString& Pattern : SubscriberPatterns)
+	{
+		if (TBitArray<>* Bits = Patterns.Find(Pattern))
+		{
+			SetBit(*Bits, Subscriber, false);
+			if (Bits->Find(true) == INDEX_NONE)
+			{
+				Patterns.Remove(Pattern);
+			}
+		}
+	}
+
+	if (SubscriberPatterns.Num() > 0)
+	{
+		for (TPair<FString, TBitArray<>>& Topic : Topics)
+		{
+			SetBit(Topic.Value, Subscriber, false);
+		}
+	}
+}
+
+const TBitArray<>& FWebSocketTopicIndex::Resolve(const FString& Topic)
+{
+	if (const TBitArray<>* Bits = Topics.Find(Topic))
+	{
+		return *Bits;
+	}
+
+	TBitArray<> Bits;
+	for (const TPair<FString, TBitArray<>>& Pattern : Patterns)
+	{
+		if (Matches(Pattern.Key, Topic))
+		{
+			Bits.CombineWithBitwiseOR(Pattern.Value, EBitwiseOperatorFlags::MaxSize);
+		}
+	}
+
+	// a subscription to the topic resolves it again, until then publishing only costs the matching above
+	if (Bits.Find(true) == INDEX_NONE)
+	{
+		return NoSubscribers;
+	}
+	if (Topics.Num() >= MaxCachedTopics)
+	{
+		Topics.Reset();
+	}
+	return Topics.Add(Topic, MoveTemp(Bits));
+}
+
+void FWebSocketTopicIndex::Empty()
+{
+	Patterns.Empty();
+	Topics.Empty();
+}
+
+bool FWebSocketTopicIndex::Matches(const FString& Pattern, const FString& Topic)
+{
+	const TCHAR* P = *Pattern;
+	const TCHAR* T = *Topic;
+	while (true)
+	{
+		if (FCString::Strcmp(P, TEXT("**")) == 0)
+		{
+			return true;
+		}
+
+		const TCHAR* PatternEnd = P;
+		while (*PatternEnd && *PatternEnd != TEXT('/'))
+		{
+			++PatternEnd;
+		}
+		const TCHAR* TopicEnd = T;
+		while (*TopicEnd && *TopicEnd != TEXT('/'))
+		{
+			++TopicEnd;
+		}
+
+		const bool bAnySegment = PatternEnd - P == 1 && *P == TEXT('*');
+		if (!bAnySegment && (PatternEnd - P != TopicEnd - T || FCString::Strncmp(P, T, PatternEnd - P) != 0))
+		{
+			return false;
+		}
+
+		if (!*TopicEnd)
+		{
+			// "a/**" matches "a" as well
+			return !*PatternEnd || FCString::Strcmp(PatternEnd, TEXT("/**")) == 0;
+		}
+		if (!*PatternEnd)
+		{
+			return false;
+		}
+		P = PatternEnd + 1;
+		T = TopicEnd + 1;
+	}
+}
@@ -0,0 +1,31 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Container frame carrying several messages in one web socket frame: the 4 byte header 00 'W' 'B' '1',
+ * then for every message its size as a little endian uint32 followed by its bytes.
+ * Text messages never start with a zero byte, binary messages that do are only taken for a container when they parse as one.
+ */
+struct WEBSOCKETSERVER_API FWebSocketBatchFrame
+{
+	static constexpr int32 HeaderSize = 4;
+	static constexpr int32 SizePrefix = sizeof(uint32);
+
+	/** Starts a container in Frame, replacing its content. */
+	static void Begin(TArray<uint8>& Frame);
+
+	static void Append(TArray<uint8>& Frame, TArrayView<const uint8> Message);
+
+	/** Reserves the size of a message written directly into Frame, returns the offset to pass to EndMessage. */
+	static int32 BeginMessage(TArray<uint8>& Frame);
+	static void EndMessage(TArray<uint8>& Frame, int32 Offset);
+
+	/** Whether Data is a well formed container. */
+	static bool IsBatch(TArrayView<const uint8> Data);
+
+	/** Calls Func for every message of a container, returns false without calling it when Data is not one. */
+	static bool Split(TArrayView<const uint8> Data, TFunctionRef<void(TArrayView<const uint8>)> Func);
+};
@@ -0,0 +1,261 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WebSocketSendQueue.h"
+#include "WebSocketTopicIndex.h"
+#include "WebSocketInterestGrid.h"
+
+class INetworkingWebSocket;
+
+/** Handle to a connection in FWebSocketConnectionRegistry. A handle whose connection was removed fails the generation check. */
+struct WEBSOCKETSERVER_API FWebSocketClientHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Generation = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	bool operator==(const FWebSocketClientHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+	bool operator!=(const FWebSocketClientHandle& Other) const { return !(*this == Other); }
+
+	friend uint32 GetTypeHash(const FWebSocketClientHandle& Handle)
+	{
+		return HashCombine(::GetTypeHash(Handle.Index), ::GetTypeHash(Handle.Generation));
+	}
+};
+
+/** Native receive callback, Data points into a pooled buffer that is reused once the delegate returns. */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FWebSocketNativeMessageDelegate, FWebSocketClientHandle /*Client*/, TArrayView<const uint8> /*Data*/);
+
+/** Holds a web socket connection to a client. */
+class WEBSOCKETSERVER_API FWebSocketServerConnection
+{
+public:
+
+	explicit FWebSocketServerConnection(INetworkingWebSocket* InSocket);
+	~FWebSocketServerConnection();
+
+	FWebSocketServerConnection(const FWebSocketServerConnection&) = delete;
+	FWebSocketServerConnection& operator=(const FWebSocketServerConnection&) = delete;
+
+	/** Underlying WebSocket, deleted with the connection. */
+	INetworkingWebSocket* Socket = nullptr;
+
+	/** Generated ID for this client. */
+	FGuid Id;
+
+	/** Id formatted once, handed to delegates and Blueprint lookups. */
+	FString IdString;
+
+	FString ClientName;
+
+	/** Messages waiting to be handed to the socket. */
+	FWebSocketSendQueue SendQueue;
+
+	/** Topic patterns the client subscribed to. */
+	TArray<FString> Subscriptions;
+};
+
+/**
+ * Connections of a web socket server, stored in fixed size slabs so a connection never moves while it is alive.
+ * Removed slots are reused with a new generation. Lookups by id, name and socket go through hash indexes.
+ */
+class WEBSOCKETSERVER_API FWebSocketConnectionRegistry
+{
+public:
+
+	FWebSocketConnectionRegistry() = default;
+	~FWebSocketConnectionRegistry();
+
+	FWebSocketConnectionRegistry(const FWebSocketConnectionRegistry&) = delete;
+	FWebSocketConnectionRegistry& operator=(const FWebSocketConnectionRegistry&) = delete;
+
+	/** Adds a connection for a new socket, the registry takes ownership of the socket. */
+	FWebSocketClientHandle Add(INetworkingWebSocket* Socket);
+
+	/** Removes a connection and deletes its socket, returns false for stale handles. Detached connections are removed too. */
+	bool Remove(FWebSocketClientHandle Handle);
+
+	/**
+	 * Stops sending to a connection and drops it from lookups and iteration.
+	 * The socket stays alive until its close callback, the engine socket can not be closed from the server side.
+	 */
+	void Detach(FWebSocketClientHandle Handle);
+
+	/** Removes all connections. */
+	void Empty();
+
+	/** Returns the connection of a handle, nullptr when the handle is stale or detached. */
+	FWebSocketServerConnection* Get(FWebSocketClientHandle Handle) const;
+
+	FWebSocketClientHandle FindById(const FGuid& Id) const;
+
+	/** Accepts the format returned by FGuid::ToString without allocating, other formats fall back to FGuid::Parse. */
+	FWebSocketClientHandle FindById(const FString& Id) const;
+
+	/** Returns the first connection that was given this name. */
+	FWebSocketClientHandle FindByName(const FString& Name) const;
+
+	FWebSocketClientHandle FindBySocket(const INetworkingWebSocket* Socket) const;
+
+	/** Renames a connection and updates the name index. */
+	void SetName(FWebSocketClientHandle Handle, const FString& Name);
+
+	int32 Num() const { return Active.Num(); }
+
+	/** Handle of the Nth active connection, for iteration. Removing a connection moves the last one into its place. */
+	FWebSocketClientHandle GetActive(int32 ActiveIndex) const { return Active[ActiveIndex]; }
+
+	/** Calls Func for every active connection. Func must not add or remove connections. */
+	template<typename FuncType>
+	void ForEach(FuncType&& Func) const
+	{
+		for (const FWebSocketClientHandle& Handle : Active)
+		{
+			Func(Handle, *GetSlot(Handle.Index).Connection.GetTypedPtr());
+		}
+	}
+
+	void SetSendQueueSettings(const FWebSocketSendQueueSettings& InSettings) { SendQueueSettings = InSettings; }
+	const FWebSocketSendQueueSettings& GetSendQueueSettings() const { return SendQueueSettings; }
+
+	/**
+	 * Queues a message for one client. Clients detached by the Disconnect policy are added to OutDisconnected.
+	 * Returns true when the message went above the high-water mark of a Block client.
+	 */
+	bool Send(FWebSocketClientHandle Handle, const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected);
+
+	/** Queues the same message for every client. */
+	bool Broadcast(const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected);
+
+	/**
+	 * Sets the latest value of a key of a state topic for the clients subscribed to the topic, replacing the update still
+	 * pending for the key. Value has to be JSON and is dropped with a warning otherwise, publishing null or an empty value
+	 * is the convention for a removed key.
+	 */
+	void PublishState(const FString& Topic, const FString& Key, const FString& Value);
+
+	/**
+	 * Sets the latest value and position of an entity of a state topic. Only clients subscribed to the topic whose area
+	 * of interest contains the entity are sent the update, an entity leaving an area is sent as null. Value is checked
+	 * like in PublishState.
+	 */
+	void PublishEntity(const FString& Topic, const FString& Key, double Longitude, double Latitude, const FString& Value);
+
+	/** Removes an entity, the clients it was visible to are sent null. */
+	void RemoveEntity(const FString& Topic, const FString& Key);
+
+	/** Sets the area of interest of a client, the entities entering and leaving it are queued as state updates. */
+	bool SetInterestArea(FWebSocketClientHandle Handle, const FWebSocketInterestArea& Area);
+
+	/** Clears the area of interest of a client, it is no longer sent any entity. */
+	bool ClearInterestArea(FWebSocketClientHandle Handle);
+
+	int32 NumVisibleEntities(FWebSocketClientHandle Handle) const;
+
+	/**
+	 * Subscribes a client to a topic pattern, see FWebSocketTopicIndex. The current values of the state topics the client
+	 * newly matches are queued for it, entities only when they are inside its area of interest.
+	 */
+	bool Subscribe(FWebSocketClientHandle Handle, const FString& Pattern);
+	bool Unsubscribe(FWebSocketClientHandle Handle, const FString& Pattern);
+
+	/** Queues the same message for the clients subscribed to a matching pattern. */
+	bool Publish(const FString& Topic, const FWebSocketMessageRef& Message, TArray<FString>& OutDisconnected);
+
+	int32 NumSubscribers(const FString& Topic);
+
+	/**
+	 * Applies a control message sent by a client: {"subscribe":"pattern"}, {"unsubscribe":["pattern",...]},
+	 * {"interest":{"bbox":[minLon,minLat,maxLon,maxLat]}}, {"interest":{"frustum":[[lon,lat],...]}} or {"interest":null}.
+	 * Returns false for any other message, those are checked by their first bytes only.
+	 */
+	bool HandleControlMessage(FWebSocketClientHandle Handle, TArrayView<const uint8> Data);
+
+	/** Whether any Block client's queue is above its high-water mark. */
+	bool HasBlockedQueue() const;
+
+	/** Hands each socket at most one frame of its queue, called before the server is serviced. */
+	void PumpSendQueues();
+
+	/** Parses an id in the format returned by FGuid::ToString. */
+	static bool ParseId(const FString& Id, FGuid& OutId);
+
+private:
+	static constexpr int32 SlabSize = 64;
+
+	struct FSlot
+	{
+		TTypeCompatibleBytes<FWebSocketServerConnection> Connection;
+		uint32 Generation = 1;
+		bool bOccupied = false;
+		/** Position in Active, INDEX_NONE while the slot is free. */
+		int32 ActiveIndex = INDEX_NONE;
+	};
+
+	FSlot& GetSlot(int32 Index) const { return Slabs[Index / SlabSize][Index % SlabSize]; }
+
+	/** Slot of a handle whose connection is active or detached. */
+	FSlot* FindOccupied(FWebSocketClientHandle Handle) const;
+
+	/** Interns a state topic and key, returns the topic index and sets the key index. */
+	int32 InternStateKey(const FString& Topic, const FString& Key, int32& OutKeyIndex);
+
+	/** Encodes "Key":Value once, to be shared by every queue. */
+	FWebSocketStateUpdateRef MakeStateUpdate(int32 TopicIndex, int32 KeyIndex, const FString& Key, const FString& Value) const;
+
+	/** Queues an entity's update for the client in a slot. */
+	void SendEntity(int32 Client, const FWebSocketStateUpdateRef& Update);
+
+	/** Whether the client in a slot is subscribed to a state topic. */
+	bool IsStateSubscriber(int32 Client, int32 TopicIndex);
+
+	/** Queues the current values of state topics for a client that just subscribed to them. */
+	void SendStateSnapshot(int32 Client, TArrayView<const int32> TopicIndexes);
+
+	/** Removes the connection from iteration and the id and name indexes. */
+	void Deactivate(FWebSocketClientHandle Handle, FSlot& Slot);
+
+private:
+	/** Fixed size slot blocks, connections keep their address while the registry grows. */
+	TArray<TUniquePtr<FSlot[]>> Slabs;
+
+	TArray<int32> FreeSlots;
+	TArray<FWebSocketClientHandle> Active;
+
+	TMap<FGuid, FWebSocketClientHandle> IdIndex;
+	TMultiMap<FString, FWebSocketClientHandle> NameIndex;
+	TMap<const INetworkingWebSocket*, FWebSocketClientHandle> SocketIndex;
+
+	FWebSocketSendQueueSettings SendQueueSettings;
+
+	/** JSON member names are case sensitive. */
+	typedef TMap<FString, int32, FDefaultSetAllocator, TWebSocketCaseSensitiveKeyFuncs<int32>> FStateKeyMap;
+
+	struct FStateTopic
+	{
+		/** Topic as published, matched against subscriptions. */
+		FString Topic;
+		TSharedRef<const TArray<uint8>, ESPMode::ThreadSafe> Name;
+		FStateKeyMap Keys;
+	};
+
+	/** State topics and keys seen so far, bounded by the number of entities rather than messages. */
+	TArray<FStateTopic> StateTopics;
+	FStateKeyMap StateTopicIndex;
+	int32 NumStateKeys = 0;
+
+	/** Latest update of every key published by PublishState, indexed by key index, sent to new subscribers. Entities are kept by Interest. */
+	TArray<TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe>> LatestState;
+
+	/** Subscribers are indexed by slot, a slot's subscriptions are removed before it is reused. */
+	FWebSocketTopicIndex Subscribers;
+
+	/** Entities published with a position and the areas of interest of clients, indexed by key index and slot. */
+	FWebSocketInterestGrid Interest;
+
+	/** Frame buffer reused by PumpSendQueues. */
+	TArray<uint8> FrameScratch;
+};
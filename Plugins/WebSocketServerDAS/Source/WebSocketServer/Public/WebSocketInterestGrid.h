@@ -0,0 +1,106 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WebSocketSendQueue.h"
+
+/** Geodetic bounding box in degrees. MinLongitude above MaxLongitude wraps across the antimeridian. */
+struct WEBSOCKETSERVER_API FWebSocketInterestArea
+{
+	double MinLongitude = 0.0;
+	double MinLatitude = 0.0;
+	double MaxLongitude = 0.0;
+	double MaxLatitude = 0.0;
+
+	bool Contains(double Longitude, double Latitude) const;
+
+	/**
+	 * Area of a bounding box as sent by a client. Longitudes are wrapped into [-180, 180], [170, 0, 190, 10] crosses the
+	 * antimeridian like [170, 0, -170, 10]. Latitudes are swapped when inverted and clamped. Returns false for non-finite values.
+	 */
+	static bool FromBounds(double MinLongitude, double MinLatitude, double MaxLongitude, double MaxLatitude, FWebSocketInterestArea& OutArea);
+
+	/**
+	 * Bounding box of a camera frustum's ground footprint, given as longitude/latitude corners. The longitudes span the
+	 * smallest arc covering all corners, latitudes are clamped. Returns false without corners or for non-finite values.
+	 */
+	static bool FromFootprint(TArrayView<const FVector2D> Corners, FWebSocketInterestArea& OutArea);
+};
+
+/**
+ * Positions of published entities in a uniform longitude/latitude grid, and the entities each client's area of interest contains.
+ * Entities and clients are identified by the indexes the connection registry gives them. Sends go through a callback,
+ * an entity entering an area is sent its latest update and an entity leaving it is sent its leave update.
+ */
+class WEBSOCKETSERVER_API FWebSocketInterestGrid
+{
+public:
+
+	typedef TFunctionRef<void(int32 /*Client*/, const FWebSocketStateUpdateRef& /*Update*/)> FSendFunc;
+
+	bool HasEntity(int32 Entity) const { return Entities.Contains(Entity); }
+
+	/** Moves an entity and sends Update to the clients whose area contains it. Leave is required for new entities. */
+	void SetEntity(int32 Entity, double Longitude, double Latitude, const FWebSocketStateUpdateRef& Update, const TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe>& Leave, FSendFunc Send);
+
+	/** Removes an entity, the clients it was visible to are sent its leave update. */
+	void RemoveEntity(int32 Entity, FSendFunc Send);
+
+	/** Sets a client's area. Only entities of cells outside the previous area and previously visible entities are visited. */
+	void SetArea(int32 Client, const FWebSocketInterestArea& Area, FSendFunc Send);
+
+	/** Clears a client's area, every visible entity is sent its leave update. */
+	void ClearArea(int32 Client, FSendFunc Send);
+
+	/** Forgets a client that disconnected, nothing is sent. */
+	void RemoveClient(int32 Client);
+
+	int32 NumVisible(int32 Client) const;
+
+	/** Calls Func with the latest update of every entity inside a client's area. */
+	void ForEachVisible(int32 Client, TFunctionRef<void(const FWebSocketStateUpdateRef& /*Update*/)> Func) const;
+
+	void Empty();
+
+private:
+	/** Cell size in degrees. */
+	static constexpr int32 CellDegrees = 1;
+	static constexpr int32 NumCellsX = 360 / CellDegrees;
+	static constexpr int32 NumCellsY = 180 / CellDegrees;
+
+	struct FEntity
+	{
+		double Longitude = 0.0;
+		double Latitude = 0.0;
+		int32 Cell = INDEX_NONE;
+		TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe> Update;
+		TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe> Leave;
+		/** Clients the entity is visible to. */
+		TBitArray<> Visible;
+	};
+
+	struct FClient
+	{
+		FWebSocketInterestArea Area;
+		TSet<int32> Visible;
+	};
+
+	static int32 GetCellX(double Longitude);
+	static int32 GetCellY(double Latitude);
+
+	/** Whether every point of a cell lies in the area. */
+	static bool IsCellInside(const FWebSocketInterestArea& Area, int32 X, int32 Y);
+
+	/** Calls Func(X, Y) for every cell the area overlaps. */
+	template<typename FuncType>
+	static void ForEachCell(const FWebSocketInterestArea& Area, FuncType&& Func);
+
+	static bool IsVisible(const FEntity& Entity, int32 Client) { return Client < Entity.Visible.Num() && Entity.Visible[Client]; }
+	static void SetVisible(FEntity& Entity, int32 Client, bool bVisible);
+
+private:
+	TMap<int32, FEntity> Entities;
+	TMap<int32, TSet<int32>> Cells;
+	TMap<int32, FClient> Clients;
+};
@@ -0,0 +1,175 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WebSocketSendQueue.generated.h"
+
+UENUM(BlueprintType)
+enum class EWebSocketBackpressurePolicy : uint8
+{
+	// Keep every message past the high-water mark. With the network thread the sender waits for the queue to drain
+	Block,
+	// Drop the oldest queued messages to stay under the high-water mark
+	DropOldest,
+	// Stop sending to the client and report it as closed
+	Disconnect,
+};
+
+/**
+ * Send queue limits of a server. A queue hands its socket one frame per server tick, libwebsockets writes one frame each
+ * time the socket becomes writable. The engine socket keeps whatever it was handed in an unbounded buffer and
+ * INetworkingWebSocket reports no outstanding bytes, so the high-water marks can only bound the messages waiting for
+ * that hand-off, not the bytes a slow link has yet to send.
+ */
+USTRUCT(BlueprintType)
+struct WEBSOCKETSERVER_API FWebSocketSendQueueSettings
+{
+	GENERATED_BODY()
+
+	// Messages a client's queue holds before its backpressure policy applies
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (ClampMin = 1))
+		int32 HighWaterMessages = 256;
+
+	// Queued kilobytes a client's queue holds before its backpressure policy applies
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (ClampMin = 1))
+		int32 HighWaterKilobytes = 1024;
+
+	// Policy of clients that were not given their own
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer")
+		EWebSocketBackpressurePolicy Policy = EWebSocketBackpressurePolicy::DropOldest;
+
+	// Longest time a send waits for a Block client's queue to drain, only used with the network thread
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (ClampMin = 0))
+		int32 BlockTimeoutMilliseconds = 50;
+
+	// Collect a client's queued messages into container frames (see FWebSocketBatchFrame) instead of one frame per message,
+	// a client then receives more than one message per server tick
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer")
+		bool bBatchMessages = false;
+
+	// Size a container frame is closed at, a larger message gets a container of its own
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (ClampMin = 1, EditCondition = "bBatchMessages"))
+		int32 BatchMaxKilobytes = 16;
+
+	// Longest time queued messages wait for more to fill a container, 0 sends every server tick
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (ClampMin = 0, EditCondition = "bBatchMessages"))
+		int32 BatchMaxDelayMilliseconds = 0;
+};
+
+/** Encoded message, built once and shared by the send queues of every client it goes to. */
+class WEBSOCKETSERVER_API FWebSocketMessage
+{
+public:
+
+	explicit FWebSocketMessage(TArray<uint8>&& InData)
+		: Data(MoveTemp(InData))
+	{
+	}
+
+	/** Encodes a string as UTF-8. */
+	static TSharedRef<const FWebSocketMessage, ESPMode::ThreadSafe> FromString(const FString& Message);
+
+	static TSharedRef<const FWebSocketMessage, ESPMode::ThreadSafe> FromBytes(TArrayView<const uint8> Bytes);
+	static TSharedRef<const FWebSocketMessage, ESPMode::ThreadSafe> FromBytes(TArray<uint8>&& Bytes);
+
+	const TArray<uint8> Data;
+};
+
+typedef TSharedRef<const FWebSocketMessage, ESPMode::ThreadSafe> FWebSocketMessageRef;
+
+/**
+ * Latest value of one key of a state topic. The key and value are encoded once as the JSON member "Key":Value
+ * and shared by every queue the update is pending in.
+ */
+class WEBSOCKETSERVER_API FWebSocketStateUpdate
+{
+public:
+
+	FWebSocketStateUpdate(int32 InTopicIndex, int32 InKeyIndex, const TSharedRef<const TArray<uint8>, ESPMode::ThreadSafe>& InTopicName, TArray<uint8>&& InMember)
+		: TopicIndex(InTopicIndex)
+		, KeyIndex(InKeyIndex)
+		, TopicName(InTopicName)
+		, Member(MoveTemp(InMember))
+	{
+	}
+
+	/** Interned by FWebSocketConnectionRegistry, KeyIndex is unique across topics. */
+	const int32 TopicIndex;
+	const int32 KeyIndex;
+
+	/** Topic encoded as a JSON string. */
+	const TSharedRef<const TArray<uint8>, ESPMode::ThreadSafe> TopicName;
+
+	const TArray<uint8> Member;
+};
+
+typedef TSharedRef<const FWebSocketStateUpdate, ESPMode::ThreadSafe> FWebSocketStateUpdateRef;
+
+enum class EWebSocketEnqueueResult : uint8
+{
+	Queued,
+	/** Queued above the high-water mark of a Block client. */
+	Blocked,
+	/** Rejected, the client has to be disconnected. */
+	Disconnect,
+};
+
+/** Outbound messages of one client, handed to its socket one frame per server tick so a backlog builds up here, where the backpressure policy applies. */
+class WEBSOCKETSERVER_API FWebSocketSendQueue
+{
+public:
+
+	/** Adds a message and applies the backpressure policy. */
+	EWebSocketEnqueueResult Enqueue(const FWebSocketMessageRef& Message, const FWebSocketSendQueueSettings& Settings);
+
+	/** Replaces the pending update of the same key, the queue holds at most one update per key. */
+	void SetState(const FWebSocketStateUpdateRef& Update);
+
+	/**
+	 * Hands at most one frame to Write, built in Scratch. The pending state updates are packed into a frame once no message is
+	 * queued, behind a backlog they keep coalescing instead. With bBatchMessages the frame is a container of queued messages
+	 * that also carries the state updates, held back until it is full or BatchMaxDelayMilliseconds passed.
+	 */
+	void Pump(TFunctionRef<void(TArrayView<const uint8>)> Write, const FWebSocketSendQueueSettings& Settings, TArray<uint8>& Scratch, double Now);
+
+	void Empty();
+
+	int32 Num() const { return Messages.Num() - Head; }
+	int64 GetQueuedBytes() const { return QueuedBytes; }
+
+	/** Keys with an unsent state update. */
+	int32 NumPendingState() const { return PendingState.Num(); }
+
+	/** Messages dropped by the DropOldest policy. */
+	uint64 GetDropped() const { return Dropped; }
+
+	EWebSocketBackpressurePolicy GetPolicy(const FWebSocketSendQueueSettings& Settings) const { return PolicyOverride.Get(Settings.Policy); }
+	void SetPolicy(EWebSocketBackpressurePolicy Policy) { PolicyOverride = Policy; }
+
+	bool IsAboveHighWater(const FWebSocketSendQueueSettings& Settings, int32 IncomingBytes = 0) const;
+
+private:
+	void PopFront();
+
+	/** Appends {"state":{"Topic":{"Key":Value,...},...}} to OutFrame and clears the pending updates. */
+	void PackState(TArray<uint8>& OutFrame);
+
+	void PumpBatches(TFunctionRef<void(TArrayView<const uint8>)> Write, const FWebSocketSendQueueSettings& Settings, TArray<uint8>& Scratch, double Now);
+
+	bool IsEmpty() const { return Num() == 0 && PendingState.Num() == 0; }
+
+private:
+	/** Sent messages before Head are released and compacted away in batches. */
+	TArray<TSharedPtr<const FWebSocketMessage, ESPMode::ThreadSafe>> Messages;
+	int32 Head = 0;
+	int64 QueuedBytes = 0;
+	uint64 Dropped = 0;
+	TOptional<EWebSocketBackpressurePolicy> PolicyOverride;
+
+	/** Unsent state updates by key index. */
+	TMap<int32, TSharedPtr<const FWebSocketStateUpdate, ESPMode::ThreadSafe>> PendingState;
+
+	/** When the oldest message waiting for a container was queued, in FPlatformTime::Seconds. */
+	double BatchStartTime = 0.0;
+};
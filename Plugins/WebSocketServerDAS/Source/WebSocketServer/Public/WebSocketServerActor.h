@@ -8,6 +8,9 @@
 #include "UObject/StrongObjectPtr.h"
 #include "INetworkingWebSocket.h"
 #include "IWebSocketServer.h"
+#include "WebSocketConnectionRegistry.h"
+#include "WebSocketServerCore.h"
+#include "Containers/Queue.h"
 #include "Modules/ModuleManager.h"
 #include "Engine.h"
 #include "WebSocketServerActor.generated.h"
@@ -19,7 +22,7 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FWebSocketClientOnRawMessageDeleg
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketClientOnErrorDelegate, const FString&, clientid);
 
 UCLASS(BlueprintType, Blueprintable)
-class WEBSOCKETSERVER_API AWebSocketServerActor : public AActor
+class WEBSOCKETSERVER_API AWebSocketServerActor : public AActor, public IWebSocketServerListener
 {
 	GENERATED_BODY()
 
@@ -41,6 +44,18 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer")
 		bool ShowOnScreenDebugMessages = false;
 
+	//High-water marks and backpressure of the per client send queues
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer")
+		FWebSocketSendQueueSettings SendQueueSettings;
+
+	//Service the server on its own thread instead of in Tick, takes effect on Start
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer")
+		bool bUseNetworkThread = false;
+
+	//Times per second the network thread services the server
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WebSocketServer", meta = (EditCondition = "bUseNetworkThread", ClampMin = 1, ClampMax = 10000))
+		int32 NetworkTickRate = 500;
+
 public:
 	// Open WebSocket Server
 	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
@@ -56,6 +71,43 @@ public:
 	//Send message by client ID
 	void Send(const FGuid& InTargetClientId, const TArray<uint8>& InUTF8Payload);
 
+	//Send an encoded message by client ID, the message is shared instead of copied
+	void SendEncoded(const FGuid& InTargetClientId, const FWebSocketMessageRef& Message);
+
+	//Send an encoded message by client handle
+	void SendEncoded(FWebSocketClientHandle Client, const FWebSocketMessageRef& Message);
+
+	//Send an encoded message to all clients, every client queue shares the same message
+	void SendEncodedToAllClients(const FWebSocketMessageRef& Message);
+
+	//Set the latest value of a key of a state topic for the clients subscribed to it, replaces the update a client has not been sent yet.
+	//Pending keys are sent as one frame {"state":{"topic":{"key":value}}}, value has to be JSON and is dropped with a warning otherwise, null or an empty value marks a removed key.
+	//A client subscribing later is sent the current values of the topic
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void publishState(FString topic, FString key, FString jsonValue);
+
+	//Send an encoded message to the clients subscribed to a matching topic pattern
+	void PublishEncoded(const FString& Topic, const FWebSocketMessageRef& Message);
+
+	//Set the latest value and position of an entity of a state topic, only subscribed clients whose area of interest contains it are sent the value.
+	//An entity leaving a client's area is sent as null. Clients send their area as {"interest":{"bbox":[minLon,minLat,maxLon,maxLat]}}
+	//or {"interest":{"frustum":[[lon,lat],...]}}, {"interest":null} clears it. Clients without an area receive no entities
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void publishEntity(FString topic, FString key, double longitude, double latitude, FString jsonValue);
+
+	//Remove an entity, the clients it was visible to are sent null
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void removeEntity(FString topic, FString key);
+
+	//Send message to the clients subscribed to the topic. Clients subscribe by sending {"subscribe":"pattern"} or {"subscribe":["pattern",...]},
+	//topics are '/' separated, "*" in a pattern matches one segment and a trailing "**" any remaining segments
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void publish(FString topic, FString msg);
+
+	//Send byte message to the clients subscribed to the topic
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void publishBytes(FString topic, const TArray<uint8>& uint8Array);
+
 	//Send message to all clients
 	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
 		void SendToAllClients(const FString msg);
@@ -82,6 +134,12 @@ public:
 		bool IsRunning() const;
 
 
+	//Received client message for C++ listeners, raised on the game thread before the Blueprint delegate
+	FWebSocketNativeMessageDelegate& OnNativeMessage() { return Core.OnNativeMessage(); }
+
+	//Get the client ID of a handle received by OnNativeMessage
+	FString GetClientId(FWebSocketClientHandle Client) const;
+
 	//Client connected delegate
 	UPROPERTY(BlueprintAssignable, VisibleAnywhere, Category = "WebSocketServer")
 		FWebSocketClientOnConnectedDelegate WsClientOnConnected;
@@ -114,6 +172,36 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
 		void setClientNameById(FString clientid, FString name);
 
+	//set the backpressure policy of a client, used when its send queue is above the high-water mark
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		void setClientBackpressureById(FString clientid, EWebSocketBackpressurePolicy policy);
+
+	//subscribe a client to a topic pattern on its behalf
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		bool subscribeClient(FString clientid, FString pattern);
+
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		bool unsubscribeClient(FString clientid, FString pattern);
+
+	//set the area of interest of a client on its behalf, a min longitude above the max longitude or a max longitude above 180 crosses the antimeridian
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		bool setClientInterestArea(FString clientid, double minLongitude, double minLatitude, double maxLongitude, double maxLatitude);
+
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		bool clearClientInterestArea(FString clientid);
+
+	//get the number of entities inside a client's area of interest
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		int getClientVisibleEntityCount(FString clientid);
+
+	//get the number of clients a message published to the topic goes to
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		int getTopicSubscriberCount(FString topic);
+
+	//get the number of messages waiting in a client's send queue
+	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
+		int getClientQueueLength(FString clientid);
+
 	//Convert FString to utf8 bytes
 	UFUNCTION(BlueprintCallable, Category = "WebSocketServer")
 		static  TArray<uint8> FStringToUTF8Bytes(FString Message);
@@ -145,62 +233,14 @@ public:
 
 
 private:
-	// Handles a new client connecting
-	void OnWebSocketClientConnected(INetworkingWebSocket* Socket);
+	// IWebSocketServerListener, raises the Blueprint delegates
+	virtual void OnClientConnected(const FString& ClientId) override;
+	virtual void OnClientClosed(const FString& ClientId) override;
+	virtual void OnClientDisconnected(const FString& ClientId) override;
+	virtual void OnClientMessage(FWebSocketClientHandle Client, const TArray<uint8>& Data) override;
 
-	// Handles sending the received packet to the message router.
-	void ReceivedRawPacket(void* Data, int32 Size, FGuid ClientId);
-
-	// Handles a client close
-	void OnSocketClose(INetworkingWebSocket* Socket);
-
-	void OnClientSocketError(INetworkingWebSocket* Socket);
 private:
-	/** Holds a web socket connection to a client. */
-	class FWebSocketConnection
-	{
-	public:
-
-		explicit FWebSocketConnection(INetworkingWebSocket* InSocket)
-			: Socket(InSocket)
-			, Id(FGuid::NewGuid())
-		{
-		}
-
-		FWebSocketConnection(FWebSocketConnection&& WebSocketConnection)
-			: Id(WebSocketConnection.Id)
-		{
-			Socket = WebSocketConnection.Socket;
-			WebSocketConnection.Socket = nullptr;
-		}
-
-		~FWebSocketConnection()
-		{
-			if (Socket)
-			{
-
-				delete Socket;
-				Socket = nullptr;
-			}
-		}
-
-		FWebSocketConnection(const FWebSocketConnection&) = delete;
-		FWebSocketConnection& operator=(const FWebSocketConnection&) = delete;
-		FWebSocketConnection& operator=(FWebSocketConnection&&) = delete;
-
-		/** Underlying WebSocket. */
-		INetworkingWebSocket* Socket = nullptr;
-
-		/** Generated ID for this client. */
-		FGuid Id;
-		FString  clientName;
-	};
-
-private:
-	/** Holds the LibWebSocket wrapper. */
-	TUniquePtr<IWebSocketServer> Server;
-
-	/** Holds all active connections. */
-	TArray<FWebSocketConnection> Connections;
+	/** Server, connections and events, shared with the other server class. */
+	FWebSocketServerCore Core{ *this };
 
 };
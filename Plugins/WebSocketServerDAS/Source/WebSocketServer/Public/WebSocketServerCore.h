@@ -0,0 +1,151 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "WebSocketConnectionRegistry.h"
+#include "WebSocketServerThread.h"
+
+class INetworkingWebSocket;
+class IWebSocketServer;
+
+/** Receives the client notifications of FWebSocketServerCore on the game thread, implemented by the Blueprint facing servers. */
+class WEBSOCKETSERVER_API IWebSocketServerListener
+{
+public:
+
+	virtual ~IWebSocketServerListener() = default;
+
+	virtual void OnClientConnected(const FString& ClientId) = 0;
+
+	virtual void OnClientClosed(const FString& ClientId) = 0;
+
+	/** The client was dropped by the Disconnect backpressure policy, its socket closes later without another notification. */
+	virtual void OnClientDisconnected(const FString& ClientId) = 0;
+
+	/** Raised after the native message delegate, Data is reused once the call returns. */
+	virtual void OnClientMessage(FWebSocketClientHandle Client, const TArray<uint8>& Data) = 0;
+};
+
+/**
+ * Server state and logic shared by UDsWebSocketServer and AWebSocketServerActor: the engine server, the connection
+ * registry and its lock, the optional network thread and the events handed to the game thread.
+ * All functions are called on the game thread, the network thread only services the server.
+ */
+class WEBSOCKETSERVER_API FWebSocketServerCore
+{
+public:
+
+	explicit FWebSocketServerCore(IWebSocketServerListener& InListener);
+	~FWebSocketServerCore();
+
+	FWebSocketServerCore(const FWebSocketServerCore&) = delete;
+	FWebSocketServerCore& operator=(const FWebSocketServerCore&) = delete;
+
+	/** Listens on Port, a NetworkTickRate above 0 services the server on its own thread. */
+	bool Start(int32 Port, int32 NetworkTickRate);
+
+	/** Stops the network thread and closes the server and all connections. */
+	void Stop();
+
+	bool IsRunning() const { return Server.IsValid(); }
+
+	/** True while the network thread services the server, events then keep arriving when the game is paused. */
+	bool HasNetworkThread() const { return NetworkThread.IsValid(); }
+
+	/** Applies the queue settings, services the server unless the network thread does and raises the events. */
+	bool Tick(const FWebSocketSendQueueSettings& InSendQueueSettings);
+
+	void SendEncoded(const FGuid& ClientId, const FWebSocketMessageRef& Message);
+	void SendEncoded(FWebSocketClientHandle Client, const FWebSocketMessageRef& Message);
+
+	/** Accepts the id formats of FWebSocketConnectionRegistry::FindById. */
+	void SendEncoded(const FString& ClientId, const FWebSocketMessageRef& Message);
+
+	void SendEncodedToAllClients(const FWebSocketMessageRef& Message);
+
+	void PublishEncoded(const FString& Topic, const FWebSocketMessageRef& Message);
+
+	void PublishState(const FString& Topic, const FString& Key, const FString& Value);
+	void PublishEntity(const FString& Topic, const FString& Key, double Longitude, double Latitude, const FString& Value);
+	void RemoveEntity(const FString& Topic, const FString& Key);
+
+	FWebSocketNativeMessageDelegate& OnNativeMessage() { return NativeMessageDelegate; }
+
+	/** Client ID of a handle as announced to the game thread. */
+	FString GetClientId(FWebSocketClientHandle Client) const;
+
+	int32 NumClients() const;
+	TArray<FString> GetClientIds() const;
+	FString FindClientIdByName(const FString& Name) const;
+	void SetClientName(const FString& ClientId, const FString& Name);
+	void SetClientBackpressure(const FString& ClientId, EWebSocketBackpressurePolicy Policy);
+
+	bool Subscribe(const FString& ClientId, const FString& Pattern);
+	bool Unsubscribe(const FString& ClientId, const FString& Pattern);
+	int32 NumSubscribers(const FString& Topic);
+
+	/** Normalizes the box like a bbox sent by the client, returns false for non-finite values. */
+	bool SetInterestArea(const FString& ClientId, double MinLongitude, double MinLatitude, double MaxLongitude, double MaxLatitude);
+	bool ClearInterestArea(const FString& ClientId);
+	int32 NumVisibleEntities(const FString& ClientId) const;
+
+	int32 GetQueueLength(const FString& ClientId) const;
+
+private:
+	// Handles a new client connecting
+	void OnWebSocketClientConnected(INetworkingWebSocket* Socket);
+
+	// Handles sending the received packet to the message router.
+	void ReceivedRawPacket(void* Data, int32 Size, FWebSocketClientHandle Client);
+
+	// Handles one message of a packet, a container frame carries several
+	void ReceivedMessage(FWebSocketClientHandle Client, TArrayView<const uint8> Message);
+
+	// Handles a client close
+	void OnSocketClose(INetworkingWebSocket* Socket);
+
+	void OnClientSocketError(INetworkingWebSocket* Socket);
+
+	// Reports the clients detached by a send and waits when a Block client went above its high-water mark
+	void FinishSend(const TArray<FString>& Disconnected, bool bBlocked);
+
+	// Hands queued messages to the sockets and services the server, on the game thread or the network thread
+	void ServiceServer();
+
+	// Raises the delegates of all events collected since the last frame
+	void RaiseEvents();
+
+	// Waits until Block clients drained their queues below the high-water mark, only with the network thread
+	void WaitForBlockedQueues();
+
+private:
+	IWebSocketServerListener& Listener;
+
+	/** Holds the LibWebSocket wrapper. */
+	TUniquePtr<IWebSocketServer> Server;
+
+	/** Holds all active connections. */
+	FWebSocketConnectionRegistry Connections;
+
+	/** Guards Connections while the network thread services the server. */
+	mutable FCriticalSection ConnectionsLock;
+
+	/** Services the server when a network tick rate was given to Start. */
+	TUniquePtr<FWebSocketServerThread> NetworkThread;
+
+	/** Written while the server is serviced, read by the game thread once per frame. */
+	TQueue<FWebSocketServerEvent, EQueueMode::Spsc> Events;
+
+	/** Buffers of received messages, recycled once the delegates were raised. */
+	FWebSocketReceivePool ReceivePool;
+
+	/** Client IDs as announced to the game thread, follows the Connected and Closed events. */
+	TMap<FWebSocketClientHandle, FString> ClientIds;
+
+	FWebSocketNativeMessageDelegate NativeMessageDelegate;
+
+	/** Copy of the settings of the last Tick, for the Block timeout. */
+	FWebSocketSendQueueSettings SendQueueSettings;
+};
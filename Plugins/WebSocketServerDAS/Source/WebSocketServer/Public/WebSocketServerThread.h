@@ -0,0 +1,69 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/CircularQueue.h"
+#include "WebSocketConnectionRegistry.h"
+#include <atomic>
+
+class FRunnableThread;
+
+/** Connect, close and message notifications raised by the server thread, delivered to the game thread in a batch each frame. */
+struct FWebSocketServerEvent
+{
+	enum class EType : uint8
+	{
+		Connected,
+		Closed,
+		Message,
+		/** The socket of a client detached by the Disconnect policy closed, the client was reported closed already. */
+		Released,
+	};
+
+	EType Type = EType::Message;
+	FWebSocketClientHandle Client;
+	/** Only set for Connected events, messages are told apart by their handle. */
+	FString ClientId;
+	/** Message payload, taken from FWebSocketReceivePool. */
+	TArray<uint8> Data;
+};
+
+/** Receive buffers handed from the thread that services the server to the game thread and back, without locks or allocations. */
+class WEBSOCKETSERVER_API FWebSocketReceivePool
+{
+public:
+
+	FWebSocketReceivePool();
+
+	/** Takes a buffer holding a copy of Data, called while the server is serviced. */
+	TArray<uint8> Acquire(const void* Data, int32 Size);
+
+	/** Returns a buffer once its message was delivered, called on the game thread. */
+	void Release(TArray<uint8>&& Buffer);
+
+private:
+	/** Larger buffers are freed instead of kept. */
+	static constexpr int32 MaxPooledBytes = 64 * 1024;
+
+	TCircularQueue<TArray<uint8>> Free;
+};
+
+/** Services a web socket server at a fixed rate on its own thread, independent of the frame rate and of game pause. */
+class WEBSOCKETSERVER_API FWebSocketServerThread : public FRunnable
+{
+public:
+
+	FWebSocketServerThread(TFunction<void()>&& InService, int32 TickRate);
+	virtual ~FWebSocketServerThread();
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	TFunction<void()> Service;
+	double Period = 0.002;
+	std::atomic<bool> bStopping{ false };
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,57 @@
+// Copyright 2020-2022 MassSun. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Map key functions comparing FString keys case sensitively, FString keys of a TMap are not. */
+template<typename ValueType>
+struct TWebSocketCaseSensitiveKeyFuncs : BaseKeyFuncs<TPair<FString, ValueType>, FString, false>
+{
+	static const FString& GetSetKey(const TPair<FString, ValueType>& Element) { return Element.Key; }
+	static bool Matches(const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+	static uint32 GetKeyHash(const FString& Key) { return FCrc::StrCrc32(*Key); }
+};
+
+/**
+ * Topic subscriptions of web socket clients, kept as one subscriber bitset per pattern.
+ * Topics are '/' separated, in a pattern "*" matches one segment and a trailing "**" matches any remaining segments.
+ * The subscribers of a published topic are resolved once and cached until subscriptions are removed. Only topics with
+ * subscribers are cached, and the cache starts over once it holds MaxCachedTopics topics.
+ */
+class WEBSOCKETSERVER_API FWebSocketTopicIndex
+{
+public:
+
+	/** Adds a pattern for a subscriber, returns false when it was subscribed already. */
+	bool Subscribe(int32 Subscriber, const FString& Pattern);
+
+	/** Removes a pattern of a subscriber, returns false when it was not subscribed. */
+	bool Unsubscribe(int32 Subscriber, const FString& Pattern);
+
+	/** Removes all patterns of a subscriber whose slot is about to be reused. */
+	void RemoveSubscriber(int32 Subscriber, const TArray<FString>& Patterns);
+
+	/** Subscribers of a topic, indexed by subscriber. The reference is valid until the next change. */
+	const TBitArray<>& Resolve(const FString& Topic);
+
+	void Empty();
+
+	static bool Matches(const FString& Pattern, const FString& Topic);
+
+private:
+	typedef TMap<FString, TBitArray<>, FDefaultSetAllocator, TWebSocketCaseSensitiveKeyFuncs<TBitArray<>>> FBitsByName;
+
+	static void SetBit(TBitArray<>& Bits, int32 Index, bool bValue);
+
+	/** Bounds the cache when topics are made up per entity or per message. */
+	static constexpr int32 MaxCachedTopics = 4096;
+
+	FBitsByName Patterns;
+
+	/** Resolved subscribers of published topics. */
+	FBitsByName Topics;
+
+	/** Resolved subscribers of the topics nobody subscribed to. */
+	TBitArray<> NoSubscribers;
+};
@@ -39,6 +39,8 @@ public class WebSocketServer : ModuleRules
                 "Engine",
                 "Slate",
                 "SlateCore",
+                "Json",
+                "Sockets",
 				// ... add private dependencies that you statically link with here ...	
 			}
             );